@@ -0,0 +1,86 @@
+/** \file
+ * APA102 stream decoder.
+ */
+#include "apa102_decode.h"
+
+#include <stdio.h>
+#include <string.h>
+
+bool apa102_decode_frame(
+	const uint8_t* data,
+	size_t len,
+	apa102_pixel_t* pixels,
+	uint32_t max_pixels,
+	apa102_frame_info_t* info
+) {
+	memset(info, 0, sizeof(apa102_frame_info_t));
+
+	size_t offset = 0;
+	while (offset < len && data[offset] == 0x00) {
+		offset++;
+	}
+	info->start_length = (uint32_t) offset;
+
+	// The most LED frames that leave enough room for their end frame
+	size_t remaining = len - offset;
+	uint32_t max_led_frames = (uint32_t) (remaining / 4);
+	while (max_led_frames > 0 && (size_t) max_led_frames * 4 + apa102_min_end_length(max_led_frames) > remaining) {
+		max_led_frames--;
+	}
+
+	while (info->pixel_count < max_led_frames && (data[offset] & 0xE0) == 0xE0) {
+		if (info->pixel_count < max_pixels) {
+			apa102_pixel_t* pixel = &pixels[info->pixel_count];
+			pixel->brightness = data[offset] & 0x1F;
+			memcpy(pixel->channels, &data[offset + 1], 3);
+		}
+
+		info->pixel_count++;
+		offset += 4;
+	}
+
+	info->end_length = (uint32_t) (len - offset);
+	info->end_byte = info->end_length > 0 ? data[offset] : 0xFF;
+
+	if (info->start_length < 4) {
+		snprintf(info->error, sizeof(info->error), "Start frame is %u zero bytes; expected at least 4", info->start_length);
+		return false;
+	}
+
+	for (size_t i=offset; i<len; i++) {
+		if (data[i] != info->end_byte) {
+			snprintf(info->error, sizeof(info->error), "Byte %zu (0x%02X) is neither part of an LED frame nor of the end frame", i, data[i]);
+			return false;
+		}
+	}
+
+	if (info->end_length < apa102_min_end_length(info->pixel_count)) {
+		snprintf(info->error, sizeof(info->error), "End frame is %u bytes; %u pixels need at least %u",
+			info->end_length, info->pixel_count, apa102_min_end_length(info->pixel_count)
+		);
+		return false;
+	}
+
+	info->valid = true;
+	return true;
+}
+
+void apa102_pixel_rgb(const apa102_pixel_t* pixel, color_channel_order_t color_channel_order, uint8_t* rgb_out) {
+	// Wire position of red, green and blue for each order
+	static const uint8_t positions[][3] = {
+		[COLOR_ORDER_RGB] = { 0, 1, 2 },
+		[COLOR_ORDER_RBG] = { 0, 2, 1 },
+		[COLOR_ORDER_GRB] = { 1, 0, 2 },
+		[COLOR_ORDER_GBR] = { 2, 0, 1 },
+		[COLOR_ORDER_BGR] = { 2, 1, 0 },
+		[COLOR_ORDER_BRG] = { 1, 2, 0 }
+	};
+
+	if ((unsigned) color_channel_order >= sizeof(positions) / sizeof(positions[0])) {
+		color_channel_order = COLOR_ORDER_BGR;
+	}
+
+	for (int channel=0; channel<3; channel++) {
+		rgb_out[channel] = pixel->channels[positions[color_channel_order][channel]];
+	}
+}
@@ -0,0 +1,65 @@
+/** \file
+ * APA102 stream decoder: reads back what the render thread put on the wire, so that interpolation, LUT, dithering and
+ * channel order can be checked end to end without LEDs attached.
+ *
+ * A frame is a start frame of zero bytes, one 4-byte LED frame per pixel (0b111 and a 5-bit brightness, then three
+ * color bytes in output order) and an end frame. The end frame is either 0xFF bytes (APA102, HD107S), which look just
+ * like white LED frames, or zero bytes (SK9822). The decoder takes the longest run of LED frames that still leaves room
+ * for the end frame an APA102 strip of that length needs, so whole frames as the server writes them decode exactly.
+ */
+#ifndef SPISCAPE_APA102_DECODE_H
+#define SPISCAPE_APA102_DECODE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "util.h"
+
+typedef struct {
+	uint8_t brightness;
+
+	// Color bytes in the order they were on the wire; see apa102_pixel_rgb()
+	uint8_t channels[3];
+} apa102_pixel_t;
+
+typedef struct {
+	uint32_t start_length;
+	uint32_t pixel_count;
+
+	uint32_t end_length;
+	uint8_t end_byte;
+
+	// Whether the frame is well formed: a start frame of at least 4 zero bytes, LED frames, and an end frame of one
+	// repeated byte that is long enough to clock the data through every pixel
+	bool valid;
+	char error[128];
+} apa102_frame_info_t;
+
+/**
+ * Decodes one whole frame of len bytes into up to max_pixels pixels. info->pixel_count may be larger than max_pixels
+ * if pixels doesn't have room for all of them.
+ *
+ * \return info->valid
+ */
+extern bool apa102_decode_frame(
+	const uint8_t* data,
+	size_t len,
+	apa102_pixel_t* pixels,
+	uint32_t max_pixels,
+	apa102_frame_info_t* info
+);
+
+/**
+ * Puts the pixel's colors in red, green, blue order, given the channel order the frame was sent with.
+ */
+extern void apa102_pixel_rgb(const apa102_pixel_t* pixel, color_channel_order_t color_channel_order, uint8_t* rgb_out);
+
+/**
+ * Returns the fewest end frame bytes that clock the data through pixel_count pixels: one clock per two pixels.
+ */
+static inline uint32_t apa102_min_end_length(uint32_t pixel_count) {
+	return (pixel_count + 15) / 16;
+}
+
+#endif //SPISCAPE_APA102_DECODE_H
@@ -0,0 +1,162 @@
+/** \file
+ * LED chipset encoders.
+ */
+#include "chipset.h"
+
+#include <pthread.h>
+#include <string.h>
+#include <strings.h>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Frame edges
+
+// APA102: the data is delayed by half a clock per LED, so it takes n/2 extra clock edges to reach the end of the strip
+static uint32_t chipset_apa102_end_length(uint32_t led_count) {
+	return led_count/16 + 1;
+}
+
+// SK9822: a 32-bit reset frame makes the LEDs show the new data right away, rather than on the next start frame,
+// followed by the same extra clocks as the APA102
+static uint32_t chipset_sk9822_end_length(uint32_t led_count) {
+	return 4 + led_count/16 + 1;
+}
+
+// WS2801: latches when the clock stays low, so nothing follows the pixels
+static uint32_t chipset_no_end_length(uint32_t led_count) {
+	led_count=led_count; // Suppress Warnings
+	return 0;
+}
+
+// LPD8806: each zero byte resets the data path of 32 LEDs, latching what they received
+static uint32_t chipset_lpd8806_end_length(uint32_t led_count) {
+	return (led_count + 31) / 32;
+}
+
+// Single-wire chipsets latch once the line stays low for long enough. WS2812B-V5 parts need 280 us, older ones 50 us;
+// 300 us is 90 bytes at 2.4 MHz and 120 bytes at 3.2 MHz.
+static uint32_t chipset_ws2812_end_length(uint32_t led_count) {
+	led_count=led_count; // Suppress Warnings
+	return 90;
+}
+
+static uint32_t chipset_sk6812_end_length(uint32_t led_count) {
+	led_count=led_count; // Suppress Warnings
+	return 120;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Encoders
+
+// Three 8-bit color bytes per LED
+static void chipset_ws2801_encode(const uint8_t* led_frames, uint32_t led_count, uint8_t* pixels_out) {
+	for (uint32_t i=0; i<led_count; i++) {
+		pixels_out[i*3 + 0] = led_frames[i*4 + 1];
+		pixels_out[i*3 + 1] = led_frames[i*4 + 2];
+		pixels_out[i*3 + 2] = led_frames[i*4 + 3];
+	}
+}
+
+// Three 7-bit color bytes per LED, each with the high bit set
+static void chipset_lpd8806_encode(const uint8_t* led_frames, uint32_t led_count, uint8_t* pixels_out) {
+	for (uint32_t i=0; i<led_count; i++) {
+		pixels_out[i*3 + 0] = (uint8_t) (0x80 | led_frames[i*4 + 1] >> 1);
+		pixels_out[i*3 + 1] = (uint8_t) (0x80 | led_frames[i*4 + 2] >> 1);
+		pixels_out[i*3 + 2] = (uint8_t) (0x80 | led_frames[i*4 + 3] >> 1);
+	}
+}
+
+// WS2812 at 2.4 MHz: each data bit is a 3-bit symbol, 110 for a one and 100 for a zero, so a 0.42 us bit time with
+// 0.42 us or 0.83 us high
+static uint8_t g_ws2812_symbols[256][3];
+
+// SK6812 at 3.2 MHz: each data bit is a 4-bit symbol, 1100 for a one and 1000 for a zero, so a 0.31 us bit time with
+// 0.31 us or 0.63 us high
+static uint8_t g_sk6812_symbols[256][4];
+
+static pthread_once_t g_chipset_symbols_once = PTHREAD_ONCE_INIT;
+
+static void chipset_build_symbol_tables(void) {
+	for (uint32_t value=0; value<256; value++) {
+		uint32_t symbols3 = 0;
+		uint32_t symbols4 = 0;
+
+		for (int bit=7; bit>=0; bit--) {
+			bool one = (value >> bit) & 1;
+			symbols3 = (symbols3 << 3) | (one ? 0x6 : 0x4);
+			symbols4 = (symbols4 << 4) | (one ? 0xC : 0x8);
+		}
+
+		for (int i=0; i<3; i++) {
+			g_ws2812_symbols[value][i] = (uint8_t) (symbols3 >> (16 - i*8));
+		}
+		for (int i=0; i<4; i++) {
+			g_sk6812_symbols[value][i] = (uint8_t) (symbols4 >> (24 - i*8));
+		}
+	}
+}
+
+// Three color bytes per LED, expanded to 3-bit symbols
+static void chipset_ws2812_encode(const uint8_t* led_frames, uint32_t led_count, uint8_t* pixels_out) {
+	for (uint32_t i=0; i<led_count; i++) {
+		for (int c=0; c<3; c++) {
+			memcpy(&pixels_out[i*9 + c*3], g_ws2812_symbols[led_frames[i*4 + 1 + c]], 3);
+		}
+	}
+}
+
+// Three color bytes per LED, expanded to 4-bit symbols
+static void chipset_sk6812_encode(const uint8_t* led_frames, uint32_t led_count, uint8_t* pixels_out) {
+	for (uint32_t i=0; i<led_count; i++) {
+		for (int c=0; c<3; c++) {
+			memcpy(&pixels_out[i*12 + c*4], g_sk6812_symbols[led_frames[i*4 + 1 + c]], 4);
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Chipsets
+
+static const chipset_t g_chipsets[] = {
+	{ "apa102",  4, 0x00, 4, chipset_apa102_end_length, 0xFF, NULL, true, 0, 0, false },
+	{ "sk9822",  4, 0x00, 4, chipset_sk9822_end_length, 0x00, NULL, true, 0, 0, false },
+
+	// APA102 compatible, but clocks reliably at 30-40 MHz
+	{ "hd107s",  4, 0x00, 4, chipset_apa102_end_length, 0xFF, NULL, true, 0, 0, false },
+
+	// 64-bit LED frames behind a 128-bit start frame, with 16 bits per channel; the channel brightnesses stay at full
+	{ "hd108",  16, 0x00, 8, chipset_apa102_end_length, 0xFF, NULL, false, 0, 0, true },
+
+	{ "ws2801",  0, 0x00, 3, chipset_no_end_length, 0x00, chipset_ws2801_encode, false, 500, 0, false },
+	{ "lpd8806", 0, 0x00, 3, chipset_lpd8806_end_length, 0x00, chipset_lpd8806_encode, false, 0, 0, false },
+
+	// Either symbol size works for both; the tighter SK6812 timing is met more comfortably with 4-bit symbols
+	{ "ws2812",  0, 0x00, 9, chipset_ws2812_end_length, 0x00, chipset_ws2812_encode, false, 0, 2400000, false },
+	{ "sk6812",  0, 0x00, 12, chipset_sk6812_end_length, 0x00, chipset_sk6812_encode, false, 0, 3200000, false }
+};
+
+static const size_t g_chipset_count = sizeof(g_chipsets) / sizeof(g_chipsets[0]);
+
+const chipset_t* chipset_find(const char* name) {
+	pthread_once(&g_chipset_symbols_once, chipset_build_symbol_tables);
+
+	for (size_t i=0; i<g_chipset_count; i++) {
+		if (strcasecmp(g_chipsets[i].name, name) == 0) {
+			return &g_chipsets[i];
+		}
+	}
+
+	return NULL;
+}
+
+uint32_t chipset_frame_length(const chipset_t* chipset, uint32_t led_count) {
+	return chipset->start_length + led_count * chipset->bytes_per_led + chipset->end_length(led_count);
+}
+
+void chipset_write_frame_edges(const chipset_t* chipset, uint8_t* frame_out, uint32_t led_count) {
+	memset(frame_out, chipset->start_byte, chipset->start_length);
+	memset(
+		&frame_out[chipset->start_length + led_count * chipset->bytes_per_led],
+		chipset->end_byte,
+		chipset->end_length(led_count)
+	);
+}
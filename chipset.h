@@ -0,0 +1,67 @@
+/** \file
+ * LED chipsets: how rendered pixels are laid out on the wire for each kind of SPI LED strip.
+ *
+ * The render kernels write APA102 LED frames: a brightness byte (0xE0 | 5-bit brightness) followed by the three color
+ * bytes in output order. Chipsets that use the same format get them written straight into the SPI buffer. Others have
+ * an encoder that converts the LED frames into their own pixel format after rendering. Around the pixels, each chipset
+ * has its own start frame, end frame and latch time.
+ *
+ * 16-bit chipsets such as the HD108 skip the LED frames: the 16-bit render kernel writes their pixels directly, with no
+ * dithering.
+ *
+ * Single-wire chipsets such as the WS2812 are driven from the SPI data line alone, at a fixed clock rate: every data
+ * bit becomes a short SPI symbol whose high time encodes the bit, and the end frame holds the line low long enough for
+ * the LEDs to latch.
+ */
+#ifndef SPISCAPE_CHIPSET_H
+#define SPISCAPE_CHIPSET_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef struct {
+	const char* name;
+
+	// Bytes of start_byte sent before the first pixel
+	uint32_t start_length;
+	uint8_t start_byte;
+
+	uint32_t bytes_per_led;
+
+	// Bytes of end_byte sent after the last pixel
+	uint32_t (*end_length)(uint32_t led_count);
+	uint8_t end_byte;
+
+	// Converts APA102 LED frames into this chipset's pixels; NULL if the LED frames go out as they are
+	void (*encode)(const uint8_t* led_frames, uint32_t led_count, uint8_t* pixels_out);
+
+	// Whether the chipset has the APA102 brightness field that HDR output needs
+	bool has_brightness;
+
+	// How long the clock must stay idle after a frame for the LEDs to show it, in microseconds
+	uint32_t latch_usec;
+
+	// SPI clock rate the encoding is timed for, used instead of the configured rate; 0 if the chipset has a clock line
+	uint32_t spi_speed_hz;
+
+	// Whether pixels are HD108 LED frames with 16-bit channels, rendered by g_render_wide_kernel
+	bool wide;
+} chipset_t;
+
+/**
+ * Returns the chipset with the given name ("apa102", "sk9822", "hd107s", "hd108", "ws2801", "lpd8806", "ws2812",
+ * "sk6812"), or NULL if there is none.
+ */
+extern const chipset_t* chipset_find(const char* name);
+
+/**
+ * Returns the number of bytes one frame for led_count LEDs takes on the wire.
+ */
+extern uint32_t chipset_frame_length(const chipset_t* chipset, uint32_t led_count);
+
+/**
+ * Writes the start and end frames around the pixels of a frame for led_count LEDs.
+ */
+extern void chipset_write_frame_edges(const chipset_t* chipset, uint8_t* frame_out, uint32_t led_count);
+
+#endif //SPISCAPE_CHIPSET_H
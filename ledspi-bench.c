@@ -0,0 +1,367 @@
+/** \file
+ * ledspi-bench: measures the render kernels on this machine, without LEDs or a running server.
+ *
+ * Prints how long each supported kernel takes per frame with error diffusion and with ordered dithering, then how
+ * closely each dithering mode tracks a static dark gradient: every LED's output, averaged over 1/60 s windows, is
+ * compared with the exact 16-bit value the wide kernel renders for it. Last, it times the chipset encoders that
+ * convert LED frames into other chipsets' pixels, at common strip lengths.
+ */
+#include "chipset.h"
+#include "render.h"
+#include "util.h"
+
+#include <getopt.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Frames rendered before precision is measured, so error diffusion settles
+#define BENCH_SETTLE_FRAMES 64
+
+// Frames precision is measured over
+#define BENCH_PRECISION_FRAMES 1024
+
+// Neighboring LEDs seen as one at a distance, for the grouped precision figures
+#define BENCH_GROUP_SIZE 4
+
+static struct {
+	uint32_t led_count;
+	uint32_t frame_count;
+	uint32_t refresh_rate_hz;
+} g_bench_config = {
+	.led_count = 4096,
+	.frame_count = 4000,
+	.refresh_rate_hz = 400
+};
+
+static uint32_t g_lookup[257];
+
+static render_frame_t g_previous;
+static render_frame_t g_current;
+static render_dither_t g_dither;
+
+/**
+ * Fills the lookup table with a gamma 2 curve and the frames with a dark gradient, in steps of 64 LEDs.
+ */
+static void bench_setup_scene(void) {
+	for (int i=0; i<257; i++) {
+		double value = (i / 256.0) * (i / 256.0) * 0xFFFF + 0.5;
+		g_lookup[i] = value > 0xFFFF ? 0xFFFF : (uint32_t) value;
+	}
+
+	for (int channel=0; channel<3; channel++) {
+		for (uint32_t i=0; i<g_bench_config.led_count; i++) {
+			g_previous.planes[channel][i] = (uint8_t) ((i / 64) % 64);
+			g_current.planes[channel][i] = (uint8_t) ((i / 64) % 64);
+		}
+	}
+}
+
+static render_params_t bench_params(uint32_t frame_index, bool ordered, uint32_t max_dither_frames) {
+	render_params_t params = {
+		.frame_progress16 = (uint16_t) (frame_index * 997),
+		.dithering_frame = (int8_t) frame_index,
+		.max_dither_frames = max_dither_frames,
+		.interpolation_enabled = true,
+		.dithering_enabled = true,
+		.ordered_dithering_enabled = ordered,
+		.lut_enabled = true,
+		.red_lookup = g_lookup,
+		.green_lookup = g_lookup,
+		.blue_lookup = g_lookup
+	};
+	params.inv_frame_progress16 = 0xFFFF - params.frame_progress16;
+
+	render_params_set_channel_order(&params, COLOR_ORDER_RGB);
+	if (ordered) {
+		render_params_set_dither_thresholds(&params);
+	}
+
+	return params;
+}
+
+/**
+ * Returns the microseconds the kernel takes per frame, averaged over frame_count frames.
+ */
+static double bench_render_time(const render_kernel_t* kernel, bool ordered, uint32_t max_dither_frames, uint8_t* out) {
+	struct timeval start_tv, stop_tv;
+
+	monotonic_time(&start_tv);
+	for (uint32_t f=0; f<g_bench_config.frame_count; f++) {
+		render_params_t params = bench_params(f, ordered, max_dither_frames);
+		render_pixels_fn render_pixels = render_kernel_variant(kernel, &params);
+		render_pixels(&params, &g_previous, &g_current, &g_dither, 0, g_bench_config.led_count, out);
+	}
+	monotonic_time(&stop_tv);
+
+	double elapsed_usec = (stop_tv.tv_sec - start_tv.tv_sec) * 1e6 + (stop_tv.tv_usec - start_tv.tv_usec);
+	return elapsed_usec / g_bench_config.frame_count;
+}
+
+/**
+ * Compares the red output of groups of group_size LEDs, averaged over every window of window_frames frames, with the
+ * exact values in target. Returns the RMS error of the windows, and stores the error of the average over all frames in
+ * mean_error if it isn't NULL, both in 8-bit LSB.
+ */
+static double bench_dither_error(
+	const uint8_t* history,
+	const double* target,
+	uint32_t group_size,
+	uint32_t window_frames,
+	double* mean_error
+) {
+	double total_mean_error = 0;
+	double total_window_error = 0;
+	uint64_t window_count = 0;
+	double group_output[BENCH_PRECISION_FRAMES];
+
+	for (uint32_t first=0; first+group_size<=g_bench_config.led_count; first+=group_size) {
+		double group_target = 0;
+		for (uint32_t i=first; i<first+group_size; i++) {
+			group_target += target[i] / group_size;
+		}
+
+		double sum = 0;
+		for (uint32_t f=0; f<BENCH_PRECISION_FRAMES; f++) {
+			group_output[f] = 0;
+			for (uint32_t i=first; i<first+group_size; i++) {
+				group_output[f] += history[(size_t) f * g_bench_config.led_count + i] / (double) group_size;
+			}
+			sum += group_output[f];
+		}
+		total_mean_error += fabs(sum / BENCH_PRECISION_FRAMES - group_target);
+
+		for (uint32_t f=0; f+window_frames<=BENCH_PRECISION_FRAMES; f++) {
+			double window_sum = 0;
+			for (uint32_t k=0; k<window_frames; k++) {
+				window_sum += group_output[f + k];
+			}
+			double error = window_sum / window_frames - group_target;
+			total_window_error += error * error;
+			window_count++;
+		}
+	}
+
+	if (mean_error != NULL) {
+		*mean_error = total_mean_error / (g_bench_config.led_count / group_size);
+	}
+	return sqrt(total_window_error / window_count);
+}
+
+/**
+ * Renders the scene with the scalar kernel and prints how far each dithering mode strays from the exact values.
+ */
+static bool bench_precision(uint32_t max_dither_frames) {
+	uint32_t led_count = g_bench_config.led_count;
+	uint32_t window_frames = max_dither_frames > 0 ? max_dither_frames : 1;
+	uint8_t* history = malloc((size_t) BENCH_PRECISION_FRAMES * led_count);
+	double* target = malloc(led_count * sizeof(double));
+	uint8_t* out = malloc(led_count * RENDER_WIDE_BYTES_PER_LED);
+	if (history == NULL || target == NULL || out == NULL) {
+		fprintf(stderr, "Out of memory measuring precision over %u LEDs\n", led_count);
+		free(history);
+		free(target);
+		free(out);
+		return false;
+	}
+
+	// The scene is static, so the wide kernel's 16-bit output is the exact value every frame
+	render_params_t wide_params = bench_params(0, false, max_dither_frames);
+	render_pixels_fn render_wide = render_kernel_variant(&g_render_wide_kernel, &wide_params);
+	render_wide(&wide_params, &g_previous, &g_current, &g_dither, 0, led_count, out);
+	for (uint32_t i=0; i<led_count; i++) {
+		// Red follows the 2-byte header, most significant byte first
+		const uint8_t* red = &out[i * RENDER_WIDE_BYTES_PER_LED + 2];
+		target[i] = ((red[0] << 8) | red[1]) / 257.0;
+	}
+
+	const render_kernel_t* kernel = render_kernel_by_name("scalar");
+
+	for (int ordered=0; ordered<2; ordered++) {
+		render_dither_free(&g_dither);
+		render_dither_alloc(&g_dither, led_count);
+
+		for (uint32_t f=0; f<BENCH_SETTLE_FRAMES + BENCH_PRECISION_FRAMES; f++) {
+			render_params_t params = bench_params(f, ordered, max_dither_frames);
+			render_kernel_variant(kernel, &params)(&params, &g_previous, &g_current, &g_dither, 0, led_count, out);
+
+			if (f >= BENCH_SETTLE_FRAMES) {
+				uint8_t* frame_history = &history[(size_t) (f - BENCH_SETTLE_FRAMES) * led_count];
+				for (uint32_t i=0; i<led_count; i++) {
+					frame_history[i] = out[i * 4 + 1];
+				}
+			}
+		}
+
+		double mean_error;
+		double window_error = bench_dither_error(history, target, 1, window_frames, &mean_error);
+		double group_window_error = bench_dither_error(history, target, BENCH_GROUP_SIZE, window_frames, NULL);
+
+		printf(
+			"precision %-9s  1/60 s error %.3f LSB RMS, %.3f over %u LEDs; mean error %.3f LSB\n",
+			ordered ? "ordered" : "diffusion",
+			window_error,
+			group_window_error,
+			BENCH_GROUP_SIZE,
+			mean_error
+		);
+	}
+
+	free(history);
+	free(target);
+	free(out);
+	return true;
+}
+
+/**
+ * Times each chipset encoder on the rendered LED frames, per strip, and for chipsets with a fixed SPI clock compares
+ * that with the time the frame takes on the wire.
+ */
+static bool bench_encode(const uint8_t* led_frames) {
+	static const char* chipset_names[] = { "ws2801", "lpd8806", "ws2812", "sk6812" };
+	static const uint32_t strip_lengths[] = { 300, 1000 };
+
+	uint8_t* pixels = malloc(g_bench_config.led_count * 12);
+	if (pixels == NULL) {
+		fprintf(stderr, "Out of memory allocating pixels for %u LEDs\n", g_bench_config.led_count);
+		return false;
+	}
+
+	for (size_t i=0; i<sizeof(chipset_names) / sizeof(chipset_names[0]); i++) {
+		const chipset_t* chipset = chipset_find(chipset_names[i]);
+
+		for (size_t j=0; j<sizeof(strip_lengths) / sizeof(strip_lengths[0]); j++) {
+			uint32_t led_count = strip_lengths[j];
+			if (led_count > g_bench_config.led_count) {
+				continue;
+			}
+
+			struct timeval start_tv, stop_tv;
+			monotonic_time(&start_tv);
+			for (uint32_t f=0; f<g_bench_config.frame_count; f++) {
+				chipset->encode(led_frames, led_count, pixels);
+			}
+			monotonic_time(&stop_tv);
+
+			double elapsed_usec = (stop_tv.tv_sec - start_tv.tv_sec) * 1e6 + (stop_tv.tv_usec - start_tv.tv_usec);
+			double encode_usec = elapsed_usec / g_bench_config.frame_count;
+
+			printf("encode %-7s %4u LEDs %7.2f us/frame", chipset->name, led_count, encode_usec);
+			if (chipset->spi_speed_hz > 0) {
+				double wire_usec = chipset_frame_length(chipset, led_count) * 8 * 1e6 / chipset->spi_speed_hz;
+				printf(", %.2f%% of the %.0f us the frame takes on the wire", encode_usec / wire_usec * 100, wire_usec);
+			}
+			printf("\n");
+		}
+	}
+
+	free(pixels);
+	return true;
+}
+
+static void print_usage(const char* name) {
+	printf("Usage: %s [options]\n\n", name);
+	printf("--leds <val>, -n <val>\n\tLEDs per frame (default 4096)\n");
+	printf("--frames <val>, -f <val>\n\tFrames each kernel is timed over (default 4000)\n");
+	printf("--refresh-rate-hz <val>, -r <val>\n\tRefresh rate the dithering cycle is sized for, as in the server (default 400)\n");
+	printf("--help, -h\n\tShows this message\n");
+}
+
+int main(int argc, char** argv) {
+	static struct option long_options[] = {
+		{"leds", required_argument, NULL, 'n'},
+		{"frames", required_argument, NULL, 'f'},
+		{"refresh-rate-hz", required_argument, NULL, 'r'},
+		{"help", no_argument, NULL, 'h'},
+		{0, 0, 0, 0}
+	};
+
+	int opt;
+	while ((opt = getopt_long(argc, argv, "n:f:r:h", long_options, NULL)) != -1) {
+		switch (opt) {
+			case 'n': {
+				g_bench_config.led_count = (uint32_t) atoi(optarg);
+			} break;
+
+			case 'f': {
+				g_bench_config.frame_count = (uint32_t) atoi(optarg);
+			} break;
+
+			case 'r': {
+				g_bench_config.refresh_rate_hz = (uint32_t) atoi(optarg);
+			} break;
+
+			case 'h': {
+				print_usage(argv[0]);
+				return 0;
+			}
+
+			default: {
+				print_usage(argv[0]);
+				return 2;
+			}
+		}
+	}
+
+	if (optind != argc
+		|| g_bench_config.led_count < BENCH_GROUP_SIZE
+		|| g_bench_config.frame_count == 0
+		|| g_bench_config.refresh_rate_hz == 0
+	) {
+		print_usage(argv[0]);
+		return 2;
+	}
+
+	if (! render_frame_alloc(&g_previous, g_bench_config.led_count)
+		|| ! render_frame_alloc(&g_current, g_bench_config.led_count)
+		|| ! render_dither_alloc(&g_dither, g_bench_config.led_count)
+	) {
+		fprintf(stderr, "Out of memory allocating frames for %u LEDs\n", g_bench_config.led_count);
+		return 2;
+	}
+	bench_setup_scene();
+
+	// Sized the way the server sizes it: as many frames as fit in 1/60 s
+	uint32_t max_dither_frames = 16667 / (1000000 / g_bench_config.refresh_rate_hz);
+
+	printf(
+		"%u LEDs, interpolated with the LUT; %u Hz, %u-frame ordered dithering cycle\n",
+		g_bench_config.led_count,
+		g_bench_config.refresh_rate_hz,
+		render_dither_cycle_frames(max_dither_frames)
+	);
+
+	static const char* kernel_names[] = { "scalar", "sse2", "avx2", "neon" };
+	uint8_t* out = malloc(g_bench_config.led_count * 4);
+	if (out == NULL) {
+		fprintf(stderr, "Out of memory allocating output for %u LEDs\n", g_bench_config.led_count);
+		return 2;
+	}
+
+	for (size_t i=0; i<sizeof(kernel_names) / sizeof(kernel_names[0]); i++) {
+		const render_kernel_t* kernel = render_kernel_by_name(kernel_names[i]);
+		if (kernel == NULL || ! kernel->is_supported()) {
+			continue;
+		}
+
+		double diffusion_usec = bench_render_time(kernel, false, max_dither_frames, out);
+		double ordered_usec = bench_render_time(kernel, true, max_dither_frames, out);
+		printf(
+			"render %-6s  diffusion %7.1f us/frame, ordered %7.1f us/frame (%+.0f%%)\n",
+			kernel->name,
+			diffusion_usec,
+			ordered_usec,
+			(ordered_usec / diffusion_usec - 1) * 100
+		);
+	}
+
+	bool measured = bench_precision(max_dither_frames) && bench_encode(out);
+	free(out);
+
+	render_frame_free(&g_previous);
+	render_frame_free(&g_current);
+	render_dither_free(&g_dither);
+
+	return measured ? 0 : 2;
+}
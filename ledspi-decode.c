@@ -0,0 +1,244 @@
+/** \file
+ * ledspi-decode: prints what ledspi-server put on the wire as JSON, one line per frame.
+ *
+ * Reads either a trace written by the trace output backend (`--spi-dev trace:<path>`), or raw APA102 bytes such
+ * as the file output backend writes: a whole file as one frame, or a stream cut into frames of --frame-bytes bytes.
+ * Exits with 1 if any frame isn't a valid APA102 frame, so scripts can check the output without LEDs attached.
+ */
+#include "apa102_decode.h"
+#include "spio.h"
+#include "util.h"
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define min(a,b) ((a)<(b)?(a):(b))
+#define max(a,b) ((a)>(b)?(a):(b))
+
+static struct {
+	uint32_t frame_bytes;
+	color_channel_order_t color_channel_order;
+	bool summary;
+} g_decode_config = {
+	.frame_bytes = 0,
+	.color_channel_order = COLOR_ORDER_BGR,
+	.summary = false
+};
+
+static uint8_t* read_input(const char* path, size_t* length_out) {
+	FILE* file = strcmp(path, "-") == 0 ? stdin : fopen(path, "rb");
+	if (file == NULL) {
+		fprintf(stderr, "Can't open %s: %s\n", path, strerror(errno));
+		return NULL;
+	}
+
+	size_t length = 0;
+	size_t capacity = 65536;
+	uint8_t* data = malloc(capacity);
+
+	while (data != NULL) {
+		length += fread(data + length, 1, capacity - length, file);
+		if (length < capacity) {
+			break;
+		}
+
+		capacity *= 2;
+		uint8_t* grown = realloc(data, capacity);
+		if (grown == NULL) {
+			free(data);
+		}
+		data = grown;
+	}
+
+	if (data == NULL) {
+		fprintf(stderr, "Out of memory reading %s\n", path);
+	} else if (ferror(file)) {
+		fprintf(stderr, "Can't read %s: %s\n", path, strerror(errno));
+		free(data);
+		data = NULL;
+	}
+
+	if (file != stdin) {
+		fclose(file);
+	}
+
+	*length_out = length;
+	return data;
+}
+
+static void print_frame(
+	uint64_t frame_index,
+	const spio_trace_record_t* record,
+	const apa102_pixel_t* pixels,
+	const char* error
+) {
+	printf("{\"frame\": %llu, ", (unsigned long long) frame_index);
+	if (record->timestamp_usec > 0) {
+		printf("\"timestampUsec\": %llu, ", (unsigned long long) record->timestamp_usec);
+	}
+	printf("\"valid\": %s, ", record->valid ? "true" : "false");
+	if (error != NULL && error[0] != 0) {
+		printf("\"error\": \"%s\", ", error);
+	}
+	printf("\"frameLength\": %u, \"startLength\": %u, \"pixelCount\": %u, \"endLength\": %u, \"endByte\": %u",
+		record->frame_length,
+		record->start_length,
+		record->pixel_count,
+		record->end_length,
+		record->end_byte
+	);
+
+	if (! g_decode_config.summary) {
+		// Red, green, blue and the 5-bit brightness of each pixel
+		printf(", \"pixels\": [");
+		for (uint32_t i=0; i<record->pixel_count; i++) {
+			uint8_t rgb[3];
+			apa102_pixel_rgb(&pixels[i], g_decode_config.color_channel_order, rgb);
+			printf("%s[%u,%u,%u,%u]", i > 0 ? "," : "", rgb[0], rgb[1], rgb[2], pixels[i].brightness);
+		}
+		printf("]");
+	}
+
+	printf("}\n");
+}
+
+/**
+ * Decodes and prints trace records. Returns the number of invalid frames, or -1 if the trace is corrupt.
+ */
+static int64_t decode_trace(const uint8_t* data, size_t length) {
+	int64_t invalid_frames = 0;
+	uint64_t frame_index = 0;
+
+	for (size_t offset=0; offset<length; frame_index++) {
+		spio_trace_record_t record;
+		if (length - offset < sizeof(record)) {
+			fprintf(stderr, "Trace ends in the middle of frame %llu\n", (unsigned long long) frame_index);
+			return -1;
+		}
+
+		memcpy(&record, &data[offset], sizeof(record));
+		size_t record_length = sizeof(record) + (size_t) record.pixel_count * sizeof(apa102_pixel_t);
+		if (record.magic != SPIO_TRACE_MAGIC || length - offset < record_length) {
+			fprintf(stderr, "Trace is corrupt at frame %llu\n", (unsigned long long) frame_index);
+			return -1;
+		}
+
+		print_frame(frame_index, &record, (const apa102_pixel_t*) &data[offset + sizeof(record)], NULL);
+		invalid_frames += record.valid ? 0 : 1;
+		offset += record_length;
+	}
+
+	return invalid_frames;
+}
+
+/**
+ * Decodes and prints raw frames of frame_bytes bytes each. Returns the number of invalid frames, or -1 on failure.
+ */
+static int64_t decode_raw(const uint8_t* data, size_t length, size_t frame_bytes) {
+	apa102_pixel_t* pixels = malloc(max(frame_bytes / 4, 1) * sizeof(apa102_pixel_t));
+	if (pixels == NULL) {
+		fprintf(stderr, "Out of memory decoding frames of %zu bytes\n", frame_bytes);
+		return -1;
+	}
+
+	int64_t invalid_frames = 0;
+	uint64_t frame_index = 0;
+
+	for (size_t offset=0; offset<length; offset+=frame_bytes, frame_index++) {
+		size_t frame_length = min(frame_bytes, length - offset);
+
+		apa102_frame_info_t info;
+		apa102_decode_frame(&data[offset], frame_length, pixels, (uint32_t) (frame_bytes / 4), &info);
+
+		spio_trace_record_t record = {
+			.magic = SPIO_TRACE_MAGIC,
+			.pixel_count = info.pixel_count,
+			.timestamp_usec = 0,
+			.frame_length = (uint32_t) frame_length,
+			.start_length = info.start_length,
+			.end_length = info.end_length,
+			.end_byte = info.end_byte,
+			.valid = info.valid ? 1 : 0
+		};
+		print_frame(frame_index, &record, pixels, info.error);
+		invalid_frames += info.valid ? 0 : 1;
+	}
+
+	free(pixels);
+	return invalid_frames;
+}
+
+static void print_usage(const char* name) {
+	printf("Usage: %s [options] <trace or raw capture, or - for stdin>\n\n", name);
+	printf("--frame-bytes <val>, -f <val>\n\tCuts a raw capture into frames of this many bytes (default: the whole input is one frame)\n");
+	printf("--channel-order <val>, -o <val>\n\tThe color channel order the frames were sent with (RGB, RBG, GRB, GBR, BGR or BRG; default BGR)\n");
+	printf("--summary, -s\n\tLeaves out the pixels, printing only the frame layout and timing\n");
+	printf("--help, -h\n\tShows this message\n");
+}
+
+int main(int argc, char** argv) {
+	static struct option long_options[] = {
+		{"frame-bytes", required_argument, NULL, 'f'},
+		{"channel-order", required_argument, NULL, 'o'},
+		{"summary", no_argument, NULL, 's'},
+		{"help", no_argument, NULL, 'h'},
+		{0, 0, 0, 0}
+	};
+
+	int opt;
+	while ((opt = getopt_long(argc, argv, "f:o:sh", long_options, NULL)) != -1) {
+		switch (opt) {
+			case 'f': {
+				g_decode_config.frame_bytes = (uint32_t) atoi(optarg);
+			} break;
+
+			case 'o': {
+				g_decode_config.color_channel_order = color_channel_order_from_string(optarg);
+			} break;
+
+			case 's': {
+				g_decode_config.summary = true;
+			} break;
+
+			case 'h': {
+				print_usage(argv[0]);
+				return 0;
+			}
+
+			default: {
+				print_usage(argv[0]);
+				return 2;
+			}
+		}
+	}
+
+	if (optind != argc - 1) {
+		print_usage(argv[0]);
+		return 2;
+	}
+
+	size_t length = 0;
+	uint8_t* data = read_input(argv[optind], &length);
+	if (data == NULL) {
+		return 2;
+	}
+
+	uint32_t magic = 0;
+	if (length >= sizeof(magic)) {
+		memcpy(&magic, data, sizeof(magic));
+	}
+
+	int64_t invalid_frames = magic == SPIO_TRACE_MAGIC
+		? decode_trace(data, length)
+		: decode_raw(data, length, g_decode_config.frame_bytes > 0 ? g_decode_config.frame_bytes : max(length, 1));
+
+	free(data);
+
+	if (invalid_frames < 0) {
+		return 2;
+	}
+
+	return invalid_frames > 0 ? 1 : 0;
+}
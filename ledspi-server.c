@@ -15,8 +15,21 @@
 #include <ifaddrs.h>
 #include <net/if.h>
 #include <sys/mman.h>
+#include <sys/timerfd.h>
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <sched.h>
 #include "util.h"
 #include "spio.h"
+#include "spio_writer.h"
+#include "render.h"
+#include "render_pool.h"
+#include "render_governor.h"
+#include "render_latency.h"
+#include "render_pll.h"
+#include "render_jitter.h"
+#include "chipset.h"
+#include "netout.h"
 
 #include "lib/cesanta/net_skeleton.h"
 #include "lib/cesanta/frozen.h"
@@ -39,7 +52,15 @@
 #define maxt(t, a, b) ((t) (a) > (t) (b) ? (a) : (b))
 
 static const int MAX_CONFIG_FILE_LENGTH_BYTES = 1024*1024*10;
-static const uint32_t SPISCAPE_MAX_STRIPS = 1;
+
+// Each strip is driven from its own SPI device
+#define SPISCAPE_MAX_STRIPS 8
+
+// One SPI buffer on the wire while the next one is rendered
+static const uint32_t SPI_BUFFER_COUNT = 2;
+
+// While the output is static, resend it this often so LEDs that lost power or were hot-plugged catch up
+static const uint64_t STATIC_SCENE_KEEPALIVE_USEC = 1000000;
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // TYPES
@@ -53,6 +74,7 @@ typedef enum {
 
 
 typedef struct {
+	// One SPI device per strip, separated by commas
 	char spi_dev_path[512];
 	uint32_t spi_speed_hz;
 
@@ -66,10 +88,35 @@ typedef struct {
 	uint32_t used_strip_count;
 
 	color_channel_order_t color_channel_order;
+	char chipset[32];
+
+	// E1.31 and DDP destinations to forward the rendered frames to, separated by commas; see netout.h
+	char net_outputs[1024];
+
+	// Per-pixel color calibration gains, applied after the lookup tables; see render_gain_load(). Empty for none.
+	char calibration_file[512];
 
 	uint8_t interpolation_enabled;
+	uint8_t cubic_interpolation_enabled;
+
+	// Show frames as soon as they arrive, extrapolating between them; see render_latency.h
+	uint8_t low_latency_enabled;
+
+	// How long to hold timed frames so they can be shown on the sender's timeline, in milliseconds: 0 shows them as
+	// they arrive, RENDER_JITTER_DEPTH_AUTO follows the measured jitter; see render_jitter.h
+	int32_t jitter_buffer_ms;
+
 	uint8_t dithering_enabled;
+
+	// Dither against a fixed threshold pattern instead of diffusing rounding errors; see render.h
+	uint8_t ordered_dithering_enabled;
+
 	uint8_t lut_enabled;
+	uint8_t hdr_enabled;
+
+	char render_kernel[32];
+	uint32_t render_threads;
+	uint32_t refresh_rate_hz;
 
 	struct {
 		float red;
@@ -85,6 +132,37 @@ typedef struct {
 
 char g_config_filename[4096] = {0};
 
+// Pixel as received over OPC and e131
+typedef struct {
+	uint8_t r;
+	uint8_t g;
+	uint8_t b;
+} __attribute__((__packed__)) buffer_pixel_t;
+
+// A buffer in the frame queue, with the hash64() of its data (0 if unknown), the time the data is due to be shown and
+// the time it arrived; the same unless the frame waited in the jitter buffer
+typedef struct {
+	render_frame_t frame;
+	uint64_t hash;
+	struct timeval tv;
+	struct timeval arrival_tv;
+} frame_slot_t;
+
+// The render thread keeps the last few frames, for interpolation across more than two of them
+#define FRAME_HISTORY_LENGTH 4
+
+// Most timed frames that can wait in the jitter buffer at once; the oldest is dropped to make room for more
+#define JITTER_BUFFER_LENGTH 32
+
+// Source frame rate a fixed jitter buffer depth is sized for; see jitter_buffer_slot_count()
+#define JITTER_BUFFER_SOURCE_RATE_HZ 120
+
+// One buffer for the producers, one for the mailbox and the render thread's history; the jitter buffer's follow
+#define FRAME_QUEUE_SLOT_COUNT (FRAME_HISTORY_LENGTH + 2)
+
+// Set in the mailbox slot index while it holds a frame the render thread hasn't taken yet
+static const uint32_t FRAME_MAILBOX_FRESH = 0x80000000;
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Method declarations
 void teardown_server();
@@ -93,7 +171,16 @@ void ensure_server_setup();
 // Frame Manipulation
 void ensure_frame_data();
 void set_next_frame_data(uint8_t* frame_data, uint32_t data_size, uint8_t is_remote);
-void rotate_frames(uint8_t lock_frame_data);
+void set_next_channel_data(uint8_t channel, uint8_t* channel_data, uint32_t data_size, uint8_t is_remote);
+void set_timed_channel_data(
+	uint8_t channel,
+	uint64_t sender_usec,
+	uint8_t* channel_data,
+	uint32_t data_size,
+	uint8_t is_remote
+);
+uint8_t take_next_frame();
+void wake_render_thread();
 
 // Threads
 void* render_thread(void* threadarg);
@@ -219,85 +306,144 @@ server_config_t g_server_config = {
 	.leds_per_strip = 256,
 	.used_strip_count = 1,
 	.color_channel_order = COLOR_ORDER_BGR,
+	.chipset = "apa102",
+	.net_outputs = "",
+	.calibration_file = "",
 
 	.interpolation_enabled = TRUE,
+	.cubic_interpolation_enabled = FALSE,
+	.low_latency_enabled = FALSE,
+	.jitter_buffer_ms = 0,
 	.dithering_enabled = TRUE,
+	.ordered_dithering_enabled = FALSE,
 	.lut_enabled = TRUE,
+	.hdr_enabled = FALSE,
+
+	.render_kernel = "auto",
+	.render_threads = 0,
+	.refresh_rate_hz = 400,
 
 	.white_point = { .9, 1, 1},
 	.lum_power = 2,
 	.mutex = PTHREAD_MUTEX_INITIALIZER
 };
 
-typedef struct {
-	uint8_t r;
-	uint8_t g;
-	uint8_t b;
-} __attribute__((__packed__)) buffer_pixel_t;
+// Global runtime data
+static struct
+{
+	// Frame queue. Each buffer belongs to exactly one of the producers (the network and demo threads), the mailbox or
+	// the render thread at a time. Producers fill their buffer and swap it into the mailbox; the render thread takes a
+	// fresh buffer from the mailbox by swapping in its oldest frame's. Both swaps are atomic exchanges, so producers
+	// never wait for the renderer, and the renderer only swaps between frames. There are FRAME_QUEUE_SLOT_COUNT
+	// buffers, plus one for every frame the jitter buffer can hold.
+	frame_slot_t* frame_slots;
+	uint32_t frame_slot_count;
 
-// Pixel Delta
-typedef struct {
-	int8_t r;
-	int8_t g;
-	int8_t b;
+	// The producers' buffer; guarded by producer_mutex, which the render thread never takes
+	uint32_t producer_slot;
 
-	int8_t last_effect_frame_r;
-	int8_t last_effect_frame_g;
-	int8_t last_effect_frame_b;
-} __attribute__((__packed__)) pixel_delta_t;
+	// The mailbox buffer, with FRAME_MAILBOX_FRESH set until the render thread takes it; only accessed atomically
+	uint32_t mailbox_slot;
 
+	// The render thread's buffers, oldest first, of which the last history_count hold frames; guarded by mutex
+	uint32_t history_slots[FRAME_HISTORY_LENGTH];
+	uint32_t history_count;
 
-// Global runtime data
-static struct
-{
-	buffer_pixel_t* previous_frame_data;
-	buffer_pixel_t* current_frame_data;
-	buffer_pixel_t* next_frame_data;
+	// Jitter buffer: timed frames waiting to be shown, the earliest first, and the buffers free for more. Producers
+	// queue their buffer in exchange for a free one, and the render thread takes a frame once it is due, freeing its
+	// oldest frame's buffer. All guarded by jitter_mutex, which is only held to move buffers around.
+	uint32_t jitter_slot_count;
+	uint32_t jitter_slots[JITTER_BUFFER_LENGTH];
+	uint32_t jitter_count;
+	uint32_t jitter_free_slots[JITTER_BUFFER_LENGTH];
+	uint32_t jitter_free_count;
+	render_jitter_t jitter;
+
+	// When the last frame taken from the jitter buffer was due; frames due before that arrived out of order
+	struct timeval jitter_taken_tv;
+
+	// Frames dropped from the jitter buffer over the current stats interval
+	uint32_t jitter_dropped_frames;
+
+	render_dither_t frame_dithering_overflow;
+
+	// Gains from calibration_file for every pixel, if one is set
+	render_gain_t calibration_gain;
+	char calibration_file[512];
+
+	// Incremented whenever the calibration gains are reloaded
+	uint32_t calibration_version;
 
-	pixel_delta_t* frame_dithering_overflow;
+	// The latest data for every strip as 8-bit RGB, which data for single channels is merged into before it is
+	// published; guarded by producer_mutex
+	uint8_t* frame_rgb;
 
-	uint8_t* spi_buffer;
+	// One writer per strip, each sending that strip's output from its own thread
+	spio_writer_t* spi_writers[SPISCAPE_MAX_STRIPS];
 
-	uint8_t has_prev_frame;
-	uint8_t has_current_frame;
-	uint8_t has_next_frame;
+	// How the output is laid out on the wire; the writers' buffers are sized for it
+	const chipset_t* chipset;
 
+	// Frames hold strip_count strips of leds_per_strip pixels, one after the other
 	uint32_t frame_size;
 	uint32_t leds_per_strip;
+	uint32_t strip_count;
 
 	volatile uint32_t frame_counter;
 
-	struct timeval previous_frame_tv;
-	struct timeval current_frame_tv;
-	struct timeval next_frame_tv;
+	// One connection per strip, to the device at the same index in spi_dev_paths
+	spio_connection* spio_conns[SPISCAPE_MAX_STRIPS];
+	char spi_dev_paths[SPISCAPE_MAX_STRIPS][512];
+	uint32_t spio_conn_count;
 
-	struct timeval prev_current_delta_tv;
+	// The clock rate the connections were opened with
+	uint32_t spi_speed_hz;
 
-	spio_connection * spio_conn;
+	// Forwards the rendered frames to the network destinations listed in net_outputs, or NULL if there are none
+	netout_t* netout;
+	char net_outputs[1024];
 
 	uint32_t red_lookup[257];
 	uint32_t green_lookup[257];
 	uint32_t blue_lookup[257];
 
+	// Incremented whenever the lookup tables are rebuilt
+	uint32_t lookup_version;
+
+	// Guarded by producer_mutex
 	struct timeval last_remote_data_tv;
 
+	// Signalled whenever the render thread has something new to do; see wake_render_thread()
+	int render_wake_fd;
+
 	pthread_mutex_t mutex;
+	pthread_mutex_t producer_mutex;
+	pthread_mutex_t jitter_mutex;
 } g_runtime_state = {
-	.previous_frame_data = (buffer_pixel_t*)NULL,
-	.current_frame_data = (buffer_pixel_t*)NULL,
-	.next_frame_data = (buffer_pixel_t*)NULL,
-	.has_prev_frame = FALSE,
-	.has_current_frame = FALSE,
-	.has_next_frame = FALSE,
-	.frame_dithering_overflow = (pixel_delta_t*)NULL,
+	.frame_slots = NULL,
+	.frame_slot_count = 0,
+	.producer_slot = 0,
+	.mailbox_slot = 1,
+	.history_slots = { 2, 3, 4, 5 },
+	.history_count = 0,
+	.jitter_slot_count = 0,
+	.jitter_count = 0,
+	.jitter_free_count = 0,
 	.frame_size = 0,
+	.frame_rgb = NULL,
 	.leds_per_strip = 0,
+	.strip_count = 0,
+	.chipset = NULL,
 	.mutex = PTHREAD_MUTEX_INITIALIZER,
+	.producer_mutex = PTHREAD_MUTEX_INITIALIZER,
+	.jitter_mutex = PTHREAD_MUTEX_INITIALIZER,
 	.last_remote_data_tv = {
 		.tv_sec = 0,
 		.tv_usec = 0
 	},
-	.spio_conn = NULL
+	.spio_conn_count = 0,
+	.netout = NULL,
+	.render_wake_fd = -1
 };
 
 // Global thread handles
@@ -336,12 +482,24 @@ static struct option long_options[] =
 		{"strip-count", required_argument, NULL, 's'},
 
 		{"channel-order", required_argument, NULL, 'o'},
+		{"chipset", required_argument, NULL, 'x'},
+		{"net-output", required_argument, NULL, 'n'},
+		{"calibration", required_argument, NULL, 'G'},
 
 		{"demo-mode", required_argument, NULL, 'D'},
 
 		{"no-interpolation", no_argument, NULL, 'i'},
+		{"cubic-interpolation", no_argument, NULL, 'I'},
+		{"low-latency", no_argument, NULL, 'Q'},
+		{"jitter-buffer", required_argument, NULL, 'J'},
 		{"no-dithering", no_argument, NULL, 't'},
+		{"ordered-dithering", no_argument, NULL, 'O'},
 		{"no-lut", no_argument, NULL, 'l'},
+		{"hdr", no_argument, NULL, 'H'},
+
+		{"render-kernel", required_argument, NULL, 'k'},
+		{"render-threads", required_argument, NULL, 'T'},
+		{"refresh-rate", required_argument, NULL, 'R'},
 
 		{"help", no_argument, NULL, 'h'},
 
@@ -456,7 +614,7 @@ void handle_args(int argc, char ** argv) {
 	extern char *optarg;
 
 	int opt;
-	while ((opt = getopt_long(argc, argv, "p:P:c:s:d:D:o:ithlL:r:g:b:0:1:m:M:S:", long_options, NULL)) != -1)
+	while ((opt = getopt_long(argc, argv, "p:P:c:s:d:D:o:x:n:G:iIQJ:tOhlHk:T:R:L:r:g:b:0:1:m:M:S:", long_options, NULL)) != -1)
 	{
 		switch (opt)
 		{
@@ -486,22 +644,65 @@ void handle_args(int argc, char ** argv) {
 
 
 			case 'o': {
-				printf("WARN: Color order setting is not implemented yet.\n");
-				//g_server_config.color_channel_order = color_channel_order_from_string(optarg);
+				g_server_config.color_channel_order = color_channel_order_from_string(optarg);
+			} break;
+
+			case 'x': {
+				strlcpy(g_server_config.chipset, optarg, sizeof(g_server_config.chipset));
+			} break;
+
+			case 'n': {
+				strlcpy(g_server_config.net_outputs, optarg, sizeof(g_server_config.net_outputs));
+			} break;
+
+			case 'G': {
+				strlcpy(g_server_config.calibration_file, optarg, sizeof(g_server_config.calibration_file));
 			} break;
 
 			case 'i': {
 				g_server_config.interpolation_enabled = FALSE;
 			} break;
 
+			case 'I': {
+				g_server_config.cubic_interpolation_enabled = TRUE;
+			} break;
+
+			case 'Q': {
+				g_server_config.low_latency_enabled = TRUE;
+			} break;
+
+			case 'J': {
+				g_server_config.jitter_buffer_ms = strcasecmp(optarg, "auto") == 0 ? RENDER_JITTER_DEPTH_AUTO : atoi(optarg);
+			} break;
+
 			case 't': {
 				g_server_config.dithering_enabled = FALSE;
 			} break;
 
+			case 'O': {
+				g_server_config.ordered_dithering_enabled = TRUE;
+			} break;
+
 			case 'l': {
 				g_server_config.lut_enabled = FALSE;
 			} break;
 
+			case 'H': {
+				g_server_config.hdr_enabled = TRUE;
+			} break;
+
+			case 'k': {
+				strlcpy(g_server_config.render_kernel, optarg, sizeof(g_server_config.render_kernel));
+			} break;
+
+			case 'T': {
+				g_server_config.render_threads = (uint32_t) atoi(optarg);
+			} break;
+
+			case 'R': {
+				g_server_config.refresh_rate_hz = (uint32_t) atoi(optarg);
+			} break;
+
 			case 'L': {
 				g_server_config.lum_power = (float) atof(optarg);
 			} break;
@@ -559,7 +760,7 @@ void handle_args(int argc, char ** argv) {
 							case 'e': printf("The UDP port to listen for e131 data on"); break;
 							case 'c': printf("The number of pixels connected to each output channel"); break;
 							case 's': printf("The number of used output channels (improves performance by not interpolating/dithering unused channels)"); break;
-							case 'd': printf("The path to the SPI device to connect to"); break;
+							case 'd': printf("The path to the SPI device to connect to; give one per strip, separated by commas, to drive several strips in parallel. null, file:<path>, shm:<name> and trace:<path> stand in for a real device"); break;
 							case 'S': printf("The speed of the SPI device, in hertz"); break;
 							case 'D':
 								printf("Configures the idle (demo) mode which activates when no data arrives for more than 5 seconds. Modes:\n");
@@ -568,12 +769,21 @@ void handle_args(int argc, char ** argv) {
 						        printf("\t- fade   Display a rainbow fade across all LEDs\n");
 						        printf("\t- id     Send the channel index as all three color values or 0xAA (0b10101010) if channel and pixel index are equal");
 						        break;
-//							case 'o':
-//								printf("Specifies the color channel output order (RGB, RBG, GRB, GBR, BGR or BRG); default is BRG.");
-//						        break;
+							case 'o': printf("Specifies the color channel output order (RGB, RBG, GRB, GBR, BGR or BRG); default is BGR"); break;
+							case 'x': printf("The LED chipset of the strips (apa102, sk9822, hd107s, hd108, ws2801, lpd8806, ws2812 or sk6812; default apa102)"); break;
+							case 'n': printf("Also sends the rendered frames to E1.31 or DDP receivers, separated by commas: <e131|ddp>:<host>[:<port>][/<first pixel>[+<pixel count>]][#<first universe>][@<max fps>]"); break;
+							case 'G': printf("A calibration file of per-pixel red, green and blue gains to even out LEDs that differ in color or brightness"); break;
 							case 'i': printf("Disables interpolation between frames (choppier output but improves performance)"); break;
+							case 'I': printf("Interpolates along a curve through the last four frames instead of a straight line between the last two, for smoother motion from slow sources at the cost of one more frame of latency"); break;
+							case 'Q': printf("Shows each frame as soon as it arrives instead of interpolating towards it, extrapolating between frames while they arrive steadily (takes precedence over cubic interpolation)"); break;
+							case 'J': printf("Holds frames that carry the sender's timestamp for this many milliseconds, or auto to follow the measured network jitter, so bursts play back as evenly as they were sent (default 0 shows them as they arrive)"); break;
 							case 't': printf("Disables dithering (choppier output but improves performance)"); break;
+							case 'O': printf("Dithers against a fixed pattern that cycles with the frame counter instead of carrying each pixel's rounding error into its next frame (cheaper to render, reads and writes no per-pixel state)"); break;
 							case 'l': printf("Disables luminance correction (lower color values appear brighter than they should)"); break;
+							case 'H': printf("Uses the APA102 global brightness field for extra resolution in dark colors instead of dithering"); break;
+							case 'k': printf("Selects the render kernel (auto, scalar, sse2, avx2 or neon; default auto picks the fastest one this CPU supports)"); break;
+							case 'T': printf("The number of threads to render on (default 0 uses one per CPU for frames large enough to benefit)"); break;
+							case 'R': printf("The target refresh rate while frames are changing, in hertz (default 400; 0 renders frames back-to-back)"); break;
 							case 'L': printf("Sets the exponent of the luminance power function to the given floating point value (default 2)"); break;
 							case 'r': printf("Sets the red balance to the given floating point number (0-1, default .9)"); break;
 							case 'g': printf("Sets the red balance to the given floating point number (0-1, default 1)"); break;
@@ -633,9 +843,14 @@ int main(int argc, char ** argv)
 
 	fprintf(stderr,
 		"[main] Starting server on ports (tcp=%d, udp=%d) for %d pixels on %d strips\n",
-		g_server_config.tcp_port, g_server_config.udp_port, g_server_config.leds_per_strip, SPISCAPE_MAX_STRIPS
+		g_server_config.tcp_port, g_server_config.udp_port, g_server_config.leds_per_strip, g_server_config.used_strip_count
 	);
 
+	g_runtime_state.render_wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (g_runtime_state.render_wake_fd < 0) {
+		die("Failed to create render wake event: %s\n", strerror(errno));
+	}
+
 	pthread_create(&g_threads.render_thread, NULL, render_thread, NULL);
 	pthread_create(&g_threads.udp_server_thread, NULL, udp_server_thread, NULL);
 	pthread_create(&g_threads.tcp_server_thread, NULL, tcp_server_thread, NULL);
@@ -672,6 +887,32 @@ const char* build_pruN_program_name(
 	return out_pru_filename;
 }
 
+/**
+* Split a comma-separated list of SPI device paths, returning how many there were. Paths past SPISCAPE_MAX_STRIPS are
+* counted but not copied.
+*/
+static uint32_t split_spi_dev_paths(const char* path_list, char paths[SPISCAPE_MAX_STRIPS][512]) {
+	uint32_t path_count = 0;
+
+	for (const char* path_start = path_list; *path_start != 0; ) {
+		size_t path_length = strcspn(path_start, ",");
+
+		if (path_length > 0) {
+			if (path_count < SPISCAPE_MAX_STRIPS) {
+				strlcpy(paths[path_count], path_start, min(path_length + 1, 512));
+			}
+			path_count++;
+		}
+
+		path_start += path_length;
+		if (*path_start == ',') {
+			path_start++;
+		}
+	}
+
+	return path_count;
+}
+
 void ensure_server_setup() {
 	printf("[main] Initializing / Updating server...");
 
@@ -682,38 +923,105 @@ void ensure_server_setup() {
 	pthread_mutex_lock(&g_runtime_state.mutex);
 	pthread_mutex_lock(&g_server_config.mutex);
 
-	// Determine if we need to [re]initialize LedSPI
+	// Determine if we need to [re]initialize LedSPI: one device for each strip in use
+	char spi_dev_paths[SPISCAPE_MAX_STRIPS][512];
+	uint32_t spi_dev_count = min(
+		split_spi_dev_paths(g_server_config.spi_dev_path, spi_dev_paths),
+		min(g_server_config.used_strip_count, SPISCAPE_MAX_STRIPS)
+	);
 
-	bool spi_init_needed = false;
+	// Single-wire chipsets are timed by the SPI clock, so they pick it themselves
+	uint32_t spi_speed_hz = g_runtime_state.chipset->spi_speed_hz > 0
+		? g_runtime_state.chipset->spi_speed_hz
+		: g_server_config.spi_speed_hz;
 
-	if (g_runtime_state.spio_conn == NULL) {
-		spi_init_needed = true;
-	}
-	else if (strcasecmp(g_server_config.spi_dev_path, g_runtime_state.spio_conn->device_path) != 0) {
-		spi_init_needed = true;
+	bool spi_init_needed = spi_dev_count != g_runtime_state.spio_conn_count
+		|| spi_speed_hz != g_runtime_state.spi_speed_hz;
+
+	for (uint32_t i=0; i<spi_dev_count && ! spi_init_needed; i++) {
+		if (strcasecmp(spi_dev_paths[i], g_runtime_state.spi_dev_paths[i]) != 0) {
+			spi_init_needed = true;
+		}
 	}
 
 	if (spi_init_needed) {
-		if (g_runtime_state.spio_conn != NULL) {
+		if (g_runtime_state.spio_conn_count > 0) {
 			printf("[main] Closing SPI...");
 
-			spio_close(g_runtime_state.spio_conn);
-			g_runtime_state.spio_conn = NULL;
+			for (uint32_t i=0; i<g_runtime_state.spio_conn_count; i++) {
+				if (g_runtime_state.spi_writers[i] != NULL) {
+					spio_writer_flush(g_runtime_state.spi_writers[i]);
+				}
+				spio_close(g_runtime_state.spio_conns[i]);
+				g_runtime_state.spio_conns[i] = NULL;
+			}
+			g_runtime_state.spio_conn_count = 0;
 		}
 
 		// Init SPI
-		printf("[main] Connecting SPI...");
-		g_runtime_state.spio_conn = spio_open(
-			g_server_config.spi_dev_path,
-		    g_server_config.spi_speed_hz
-		);
-		printf(" OK at %d hz\n", g_runtime_state.spio_conn->speed_hz);
-		g_runtime_state.leds_per_strip = g_server_config.leds_per_strip;
+		for (uint32_t i=0; i<spi_dev_count; i++) {
+			strlcpy(g_runtime_state.spi_dev_paths[i], spi_dev_paths[i], sizeof(g_runtime_state.spi_dev_paths[i]));
+
+			printf("[main] Connecting SPI %s...", g_runtime_state.spi_dev_paths[i]);
+			g_runtime_state.spio_conns[i] = spio_open(
+				g_runtime_state.spi_dev_paths[i],
+				spi_speed_hz
+			);
+			if (g_runtime_state.spio_conns[i] == NULL) {
+				die("[main] Failed to open SPI output %s\n", g_runtime_state.spi_dev_paths[i]);
+			}
+			printf(" OK at %d hz\n", g_runtime_state.spio_conns[i]->speed_hz);
+		}
+		g_runtime_state.spio_conn_count = spi_dev_count;
+		g_runtime_state.spi_speed_hz = spi_speed_hz;
+	}
+
+	// [Re]start network output whenever the destinations change
+	if (strcmp(g_server_config.net_outputs, g_runtime_state.net_outputs) != 0) {
+		netout_destroy(g_runtime_state.netout);
+		g_runtime_state.netout = NULL;
+		strlcpy(g_runtime_state.net_outputs, g_server_config.net_outputs, sizeof(g_runtime_state.net_outputs));
+
+		if (strlen(g_runtime_state.net_outputs) > 0) {
+			printf("[main] Starting network output...\n");
+			g_runtime_state.netout = netout_create(g_runtime_state.net_outputs);
+			if (g_runtime_state.netout == NULL) {
+				die("[main] Failed to start network output %s\n", g_runtime_state.net_outputs);
+			}
+		}
+	}
+
+	// Give the LEDs time to latch after every frame
+	for (uint32_t i=0; i<g_runtime_state.spio_conn_count; i++) {
+		g_runtime_state.spio_conns[i]->latch_usec = g_runtime_state.chipset->latch_usec;
+	}
+
+	// Single-wire LEDs latch whenever the data line idles, so a frame split across spidev messages shows up half drawn.
+	// Only spidev has a message limit.
+	uint32_t frame_length = chipset_frame_length(g_runtime_state.chipset, g_runtime_state.leds_per_strip);
+	for (uint32_t i=0; i<g_runtime_state.spio_conn_count; i++) {
+		uint32_t max_message_bytes = g_runtime_state.spio_conns[i]->max_message_bytes;
+
+		if (g_runtime_state.chipset->spi_speed_hz > 0 && max_message_bytes > 0 && frame_length > max_message_bytes) {
+			die(
+				"[main] %s frames for %u LEDs take %u bytes, more than the %u that spidev sends at once on %s. The LEDs "
+				"would latch between the pieces. Raise spidev's bufsiz (e.g. spidev.bufsiz=65536 on the kernel command "
+				"line) or spread the LEDs over more strips.\n",
+				g_runtime_state.chipset->name,
+				g_runtime_state.leds_per_strip,
+				frame_length,
+				max_message_bytes,
+				g_runtime_state.spi_dev_paths[i]
+			);
+		}
 	}
 
 	pthread_mutex_unlock(&g_server_config.mutex);
 	pthread_mutex_unlock(&g_runtime_state.mutex);
 
+	// Pick up the new settings right away, even if the render thread is idle
+	wake_render_thread();
+
 	// Display server config as JSON
 	char json_buffer[4096] = { 0 };
 	server_config_to_json(json_buffer, sizeof(json_buffer), &g_server_config);
@@ -793,11 +1101,48 @@ int validate_server_config(
 	assert_int_range_inclusive("LED Count", 1, 8096, input_config->leds_per_strip);
 
 	// usedStripCount
-	assert_int_range_inclusive("Strip/Channel Count", 1, 1, input_config->used_strip_count);
+	assert_int_range_inclusive("Strip/Channel Count", 1, SPISCAPE_MAX_STRIPS, input_config->used_strip_count);
+
+	// spiDevPath: one device per strip
+	char spi_dev_paths[SPISCAPE_MAX_STRIPS][512];
+	uint32_t spi_dev_count = split_spi_dev_paths(input_config->spi_dev_path, spi_dev_paths);
+	if (spi_dev_count < input_config->used_strip_count) {
+		add_error(
+			"\n\t\t\"" "Given Strip/Channel Count (%d) needs as many SPI devices, but only %d given" "\",",
+			input_config->used_strip_count,
+			spi_dev_count
+		);
+	}
 
 	// colorChannelOrder
 	assert_enum_valid("Color Channel Order", input_config->color_channel_order);
 
+	// chipset
+	if (chipset_find(input_config->chipset) == NULL) {
+		add_error(
+			"\n\t\t\"" "Unknown chipset %s" "\",",
+			input_config->chipset
+		);
+	}
+
+	// netOutputs
+	netout_destination_t net_destinations[NETOUT_MAX_DESTINATIONS];
+	char net_error[1024];
+	if (netout_parse_destinations(input_config->net_outputs, net_destinations, net_error, sizeof(net_error)) < 0) {
+		add_error(
+			"\n\t\t\"" "%s" "\",",
+			net_error
+		);
+	}
+
+	// calibrationFile
+	if (strlen(input_config->calibration_file) > 0 && access(input_config->calibration_file, R_OK) != 0) {
+		add_error(
+			"\n\t\t\"" "Can't read calibration file %s" "\",",
+			input_config->calibration_file
+		);
+	}
+
 	// opcTcpPort
 	assert_int_range_inclusive("OPC TCP Port", 1, 65535, input_config->tcp_port);
 
@@ -807,6 +1152,17 @@ int validate_server_config(
 	// e131Port
 	assert_int_range_inclusive("e131 UDP Port", 1, 65535, input_config->e131_port);
 
+	// refreshRateHz
+	assert_int_range_inclusive("Refresh Rate", 0, 10000, input_config->refresh_rate_hz);
+
+	// jitterBufferMs
+	assert_int_range_inclusive(
+		"Jitter Buffer",
+		RENDER_JITTER_DEPTH_AUTO,
+		RENDER_JITTER_MAX_DEPTH_USEC / 1000,
+		input_config->jitter_buffer_ms
+	);
+
 	// lumCurvePower
 	assert_double_range_inclusive("Luminance Curve Power", 0, 10, input_config->lum_power);
 
@@ -899,6 +1255,18 @@ int server_config_from_json(
 		output_config->color_channel_order = color_channel_order_from_string(token_value);
 	}
 
+	if ((token = find_json_token(json_tokens, "chipset"))) {
+		strlcpy(output_config->chipset, token->ptr, mint(int32_t, sizeof(output_config->chipset), token->len + 1));
+	}
+
+	if ((token = find_json_token(json_tokens, "netOutputs"))) {
+		strlcpy(output_config->net_outputs, token->ptr, mint(int32_t, sizeof(output_config->net_outputs), token->len + 1));
+	}
+
+	if ((token = find_json_token(json_tokens, "calibrationFile"))) {
+		strlcpy(output_config->calibration_file, token->ptr, mint(int32_t, sizeof(output_config->calibration_file), token->len + 1));
+	}
+
 	if ((token = find_json_token(json_tokens, "opcTcpPort"))) {
 		strlcpy(token_value, token->ptr, mint(int32_t, sizeof(token_value), token->len + 1));
 		output_config->tcp_port = (uint16_t) atoi(token_value);
@@ -914,16 +1282,55 @@ int server_config_from_json(
 		output_config->interpolation_enabled = strcasecmp(token_value, "true") == 0 ? TRUE : FALSE;
 	}
 
+	if ((token = find_json_token(json_tokens, "enableCubicInterpolation"))) {
+		strlcpy(token_value, token->ptr, mint(int32_t, sizeof(token_value), token->len + 1));
+		output_config->cubic_interpolation_enabled = strcasecmp(token_value, "true") == 0 ? TRUE : FALSE;
+	}
+
+	if ((token = find_json_token(json_tokens, "lowLatency"))) {
+		strlcpy(token_value, token->ptr, mint(int32_t, sizeof(token_value), token->len + 1));
+		output_config->low_latency_enabled = strcasecmp(token_value, "true") == 0 ? TRUE : FALSE;
+	}
+
+	if ((token = find_json_token(json_tokens, "jitterBufferMs"))) {
+		strlcpy(token_value, token->ptr, mint(int32_t, sizeof(token_value), token->len + 1));
+		output_config->jitter_buffer_ms = (int32_t) atoi(token_value);
+	}
+
 	if ((token = find_json_token(json_tokens, "enableDithering"))) {
 		strlcpy(token_value, token->ptr, mint(int32_t, sizeof(token_value), token->len + 1));
 		output_config->dithering_enabled = strcasecmp(token_value, "true") == 0 ? TRUE : FALSE;
 	}
 
+	if ((token = find_json_token(json_tokens, "enableOrderedDithering"))) {
+		strlcpy(token_value, token->ptr, mint(int32_t, sizeof(token_value), token->len + 1));
+		output_config->ordered_dithering_enabled = strcasecmp(token_value, "true") == 0 ? TRUE : FALSE;
+	}
+
 	if ((token = find_json_token(json_tokens, "enableLookupTable"))) {
 		strlcpy(token_value, token->ptr, mint(int32_t, sizeof(token_value), token->len + 1));
 		output_config->lut_enabled = strcasecmp(token_value, "true") == 0 ? TRUE : FALSE;
 	}
 
+	if ((token = find_json_token(json_tokens, "enableHdr"))) {
+		strlcpy(token_value, token->ptr, mint(int32_t, sizeof(token_value), token->len + 1));
+		output_config->hdr_enabled = strcasecmp(token_value, "true") == 0 ? TRUE : FALSE;
+	}
+
+	if ((token = find_json_token(json_tokens, "renderKernel"))) {
+		strlcpy(output_config->render_kernel, token->ptr, mint(int32_t, sizeof(output_config->render_kernel), token->len + 1));
+	}
+
+	if ((token = find_json_token(json_tokens, "renderThreads"))) {
+		strlcpy(token_value, token->ptr, mint(int32_t, sizeof(token_value), token->len + 1));
+		output_config->render_threads = (uint32_t) atoi(token_value);
+	}
+
+	if ((token = find_json_token(json_tokens, "refreshRateHz"))) {
+		strlcpy(token_value, token->ptr, mint(int32_t, sizeof(token_value), token->len + 1));
+		output_config->refresh_rate_hz = (uint32_t) atoi(token_value);
+	}
+
 	if ((token = find_json_token(json_tokens, "lumCurvePower"))) {
 		strlcpy(token_value, token->ptr, mint(int32_t, sizeof(token_value), token->len + 1));
 		output_config->lum_power = atof(token_value);
@@ -964,13 +1371,24 @@ void server_config_to_json(char* dest_string, size_t dest_string_size, server_co
 			"\t" "\"ledsPerStrip\": %d," "\n"
 			"\t" "\"usedStripCount\": %d," "\n"
 			"\t" "\"colorChannelOrder\": \"%s\"," "\n"
+			"\t" "\"chipset\": \"%s\"," "\n"
+			"\t" "\"netOutputs\": \"%s\"," "\n"
+			"\t" "\"calibrationFile\": \"%s\"," "\n"
 
 			"\t" "\"opcTcpPort\": %d," "\n"
 			"\t" "\"opcUdpPort\": %d," "\n"
 
 			"\t" "\"enableInterpolation\": %s," "\n"
+			"\t" "\"enableCubicInterpolation\": %s," "\n"
+			"\t" "\"lowLatency\": %s," "\n"
+			"\t" "\"jitterBufferMs\": %d," "\n"
 			"\t" "\"enableDithering\": %s," "\n"
+			"\t" "\"enableOrderedDithering\": %s," "\n"
 			"\t" "\"enableLookupTable\": %s," "\n"
+			"\t" "\"enableHdr\": %s," "\n"
+			"\t" "\"renderKernel\": \"%s\"," "\n"
+			"\t" "\"renderThreads\": %d," "\n"
+			"\t" "\"refreshRateHz\": %d," "\n"
 
 			"\t" "\"lumCurvePower\": %.4f," "\n"
 			"\t" "\"whitePoint\": {" "\n"
@@ -989,13 +1407,24 @@ void server_config_to_json(char* dest_string, size_t dest_string_size, server_co
 		input_config->used_strip_count,
 
 		color_channel_order_to_string(input_config->color_channel_order),
+		input_config->chipset,
+		input_config->net_outputs,
+		input_config->calibration_file,
 
 		input_config->tcp_port,
 		input_config->udp_port,
 
 		input_config->interpolation_enabled ? "true" : "false",
+		input_config->cubic_interpolation_enabled ? "true" : "false",
+		input_config->low_latency_enabled ? "true" : "false",
+		input_config->jitter_buffer_ms,
 		input_config->dithering_enabled ? "true" : "false",
+		input_config->ordered_dithering_enabled ? "true" : "false",
 		input_config->lut_enabled ? "true" : "false",
+		input_config->hdr_enabled ? "true" : "false",
+		input_config->render_kernel,
+		input_config->render_threads,
+		input_config->refresh_rate_hz,
 
 		(double)input_config->lum_power,
 		(double)input_config->white_point.red,
@@ -1033,143 +1462,558 @@ void build_lookup_tables() {
 		}
 	}
 
+	g_runtime_state.lookup_version++;
+
 	pthread_mutex_unlock(&g_server_config.mutex);
 	pthread_mutex_unlock(&g_runtime_state.mutex);
 }
 
+/**
+ * Returns how many frames the jitter buffer needs room for at a depth of jitter_buffer_ms milliseconds: none when it is
+ * off, JITTER_BUFFER_LENGTH for an automatic depth, and otherwise the frames a JITTER_BUFFER_SOURCE_RATE_HZ source
+ * sends over the depth, plus one.
+ */
+static uint32_t jitter_buffer_slot_count(int32_t jitter_buffer_ms) {
+	if (jitter_buffer_ms == 0) {
+		return 0;
+	}
+	if (jitter_buffer_ms == RENDER_JITTER_DEPTH_AUTO) {
+		return JITTER_BUFFER_LENGTH;
+	}
+
+	uint32_t frame_count = ((uint32_t) jitter_buffer_ms * JITTER_BUFFER_SOURCE_RATE_HZ + 999) / 1000 + 1;
+	return min(frame_count, JITTER_BUFFER_LENGTH);
+}
+
 /**
 * Ensure that the frame buffers are allocated to the correct values.
 */
 void ensure_frame_data() {
 	pthread_mutex_lock(&g_server_config.mutex);
-	uint32_t led_count = (uint32_t)(g_server_config.leds_per_strip) * SPISCAPE_MAX_STRIPS;
+	uint32_t leds_per_strip = g_server_config.leds_per_strip;
+	uint32_t strip_count = min(g_server_config.used_strip_count, SPISCAPE_MAX_STRIPS);
+	const chipset_t* chipset = chipset_find(g_server_config.chipset);
+	uint32_t jitter_slot_count = jitter_buffer_slot_count(g_server_config.jitter_buffer_ms);
+	char calibration_file[sizeof(g_server_config.calibration_file)];
+	strlcpy(calibration_file, g_server_config.calibration_file, sizeof(calibration_file));
 	pthread_mutex_unlock(&g_server_config.mutex);
 
+	if (chipset == NULL) {
+		die("Can't drive %s LEDs\n", g_server_config.chipset);
+	}
+
+	uint32_t led_count = leds_per_strip * strip_count;
+
+	// Reallocating is the one time both the render thread and the producers have to stop
 	pthread_mutex_lock(&g_runtime_state.mutex);
-	if (g_runtime_state.frame_size != led_count) {
-		fprintf(stderr, "Allocating buffers for %d pixels (%lu bytes)\n", led_count, led_count * 3 /*channels*/ * 4 /*buffers*/ * sizeof(uint16_t));
-
-		if (g_runtime_state.previous_frame_data != NULL) {
-			free(g_runtime_state.previous_frame_data);
-			free(g_runtime_state.current_frame_data);
-			free(g_runtime_state.next_frame_data);
-			free(g_runtime_state.frame_dithering_overflow);
-			free(g_runtime_state.spi_buffer);
+	pthread_mutex_lock(&g_runtime_state.producer_mutex);
+	if (g_runtime_state.leds_per_strip != leds_per_strip
+		|| g_runtime_state.strip_count != strip_count
+		|| g_runtime_state.chipset != chipset
+		|| g_runtime_state.jitter_slot_count != jitter_slot_count
+	) {
+		uint32_t frame_slot_count = FRAME_QUEUE_SLOT_COUNT + jitter_slot_count;
+		fprintf(stderr, "Allocating buffers for %d pixels (%lu bytes)\n", led_count, led_count * 3 /*channels*/ * ((frame_slot_count + 1) /*frames*/ * sizeof(uint8_t) + (chipset->wide ? 0 : sizeof(int16_t) + sizeof(int8_t)) /*dithering*/));
+
+		if (g_runtime_state.frame_rgb != NULL) {
+			for (uint32_t i=0; i<g_runtime_state.frame_slot_count; i++) {
+				render_frame_free(&g_runtime_state.frame_slots[i].frame);
+			}
+			free(g_runtime_state.frame_slots);
+			render_dither_free(&g_runtime_state.frame_dithering_overflow);
+			free(g_runtime_state.frame_rgb);
+
+			for (uint32_t i=0; i<g_runtime_state.strip_count; i++) {
+				spio_writer_destroy(g_runtime_state.spi_writers[i]);
+				g_runtime_state.spi_writers[i] = NULL;
+			}
 		}
 
 		g_runtime_state.frame_size = led_count;
-		g_runtime_state.previous_frame_data = malloc(led_count * sizeof(buffer_pixel_t));
-		g_runtime_state.current_frame_data = malloc(led_count * sizeof(buffer_pixel_t));
-		g_runtime_state.next_frame_data = malloc(led_count * sizeof(buffer_pixel_t));
-		g_runtime_state.spi_buffer = malloc(4 + led_count*4 + led_count / 16 + 1);
-		g_runtime_state.frame_dithering_overflow = malloc(led_count * sizeof(pixel_delta_t));
-		g_runtime_state.has_next_frame = FALSE;
+		g_runtime_state.leds_per_strip = leds_per_strip;
+		g_runtime_state.strip_count = strip_count;
+		g_runtime_state.chipset = chipset;
+		g_runtime_state.frame_slots = calloc(frame_slot_count, sizeof(frame_slot_t));
+		if (g_runtime_state.frame_slots == NULL) {
+			die("Failed to allocate %d frame buffers\n", frame_slot_count);
+		}
+		g_runtime_state.frame_slot_count = frame_slot_count;
+		for (uint32_t i=0; i<frame_slot_count; i++) {
+			if (! render_frame_alloc(&g_runtime_state.frame_slots[i].frame, led_count)) {
+				die("Failed to allocate frame buffers for %d pixels\n", led_count);
+			}
+
+			g_runtime_state.frame_slots[i].hash = 0;
+			monotonic_time(&g_runtime_state.frame_slots[i].tv);
+			g_runtime_state.frame_slots[i].arrival_tv = g_runtime_state.frame_slots[i].tv;
+		}
+		// 16-bit chipsets are never dithered
+		if (! chipset->wide && ! render_dither_alloc(&g_runtime_state.frame_dithering_overflow, led_count)) {
+			die("Failed to allocate frame buffers for %d pixels\n", led_count);
+		}
+		g_runtime_state.frame_rgb = calloc(led_count, sizeof(buffer_pixel_t));
+		if (g_runtime_state.frame_rgb == NULL) {
+			die("Failed to allocate frame buffers for %d pixels\n", led_count);
+		}
+		for (uint32_t i=0; i<strip_count; i++) {
+			g_runtime_state.spi_writers[i] = spio_writer_create(SPI_BUFFER_COUNT, chipset_frame_length(chipset, leds_per_strip));
+			if (g_runtime_state.spi_writers[i] == NULL) {
+				die("Failed to create SPI writer for %d pixels\n", leds_per_strip);
+			}
+		}
 		printf("frame_size1=%u\n", g_runtime_state.frame_size);
 
-		// Init timestamps
-		gettimeofday(&g_runtime_state.previous_frame_tv, NULL);
-		gettimeofday(&g_runtime_state.current_frame_tv, NULL);
-		gettimeofday(&g_runtime_state.next_frame_tv, NULL);
+		// Start over with an empty queue
+		g_runtime_state.producer_slot = 0;
+		__atomic_store_n(&g_runtime_state.mailbox_slot, 1, __ATOMIC_RELEASE);
+		for (uint32_t i=0; i<FRAME_HISTORY_LENGTH; i++) {
+			g_runtime_state.history_slots[i] = 2 + i;
+		}
+		g_runtime_state.history_count = 0;
+
+		pthread_mutex_lock(&g_runtime_state.jitter_mutex);
+		g_runtime_state.jitter_slot_count = jitter_slot_count;
+		g_runtime_state.jitter_count = 0;
+		for (uint32_t i=0; i<jitter_slot_count; i++) {
+			g_runtime_state.jitter_free_slots[i] = FRAME_QUEUE_SLOT_COUNT + i;
+		}
+		g_runtime_state.jitter_free_count = jitter_slot_count;
+		render_jitter_init(&g_runtime_state.jitter);
+		timerclear(&g_runtime_state.jitter_taken_tv);
+		pthread_mutex_unlock(&g_runtime_state.jitter_mutex);
+	}
+
+	// [Re]load the calibration gains whenever the file or the pixel count changes
+	if (strcmp(calibration_file, g_runtime_state.calibration_file) != 0
+		|| g_runtime_state.calibration_gain.pixel_count != (strlen(calibration_file) > 0 ? led_count : 0)
+	) {
+		render_gain_free(&g_runtime_state.calibration_gain);
+		strlcpy(g_runtime_state.calibration_file, calibration_file, sizeof(g_runtime_state.calibration_file));
+		g_runtime_state.calibration_version++;
+
+		if (strlen(calibration_file) > 0) {
+			if (! render_gain_alloc(&g_runtime_state.calibration_gain, led_count)) {
+				die("Failed to allocate calibration gains for %d pixels\n", led_count);
+			}
+			if (! render_gain_load(&g_runtime_state.calibration_gain, calibration_file)) {
+				die("[main] Failed to load calibration file %s\n", calibration_file);
+			}
+			printf("[main] Loaded calibration gains for %u pixels from %s\n", led_count, calibration_file);
+		}
 	}
+	pthread_mutex_unlock(&g_runtime_state.producer_mutex);
 	pthread_mutex_unlock(&g_runtime_state.mutex);
 }
 
 /**
-* Set the next frame of data to the given 8-bit RGB buffer after rotating the buffers.
+* Copy frame_rgb into the producers' buffer, stamped with the current time. Must be called with the producer mutex held.
+*/
+static frame_slot_t* fill_producer_slot(uint8_t is_remote) {
+	frame_slot_t* slot = &g_runtime_state.frame_slots[g_runtime_state.producer_slot];
+	uint32_t frame_rgb_size = g_runtime_state.frame_size * sizeof(buffer_pixel_t);
+
+	// Copy in new data, splitting it into channel planes. Clients streaming a still image send the same frame over and
+	// over; the buffer handed back often holds it already.
+	uint64_t frame_hash = hash64(g_runtime_state.frame_rgb, frame_rgb_size);
+	if (frame_hash != slot->hash) {
+		render_frame_set_rgb(&slot->frame, g_runtime_state.frame_rgb, frame_rgb_size);
+		slot->hash = frame_hash;
+	}
+
+	// Update the timestamp
+	monotonic_time(&slot->tv);
+	slot->arrival_tv = slot->tv;
+
+	// Update remote data timestamp if applicable
+	if (is_remote) {
+		monotonic_time(&g_runtime_state.last_remote_data_tv);
+	}
+
+	return slot;
+}
+
+/**
+* Publish frame_rgb as the next frame. Never waits for the render thread; if it hasn't taken the last published frame
+* yet, that frame is dropped in favor of this one. Must be called with the producer mutex held.
+*/
+static void publish_frame_data(uint8_t is_remote) {
+	fill_producer_slot(is_remote);
+
+	// Publish the frame, taking the mailbox's buffer in exchange
+	uint32_t mailbox_slot = __atomic_exchange_n(
+		&g_runtime_state.mailbox_slot,
+		g_runtime_state.producer_slot | FRAME_MAILBOX_FRESH,
+		__ATOMIC_ACQ_REL
+	);
+	g_runtime_state.producer_slot = mailbox_slot & ~FRAME_MAILBOX_FRESH;
+}
+
+/**
+* Queue frame_rgb in the jitter buffer, to be shown when render_jitter_frame_arrived() says. Frames due before the last
+* one the render thread took arrived out of order, and are dropped. Must be called with the producer mutex held.
+*/
+static void publish_timed_frame_data(uint64_t sender_usec, int32_t jitter_buffer_ms, uint8_t is_remote) {
+	frame_slot_t* slot = fill_producer_slot(is_remote);
+
+	pthread_mutex_lock(&g_runtime_state.jitter_mutex);
+
+	uint64_t present_usec = render_jitter_frame_arrived(
+		&g_runtime_state.jitter,
+		sender_usec,
+		(uint64_t) slot->arrival_tv.tv_sec*1000000 + slot->arrival_tv.tv_usec,
+		jitter_buffer_ms
+	);
+	slot->tv.tv_sec = (time_t) (present_usec / 1000000);
+	slot->tv.tv_usec = (suseconds_t) (present_usec % 1000000);
+
+	if (timercmp(&slot->tv, &g_runtime_state.jitter_taken_tv, <)) {
+		g_runtime_state.jitter_dropped_frames++;
+		pthread_mutex_unlock(&g_runtime_state.jitter_mutex);
+		return;
+	}
+
+	// Trade the producers' buffer for a free one, or the earliest queued frame's if the buffer is full
+	uint32_t* jitter_slots = g_runtime_state.jitter_slots;
+	uint32_t producer_slot = g_runtime_state.producer_slot;
+	if (g_runtime_state.jitter_free_count > 0) {
+		g_runtime_state.producer_slot = g_runtime_state.jitter_free_slots[--g_runtime_state.jitter_free_count];
+	} else {
+		g_runtime_state.producer_slot = jitter_slots[0];
+		memmove(&jitter_slots[0], &jitter_slots[1], (--g_runtime_state.jitter_count) * sizeof(uint32_t));
+		g_runtime_state.jitter_dropped_frames++;
+	}
+
+	// Keep the queue in order of when frames are due, which datagrams may not arrive in
+	uint32_t index = g_runtime_state.jitter_count;
+	while (index > 0 && timercmp(&slot->tv, &g_runtime_state.frame_slots[jitter_slots[index - 1]].tv, <)) {
+		jitter_slots[index] = jitter_slots[index - 1];
+		index--;
+	}
+	jitter_slots[index] = producer_slot;
+	g_runtime_state.jitter_count++;
+
+	pthread_mutex_unlock(&g_runtime_state.jitter_mutex);
+}
+
+/**
+* Copy 8-bit RGB data for a single OPC channel into frame_rgb. Channel 0 sets the whole frame, starting with the first
+* strip; channel n sets strip n only, keeping the latest data for the others. Pixels not set are turned off. Must be
+* called with the producer mutex held.
+*
+* \return FALSE if there is nothing to publish
+*/
+static uint8_t store_channel_data(uint8_t channel, uint8_t* channel_data, uint32_t data_size) {
+	// Nothing to publish into until the server is set up
+	if (g_runtime_state.frame_rgb == NULL) {
+		return FALSE;
+	}
+
+	if (channel > g_runtime_state.strip_count) {
+		warn_once("Ignoring data for channel %d; only %d strips are in use\n", channel, g_runtime_state.strip_count);
+		return FALSE;
+	}
+
+	uint32_t rgb_size = (channel == 0 ? g_runtime_state.frame_size : g_runtime_state.leds_per_strip)
+		* sizeof(buffer_pixel_t);
+	uint32_t copy_size = min(data_size, rgb_size);
+	uint8_t* rgb = g_runtime_state.frame_rgb + (channel == 0 ? 0 : (channel - 1) * rgb_size);
+
+	memcpy(rgb, channel_data, copy_size);
+	memset(rgb + copy_size, 0, rgb_size - copy_size);
+	return TRUE;
+}
+
+/**
+* Publish the given 8-bit RGB buffer as the next frame, with the strips one after the other. Pixels not set by the new
+* frame are turned off.
 */
 void set_next_frame_data(
 	uint8_t* frame_data,
 	uint32_t data_size,
 	uint8_t is_remote
 ) {
-	pthread_mutex_lock(&g_runtime_state.mutex);
+	set_next_channel_data(0, frame_data, data_size, is_remote);
+}
 
-	rotate_frames(FALSE);
+/**
+* Publish 8-bit RGB data for a single OPC channel; see store_channel_data().
+*/
+void set_next_channel_data(
+	uint8_t channel,
+	uint8_t* channel_data,
+	uint32_t data_size,
+	uint8_t is_remote
+) {
+	pthread_mutex_lock(&g_runtime_state.producer_mutex);
+	uint8_t stored = store_channel_data(channel, channel_data, data_size);
+	if (stored) {
+		publish_frame_data(is_remote);
+	}
+	pthread_mutex_unlock(&g_runtime_state.producer_mutex);
 
-	// Prevent buffer overruns
-	data_size = min(data_size, g_runtime_state.frame_size * 3);
+	if (stored) {
+		wake_render_thread();
+	}
+}
 
-	// Copy in new data
-	memcpy(g_runtime_state.next_frame_data, frame_data, data_size);
+/**
+* Publish 8-bit RGB data for a single OPC channel that the sender meant to be shown at sender_usec, on a clock of its
+* own. With the jitter buffer on, the frame waits in it until it is due; otherwise it is shown as it arrives.
+*/
+void set_timed_channel_data(
+	uint8_t channel,
+	uint64_t sender_usec,
+	uint8_t* channel_data,
+	uint32_t data_size,
+	uint8_t is_remote
+) {
+	pthread_mutex_lock(&g_server_config.mutex);
+	int32_t jitter_buffer_ms = g_server_config.jitter_buffer_ms;
+	pthread_mutex_unlock(&g_server_config.mutex);
 
-	// Zero out any pixels not set by the new frame
-	memset((uint8_t*) g_runtime_state.next_frame_data + data_size, 0, (g_runtime_state.frame_size*3 - data_size));
+	if (jitter_buffer_ms == 0) {
+		set_next_channel_data(channel, channel_data, data_size, is_remote);
+		return;
+	}
 
-	// Update the timestamp & count
-	gettimeofday(&g_runtime_state.next_frame_tv, NULL);
+	pthread_mutex_lock(&g_runtime_state.producer_mutex);
+	uint8_t stored = store_channel_data(channel, channel_data, data_size);
+	if (stored) {
+		publish_timed_frame_data(sender_usec, jitter_buffer_ms, is_remote);
+	}
+	pthread_mutex_unlock(&g_runtime_state.producer_mutex);
 
-	// Update remote data timestamp if applicable
-	if (is_remote) {
-		gettimeofday(&g_runtime_state.last_remote_data_tv, NULL);
+	if (stored) {
+		wake_render_thread();
 	}
+}
 
-	g_runtime_state.has_next_frame = TRUE;
+/**
+* Append the frame in the given buffer to the frame history, in place of the oldest one, whose buffer the caller has
+* handed on.
+*/
+static void append_history_slot(uint32_t slot) {
+	for (uint32_t i=1; i<FRAME_HISTORY_LENGTH; i++) {
+		g_runtime_state.history_slots[i - 1] = g_runtime_state.history_slots[i];
+	}
+	g_runtime_state.history_slots[FRAME_HISTORY_LENGTH - 1] = slot;
+	g_runtime_state.history_count = min(g_runtime_state.history_count + 1, FRAME_HISTORY_LENGTH);
+}
 
-	pthread_mutex_unlock(&g_runtime_state.mutex);
+/**
+* Take the latest frame from the jitter buffer that is due by now, if there is one. Frames due before it are dropped,
+* since there is no time left to show them.
+*/
+static uint8_t take_due_jitter_frame() {
+	struct timeval now_tv;
+	monotonic_time(&now_tv);
+
+	pthread_mutex_lock(&g_runtime_state.jitter_mutex);
+
+	uint32_t* jitter_slots = g_runtime_state.jitter_slots;
+	uint32_t due_count = 0;
+	while (due_count < g_runtime_state.jitter_count
+		&& ! timercmp(&g_runtime_state.frame_slots[jitter_slots[due_count]].tv, &now_tv, >)
+	) {
+		due_count++;
+	}
+
+	if (due_count == 0) {
+		pthread_mutex_unlock(&g_runtime_state.jitter_mutex);
+		return FALSE;
+	}
+
+	// The frames skipped and the oldest in the history free up as many buffers as leave the queue
+	uint32_t slot = jitter_slots[due_count - 1];
+	for (uint32_t i=0; i<due_count-1; i++) {
+		g_runtime_state.jitter_free_slots[g_runtime_state.jitter_free_count++] = jitter_slots[i];
+	}
+	g_runtime_state.jitter_free_slots[g_runtime_state.jitter_free_count++] = g_runtime_state.history_slots[0];
+	g_runtime_state.jitter_dropped_frames += due_count - 1;
+
+	g_runtime_state.jitter_count -= due_count;
+	memmove(&jitter_slots[0], &jitter_slots[due_count], g_runtime_state.jitter_count * sizeof(uint32_t));
+	g_runtime_state.jitter_taken_tv = g_runtime_state.frame_slots[slot].tv;
+
+	pthread_mutex_unlock(&g_runtime_state.jitter_mutex);
+
+	append_history_slot(slot);
+	return TRUE;
 }
 
 /**
-* Rotate the buffers, dropping the previous frame and loading in the new one
+* Shorten timeout_usec (negative for none) to the time until the next frame in the jitter buffer is due, if there is
+* one, so an idle render thread wakes up for it.
 */
-void rotate_frames(uint8_t lock_frame_data) {
-	if (lock_frame_data) pthread_mutex_lock(&g_runtime_state.mutex);
+static int64_t jitter_buffer_timeout_usec(int64_t timeout_usec) {
+	struct timeval now_tv, due_tv;
+	monotonic_time(&now_tv);
+
+	pthread_mutex_lock(&g_runtime_state.jitter_mutex);
+	uint32_t jitter_count = g_runtime_state.jitter_count;
+	if (jitter_count > 0) {
+		due_tv = g_runtime_state.frame_slots[g_runtime_state.jitter_slots[0]].tv;
+	}
+	pthread_mutex_unlock(&g_runtime_state.jitter_mutex);
 
-	buffer_pixel_t* temp = NULL;
+	if (jitter_count == 0) {
+		return timeout_usec;
+	}
 
-	g_runtime_state.has_prev_frame = FALSE;
+	int64_t due_usec = max(
+		(int64_t) (due_tv.tv_sec - now_tv.tv_sec) * 1000000 + (due_tv.tv_usec - now_tv.tv_usec),
+		0
+	);
+	return timeout_usec < 0 ? due_usec : min(timeout_usec, due_usec);
+}
+
+/**
+* Take the latest published frame, or the latest frame due from the jitter buffer, if there is one, appending it to the
+* frame history. The oldest frame's buffer goes back to the producers. Must be called from the render thread between
+* frames, with the runtime state mutex held.
+*
+* \return TRUE if a new frame was taken
+*/
+uint8_t take_next_frame() {
+	if ((__atomic_load_n(&g_runtime_state.mailbox_slot, __ATOMIC_ACQUIRE) & FRAME_MAILBOX_FRESH) == 0) {
+		return take_due_jitter_frame();
+	}
+
+	// Only this thread clears the fresh flag, so the mailbox still holds a fresh frame; possibly a newer one
+	uint32_t mailbox_slot = __atomic_exchange_n(
+		&g_runtime_state.mailbox_slot,
+		g_runtime_state.history_slots[0],
+		__ATOMIC_ACQ_REL
+	);
+	append_history_slot(mailbox_slot & ~FRAME_MAILBOX_FRESH);
+
+	return TRUE;
+}
 
-	if (g_runtime_state.has_current_frame) {
-		g_runtime_state.previous_frame_tv = g_runtime_state.current_frame_tv;
+/**
+* Wake the render thread if it is idle. Called whenever a new frame is published or the settings change.
+*/
+void wake_render_thread() {
+	uint64_t increment = 1;
 
-		temp = g_runtime_state.previous_frame_data;
-		g_runtime_state.previous_frame_data = g_runtime_state.current_frame_data;
-		g_runtime_state.current_frame_data = temp;
+	// The counter only saturates if the render thread has stopped reading it, so EAGAIN is safe to ignore
+	if (write(g_runtime_state.render_wake_fd, &increment, sizeof(increment)) < 0 && errno != EAGAIN) {
+		warn_once("Failed to wake render thread: %s\n", strerror(errno));
+	}
+}
 
-		g_runtime_state.has_prev_frame = TRUE;
-		g_runtime_state.has_current_frame = FALSE;
+/**
+* Arm the render clock to tick every tick_nsec nanoseconds starting at first_tick_usec (monotonic), or disarm it for a
+* tick of 0.
+*/
+static void set_render_clock(int timer_fd, uint64_t tick_nsec, uint64_t first_tick_usec) {
+	struct itimerspec timer_spec = { { 0, 0 }, { 0, 0 } };
+
+	if (tick_nsec > 0) {
+		timer_spec.it_interval.tv_sec = (time_t) (tick_nsec / 1000000000);
+		timer_spec.it_interval.tv_nsec = (long) (tick_nsec % 1000000000);
+		timer_spec.it_value.tv_sec = (time_t) (first_tick_usec / 1000000);
+		timer_spec.it_value.tv_nsec = (long) (first_tick_usec % 1000000) * 1000;
 	}
 
-	if (g_runtime_state.has_next_frame) {
-		g_runtime_state.current_frame_tv = g_runtime_state.next_frame_tv;
+	if (timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &timer_spec, NULL) < 0) {
+		die("[render] Failed to set render clock to %llu nsec: %s\n", (unsigned long long) tick_nsec, strerror(errno));
+	}
+}
 
-		temp = g_runtime_state.current_frame_data;
-		g_runtime_state.current_frame_data = g_runtime_state.next_frame_data;
-		g_runtime_state.next_frame_data = temp;
+/**
+* Block until the render clock ticks (if timer_fd >= 0), the render thread is woken (if wake_fd >= 0) or timeout_usec
+* passes (unless it is negative), then clear whichever of them fired.
+*/
+static void wait_for_render_event(int timer_fd, int wake_fd, int64_t timeout_usec) {
+	struct pollfd poll_fds[2];
+	nfds_t poll_fd_count = 0;
 
-		g_runtime_state.has_current_frame = TRUE;
-		g_runtime_state.has_next_frame = FALSE;
+	if (timer_fd >= 0) {
+		poll_fds[poll_fd_count++] = (struct pollfd) { .fd = timer_fd, .events = POLLIN };
+	}
+	if (wake_fd >= 0) {
+		poll_fds[poll_fd_count++] = (struct pollfd) { .fd = wake_fd, .events = POLLIN };
 	}
 
-	// Update the delta time stamp
-	if (g_runtime_state.has_current_frame && g_runtime_state.has_prev_frame) {
-		timersub(
-			&g_runtime_state.current_frame_tv,
-			&g_runtime_state.previous_frame_tv,
-			&g_runtime_state.prev_current_delta_tv
-		);
+	int timeout_ms = timeout_usec < 0 ? -1 : (int) min((timeout_usec + 999) / 1000, INT32_MAX);
+	if (poll(poll_fds, poll_fd_count, timeout_ms) <= 0) {
+		return;
 	}
 
-	if (lock_frame_data) pthread_mutex_unlock(&g_runtime_state.mutex);
+	// Both are counters that reset when read; the counts themselves don't matter
+	for (nfds_t i=0; i<poll_fd_count; i++) {
+		uint64_t count;
+		if (poll_fds[i].revents & POLLIN) {
+			if (read(poll_fds[i].fd, &count, sizeof(count)) < 0 && errno != EAGAIN) {
+				warn_once("Failed to read render event: %s\n", strerror(errno));
+			}
+		}
+	}
 }
 
-inline uint32_t lutInterpolate(uint32_t value, uint32_t* lut) {
-	// Inspired by FadeCandy: https://github.com/scanlime/fadecandy/blob/master/firmware/fc_pixel_lut.cpp
+/**
+* Resend the last SPI buffer of every strip if nothing has been written for STATIC_SCENE_KEEPALIVE_USEC. Must be called
+* with the runtime state mutex held, and only once a frame has been rendered for the current frame size.
+*
+* \return the time until the next keep-alive is due, in microseconds
+*/
+static int64_t write_keepalive_frame(struct timeval* last_write_tv) {
+	struct timeval now_tv, idle_tv;
+	monotonic_time(&now_tv);
+	timersub(&now_tv, last_write_tv, &idle_tv);
+
+	int64_t idle_usec = (int64_t) idle_tv.tv_sec * 1000000 + idle_tv.tv_usec;
+	if (idle_usec < (int64_t) STATIC_SCENE_KEEPALIVE_USEC) {
+		return (int64_t) STATIC_SCENE_KEEPALIVE_USEC - idle_usec;
+	}
 
-	uint32_t index = value >> 8; // Range [0, 0xFF]
-	uint32_t alpha = value & 0xFF; // Range [0, 0xFF]
-	uint32_t invAlpha = 0x100 - alpha; // Range [1, 0x100]
+	for (uint32_t i=0; i<min(g_runtime_state.strip_count, g_runtime_state.spio_conn_count); i++) {
+		spio_writer_repeat(g_runtime_state.spi_writers[i], g_runtime_state.spio_conns[i]);
+	}
+	*last_write_tv = now_tv;
 
-	// Result in range [0, 0xFFFF]
-	return (lut[index] * invAlpha + lut[index + 1] * alpha) >> 8;
+	return STATIC_SCENE_KEEPALIVE_USEC;
 }
 
 void* render_thread(void* unused_data)
 {
 	unused_data=unused_data; // Suppress Warnings
 	fprintf(stderr, "[render] Starting render thread for %u total pixels\n", g_server_config.leds_per_strip *
-	                                                                         SPISCAPE_MAX_STRIPS
+	                                                                         g_server_config.used_strip_count
+	);
+
+	// Pick the fastest verified kernel for this CPU
+	char render_kernel_name[32];
+	uint32_t render_thread_count;
+	pthread_mutex_lock(&g_server_config.mutex);
+	strlcpy(render_kernel_name, g_server_config.render_kernel, sizeof(render_kernel_name));
+	render_thread_count = g_server_config.render_threads;
+	pthread_mutex_unlock(&g_server_config.mutex);
+
+	const render_kernel_t* render_kernel = render_kernel_select(render_kernel_name);
+	fprintf(stderr, "[render] Using %s render kernel\n", render_kernel->name);
+
+	// Spread large frames over the other cores
+	render_pool_t* render_pool = render_pool_create(render_thread_count);
+	if (render_pool == NULL) {
+		die("[render] Failed to create render worker pool\n");
+	}
+	fprintf(stderr, "[render] Rendering on up to %u threads%s\n",
+		render_pool_thread_count(render_pool),
+		render_thread_count == 0 ? " (auto)" : ""
 	);
 
+	// Render clock: ticks at the target refresh rate while frames are changing. When there is nothing to render, the
+	// thread instead sleeps until it is woken by a new frame or settings change, or a keep-alive is due.
+	int render_wake_fd = g_runtime_state.render_wake_fd;
+	int render_timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (render_timer_fd < 0) {
+		die("[render] Failed to create render clock: %s\n", strerror(errno));
+	}
+	uint32_t render_clock_rate_hz = 0;
+	uint64_t render_clock_tick_nsec = 0;
+
 	// Timing Variables
 	struct timeval frame_progress_tv, now_tv;
 	uint16_t frame_progress16, inv_frame_progress16;
@@ -1180,7 +2024,45 @@ void* render_thread(void* unused_data)
 	uint32_t frames_since_last_fps_report = 0;
 	uint64_t frame_duration_avg_usec = 2000;
 
-	uint8_t buffer_index = 0;
+	// Turns dithering and interpolation off when frames can't keep up with the refresh rate
+	render_governor_t governor;
+	render_governor_init(&governor);
+
+	// Static scene detection: once the frames and settings stop changing and the output has stayed the same for longer
+	// than dithering could take to play out, stop rendering and only resend the output now and then.
+	uint64_t last_scene_hash = 0;
+	uint64_t last_output_hash = 0;
+	uint32_t unchanged_output_frames = 0;
+	uint32_t output_frame_size = 0;
+	struct timeval last_write_tv = { .tv_sec = 0, .tv_usec = 0 };
+	bool static_scene = false;
+
+	// Without dithering, every frame that repeats the last one pauses rendering. Pauses are counted in fps_info, and
+	// only logged once they last longer than STATIC_SCENE_KEEPALIVE_USEC.
+	uint64_t static_scene_since_usec = 0;
+	bool static_scene_logged = false;
+	uint64_t paused_usec_since_last_fps_report = 0;
+
+	// APA102 LED frames for chipsets that need them encoded
+	uint8_t* led_frames = NULL;
+	uint32_t led_frames_size = 0;
+
+	// The rendered frame as 8-bit RGB, for network output
+	uint8_t* net_rgb = NULL;
+	uint32_t net_rgb_size = 0;
+
+	// Steady timeline for the incoming frames, which interpolation and the render clock follow
+	render_pll_t frame_clock;
+	render_pll_init(&frame_clock);
+
+	// Extrapolation for low-latency output, and latency stats
+	render_latency_t latency;
+	render_latency_init(&latency);
+
+	// Where cubic interpolation is along its two segments, 1.0 = 0x10000, and where the next frame takes over from
+	uint64_t cubic_position16 = 0;
+	uint64_t cubic_lead16 = 0;
+
 	int8_t ditheringFrame = 0;
 	for(;;) {
 		pthread_mutex_lock(&g_runtime_state.mutex);
@@ -1189,70 +2071,120 @@ void* render_thread(void* unused_data)
 		g_runtime_state.frame_counter++;
 
 		// Wait until LedSPI is initialized
-		if (g_runtime_state.spio_conn == NULL) {
+		if (g_runtime_state.spio_conn_count == 0) {
 			printf("[render] Awaiting server initialization...\n");
 			pthread_mutex_unlock(&g_runtime_state.mutex);
-			usleep(1e6 /* 1s */);
+			wait_for_render_event(-1, render_wake_fd, 1000000 /* 1s */);
 			continue;
 		}
 
+		// Start interpolating towards the latest frame as soon as it arrives
+		bool frame_taken = take_next_frame();
+		frame_slot_t* history[FRAME_HISTORY_LENGTH];
+		for (uint32_t i=0; i<FRAME_HISTORY_LENGTH; i++) {
+			history[i] = &g_runtime_state.frame_slots[g_runtime_state.history_slots[i]];
+		}
+		frame_slot_t* previous_slot = history[FRAME_HISTORY_LENGTH - 2];
+		frame_slot_t* current_slot = history[FRAME_HISTORY_LENGTH - 1];
+
 		// Skip frames if there isn't enough data
-		if (!g_runtime_state.has_prev_frame || !g_runtime_state.has_current_frame) {
+		if (g_runtime_state.history_count < 2) {
 			pthread_mutex_unlock(&g_runtime_state.mutex);
-			usleep(10e3 /* 10ms */);
+			wait_for_render_event(-1, render_wake_fd, jitter_buffer_timeout_usec(-1));
 			continue;
 		}
 
 		// Calculate the time delta and current percentage (as a 16-bit value)
-		gettimeofday(&now_tv, NULL);
-		timersub(&now_tv, &g_runtime_state.next_frame_tv, &frame_progress_tv);
+		monotonic_time(&now_tv);
+		timersub(&now_tv, &current_slot->tv, &frame_progress_tv);
 
 		// Calculate current frame and previous frame time
-		uint64_t frame_progress_us = (uint64_t) (frame_progress_tv.tv_sec*1e6 + frame_progress_tv.tv_usec);
-		uint64_t last_frame_time_us = (uint64_t) (g_runtime_state.prev_current_delta_tv.tv_sec*1e6 + g_runtime_state.prev_current_delta_tv.tv_usec);
+		struct timeval prev_current_delta_tv;
+		timersub(&current_slot->tv, &previous_slot->tv, &prev_current_delta_tv);
+		uint64_t now_us = (uint64_t) now_tv.tv_sec*1000000 + now_tv.tv_usec;
+		uint64_t last_frame_time_us = max((uint64_t) (prev_current_delta_tv.tv_sec*1e6 + prev_current_delta_tv.tv_usec), 1);
+
+		if (frame_taken) {
+			render_pll_frame_arrived(&frame_clock, (uint64_t) current_slot->tv.tv_sec*1000000 + current_slot->tv.tv_usec);
+			render_latency_frame_arrived(
+				&latency,
+				last_frame_time_us,
+				current_slot->hash == 0 || current_slot->hash != previous_slot->hash
+			);
+		}
+
+		// Cubic interpolation needs the whole history; it steps down to linear before interpolation and extrapolation go
+		pthread_mutex_lock(&g_server_config.mutex);
+		bool low_latency = g_server_config.low_latency_enabled;
+		bool interpolation_allowed = g_server_config.interpolation_enabled && render_governor_allows_interpolation(&governor);
+		bool cubic_enabled = g_server_config.cubic_interpolation_enabled
+			&& ! low_latency
+			&& interpolation_allowed
+			&& render_governor_allows_cubic_interpolation(&governor)
+			&& g_runtime_state.history_count == FRAME_HISTORY_LENGTH;
+		pthread_mutex_unlock(&g_server_config.mutex);
+
+		// Linear interpolation blends from the previous to the current frame over one frame period from where the
+		// current frame falls on the source's timeline. The spline needs a frame on either side of the two it blends, so cubic interpolation plays the
+		// pair before that first, then the last pair with the current frame standing in for the one after it. A frame
+		// that arrives during the second segment takes over from the same point instead of starting the pair over.
+		if (frame_taken) {
+			cubic_lead16 = cubic_position16 > 0x10000 ? min(cubic_position16 - 0x10000, 0x10000) : 0;
+		}
+		uint64_t position16 = render_pll_position16(&frame_clock, now_us) + (cubic_enabled ? cubic_lead16 : 0);
+		cubic_position16 = cubic_enabled ? position16 : 0;
+
+		// Low-latency output starts at the current frame and may extrapolate past it for a period, then ease back
+		int32_t extrapolation14 = low_latency && interpolation_allowed
+			? render_latency_extrapolation14(&latency, position16)
+			: 0;
 
 		// Check for current frame exhaustion
-		if (frame_progress_us > last_frame_time_us) {
-			uint8_t has_next_frame = g_runtime_state.has_next_frame;
-			pthread_mutex_unlock(&g_runtime_state.mutex);
+		if (position16 > (cubic_enabled || low_latency ? 2u << 16 : 1u << 16)) {
+			int64_t wait_usec = -1;
 
-			// This should only happen in a final frame case -- to avoid early switching (and some nasty resulting
-			// artifacts) we only force frame rotation if the next frame is really late.
-			if (has_next_frame && frame_progress_us > last_frame_time_us*2) {
-				// If we have more data, rotate it in.
-				//printf("Need data: rotating in; frame_progress_us=%llu; last_frame_time_us=%llu\n", frame_progress_us, last_frame_time_us);
-				rotate_frames(TRUE);
-			} else {
-				// Otherwise sleep for a moment and wait for more data
-				//printf("Need data: none available; frame_progress_us=%llu; last_frame_time_us=%llu\n", frame_progress_us, last_frame_time_us);
-				usleep(1e3);
+			// Hold the last output until more data arrives
+			if (output_frame_size == g_runtime_state.frame_size) {
+				wait_usec = write_keepalive_frame(&last_write_tv);
 			}
 
+			pthread_mutex_unlock(&g_runtime_state.mutex);
+
+			// Wait for more data
+			wait_for_render_event(-1, render_wake_fd, jitter_buffer_timeout_usec(wait_usec));
+
 			continue;
 		}
 
-		frame_progress16 = (uint16_t) ((frame_progress_us << 16) / last_frame_time_us);
+		uint32_t segment = cubic_enabled && position16 >= 0x10000 ? 1 : 0;
+		frame_progress16 = (uint16_t) min(position16 - segment * 0x10000, 0xFFFF);
 		inv_frame_progress16 = (uint16_t) (0xFFFF - frame_progress16);
 
+		frame_slot_t* before_previous_slot = previous_slot;
+		frame_slot_t* after_current_slot = current_slot;
+		if (cubic_enabled) {
+			before_previous_slot = history[segment];
+			previous_slot = history[segment + 1];
+			current_slot = history[segment + 2];
+			after_current_slot = history[min(segment + 3, FRAME_HISTORY_LENGTH - 1)];
+		}
+
 		if (frame_progress_tv.tv_sec > 5) {
 			printf("[render] No data for 5 seconds; suspending render thread.\n");
 			pthread_mutex_unlock(&g_runtime_state.mutex);
-			usleep(100e3 /* 100ms */);
+			wait_for_render_event(-1, render_wake_fd, jitter_buffer_timeout_usec(-1));
 			continue;
 		}
 
 		// printf("%d of %d (%d)\n",
 		// 	(frame_progress_tv.tv_sec*1000000 + frame_progress_tv.tv_usec) ,
-		// 	(g_runtime_state.prev_current_delta_tv.tv_sec*1000000 + g_runtime_state.prev_current_delta_tv.tv_usec),
+		// 	(prev_current_delta_tv.tv_sec*1000000 + prev_current_delta_tv.tv_usec),
 		// 	frame_progress16
 		// );
 
-		// Setup LedSPI for this frame
-		buffer_index = (buffer_index+1)%2;
-
 		// Build the render frame
 		uint32_t led_count = g_runtime_state.frame_size;
-		uint32_t leds_per_strip = led_count / SPISCAPE_MAX_STRIPS;
+		uint32_t leds_per_strip = g_runtime_state.leds_per_strip;
 		uint32_t data_index = 0;
 
 		// Update the dithering frame counter
@@ -1260,135 +2192,281 @@ void* render_thread(void* unused_data)
 
 		// Timing stuff
 		struct timeval start_tv, stop_tv, delta_tv;
-		gettimeofday(&start_tv, NULL);
+		monotonic_time(&start_tv);
+
+		// Only strips with a device to send them to are rendered
+		uint32_t used_strip_count = min(g_runtime_state.strip_count, g_runtime_state.spio_conn_count);
 
-		uint32_t used_strip_count;
+		// The strips go out in parallel, so the slowest bus sets the bus time
+		uint32_t spi_speed_hz = g_runtime_state.spio_conns[0]->speed_hz;
+		for (uint32_t strip_index=1; strip_index<used_strip_count; strip_index++) {
+			spi_speed_hz = min(spi_speed_hz, g_runtime_state.spio_conns[strip_index]->speed_hz);
+		}
 
 		// Check the server config for dithering and interpolation options
 		pthread_mutex_lock(&g_server_config.mutex);
 
-		// Use the strip count from configs. This can save time that would be used dithering
-		used_strip_count = min(g_server_config.used_strip_count, SPISCAPE_MAX_STRIPS);
-
-		// Only enable dithering if we're better than 100fps
-		bool dithering_enabled = (frame_duration_avg_usec < 10000) && g_server_config.dithering_enabled;
-		bool interpolation_enabled = g_server_config.interpolation_enabled;
+		// Frames go out once per render clock tick, or as fast as they can be rendered if that is slower
+		uint32_t refresh_rate_hz = g_server_config.refresh_rate_hz;
+		const chipset_t* chipset = g_runtime_state.chipset;
+		uint32_t spi_length = chipset_frame_length(chipset, leds_per_strip);
+		render_governor_set_target(&governor, refresh_rate_hz, spi_speed_hz, spi_length, chipset->latch_usec);
+		uint32_t frame_period_usec = governor.has_samples || governor.render_usec16 > 0
+			? render_governor_frame_period_usec(&governor)
+			: max(frame_duration_avg_usec, governor.target_period_usec);
+
+		// Leave out whatever the governor has stepped down. HDR output takes the place of dithering, on chipsets with a
+		// brightness field, and 16-bit chipsets need neither.
+		bool hdr_enabled = g_server_config.hdr_enabled && chipset->has_brightness;
+		bool dithering_enabled = render_governor_allows_dithering(&governor) && g_server_config.dithering_enabled
+			&& ! hdr_enabled && ! chipset->wide;
+		bool ordered_dithering_enabled = g_server_config.ordered_dithering_enabled;
+		bool interpolation_enabled = render_governor_allows_interpolation(&governor) && g_server_config.interpolation_enabled
+			&& (! low_latency || extrapolation14 > 0);
 		bool lut_enabled = g_server_config.lut_enabled;
+		bool gain_enabled = g_runtime_state.calibration_gain.pixel_count > 0;
 
 		color_channel_order_t color_channel_order = g_server_config.color_channel_order;
 
 		pthread_mutex_unlock(&g_server_config.mutex);
 
-		// Initialize SPI buffer with start frame (four 0s) and clock padding (pixels/2 or more bits)
-		uint8_t* spi_buffer = g_runtime_state.spi_buffer;
-		spi_buffer[0] = spi_buffer[1] = spi_buffer[2] = spi_buffer[3] = 0;
-		for (int i=0; i<leds_per_strip/16+1; i++)
-			spi_buffer[4 + leds_per_strip*4 + i] = 255;
+		// Once the source's frame rate is known, tick a whole number of times per frame, lined up with its timeline
+		uint64_t tick_nsec = render_pll_tick_nsec(&frame_clock, refresh_rate_hz);
+		uint64_t tick_change_nsec = tick_nsec > render_clock_tick_nsec
+			? tick_nsec - render_clock_tick_nsec
+			: render_clock_tick_nsec - tick_nsec;
+		if (refresh_rate_hz != render_clock_rate_hz
+			|| tick_change_nsec * 1000 > render_clock_tick_nsec * RENDER_PLL_TICK_TOLERANCE_PERMILLE) {
+			set_render_clock(render_timer_fd, tick_nsec, render_pll_next_tick_usec(&frame_clock, tick_nsec, now_us));
+			render_clock_rate_hz = refresh_rate_hz;
+			render_clock_tick_nsec = tick_nsec;
+		}
 
 		// Only allow dithering to take effect if it blinks faster than 60fps
-		uint32_t maxDitherFrames = 16667 / frame_duration_avg_usec;
+		uint32_t maxDitherFrames = 16667 / max(frame_period_usec, 1u);
+
+		render_params_t render_params = {
+			.frame_progress16 = frame_progress16,
+			.inv_frame_progress16 = inv_frame_progress16,
+			.dithering_frame = ditheringFrame,
+			.max_dither_frames = maxDitherFrames,
+			.interpolation_enabled = interpolation_enabled,
+			.dithering_enabled = dithering_enabled,
+			.ordered_dithering_enabled = ordered_dithering_enabled,
+			.lut_enabled = lut_enabled,
+			.hdr_enabled = hdr_enabled,
+			.gain_enabled = gain_enabled,
+			.gain = &g_runtime_state.calibration_gain,
+			.cubic_enabled = cubic_enabled || extrapolation14 > 0,
+			.before_previous = &before_previous_slot->frame,
+			.after_current = &after_current_slot->frame,
+			.red_lookup = g_runtime_state.red_lookup,
+			.green_lookup = g_runtime_state.green_lookup,
+			.blue_lookup = g_runtime_state.blue_lookup
+		};
+		render_params_set_channel_order(&render_params, color_channel_order);
+		if (low_latency) {
+			render_params_set_extrapolation_weights(&render_params, extrapolation14);
+		} else {
+			render_params_set_cubic_weights(&render_params);
+		}
+		if (dithering_enabled && ordered_dithering_enabled) {
+			render_params_set_dither_thresholds(&render_params);
+		}
 
-		for (uint32_t strip_index=0; strip_index<used_strip_count; strip_index++) {
-			for (uint32_t led_index=0; led_index<leds_per_strip; led_index++, data_index++) {
-				buffer_pixel_t* pixel_in_prev = &g_runtime_state.previous_frame_data[data_index];
-				buffer_pixel_t* pixel_in_current = &g_runtime_state.current_frame_data[data_index];
-				pixel_delta_t* pixel_in_overflow = &g_runtime_state.frame_dithering_overflow[data_index];
-
-				int32_t interpolatedR;
-				int32_t interpolatedG;
-				int32_t interpolatedB;
-
-				// Interpolate
-				if (interpolation_enabled) {
-					interpolatedR = (pixel_in_prev->r*inv_frame_progress16 + pixel_in_current->r*frame_progress16) >> 8;
-					interpolatedG = (pixel_in_prev->g*inv_frame_progress16 + pixel_in_current->g*frame_progress16) >> 8;
-					interpolatedB = (pixel_in_prev->b*inv_frame_progress16 + pixel_in_current->b*frame_progress16) >> 8;
-				} else {
-					interpolatedR = pixel_in_current->r << 8;
-					interpolatedG = pixel_in_current->g << 8;
-					interpolatedB = pixel_in_current->b << 8;
-				}
+		// The scene is static while the frames being shown and everything that affects rendering stay the same. Buffers
+		// with unknown contents have a hash of 0 and never count as static.
+		uint64_t scene_signature[] = {
+			interpolation_enabled ? previous_slot->hash : 0,
+			current_slot->hash,
+			cubic_enabled ? before_previous_slot->hash : 0,
+			cubic_enabled ? after_current_slot->hash : 0,
+			(uint64_t) extrapolation14,
+			g_runtime_state.lookup_version,
+			g_runtime_state.calibration_version,
+			led_count,
+			used_strip_count,
+			maxDitherFrames,
+			color_channel_order,
+			(uint64_t) (uintptr_t) chipset,
+			(uint64_t) RENDER_VARIANT_INDEX(
+				interpolation_enabled, lut_enabled, dithering_enabled, hdr_enabled, gain_enabled, cubic_enabled,
+				ordered_dithering_enabled
+			)
+		};
+		uint64_t scene_hash = hash64(scene_signature, sizeof(scene_signature));
+		bool scene_unchanged = scene_hash == last_scene_hash
+			&& current_slot->hash != 0
+			&& (! interpolation_enabled || previous_slot->hash == current_slot->hash)
+			&& (! cubic_enabled
+				|| (before_previous_slot->hash == current_slot->hash && after_current_slot->hash == current_slot->hash));
+		last_scene_hash = scene_hash;
+
+		// Dithering resets any pixel it hasn't affected for maxDitherFrames frames, so output that stays the same for
+		// two full reset cycles has no dithering left to play out. Ordered dithering repeats every cycle, so output that
+		// stays the same for a whole cycle has none at all.
+		uint32_t static_scene_frames = ! dithering_enabled ? 1
+			: ordered_dithering_enabled ? render_dither_cycle_frames(maxDitherFrames)
+			: 2 * (maxDitherFrames + 2);
+
+		if (scene_unchanged && unchanged_output_frames >= static_scene_frames && output_frame_size == led_count) {
+			if (! static_scene) {
+				static_scene = true;
+				static_scene_since_usec = now_us;
+			} else if (! static_scene_logged && now_us - static_scene_since_usec >= STATIC_SCENE_KEEPALIVE_USEC) {
+				printf("[render] Scene is static; pausing rendering until new data arrives\n");
+				static_scene_logged = true;
+			}
 
-				// Apply LUT
-				if (lut_enabled) {
-					interpolatedR = lutInterpolate((uint32_t) interpolatedR, g_runtime_state.red_lookup);
-					interpolatedG = lutInterpolate((uint32_t) interpolatedG, g_runtime_state.green_lookup);
-					interpolatedB = lutInterpolate((uint32_t) interpolatedB, g_runtime_state.blue_lookup);
-				}
+			int64_t wait_usec = write_keepalive_frame(&last_write_tv);
+			pthread_mutex_unlock(&g_runtime_state.mutex);
+			wait_for_render_event(-1, render_wake_fd, jitter_buffer_timeout_usec(wait_usec));
+			continue;
+		}
 
-				// Reset dithering for this pixel if it's been too long since it actually changed anything. This serves to prevent
-				// visible blinking pixels.
-				if (abs(abs(pixel_in_overflow->last_effect_frame_r) - abs(ditheringFrame)) > maxDitherFrames) {
-					pixel_in_overflow->r = 0;
-					pixel_in_overflow->last_effect_frame_r = ditheringFrame;
-				}
+		if (static_scene) {
+			if (static_scene_logged) {
+				printf("[render] Scene changed; resuming rendering\n");
+			}
+			paused_usec_since_last_fps_report += now_us - static_scene_since_usec;
+			static_scene = false;
+			static_scene_logged = false;
+		}
 
-				if (abs(abs(pixel_in_overflow->last_effect_frame_g) - abs(ditheringFrame)) > maxDitherFrames) {
-					pixel_in_overflow->g = 0;
-					pixel_in_overflow->last_effect_frame_g = ditheringFrame;
-				}
+		// Chipsets that don't take APA102 LED frames get them rendered aside and encoded afterwards
+		if (chipset->encode != NULL && led_frames_size < led_count * 4) {
+			free(led_frames);
+			led_frames_size = led_count * 4;
+			led_frames = malloc(led_frames_size);
+			if (led_frames == NULL) {
+				die("[render] Failed to allocate LED frames for %u pixels\n", led_count);
+			}
+		}
 
-				if (abs(abs(pixel_in_overflow->last_effect_frame_b) - abs(ditheringFrame)) > maxDitherFrames) {
-					pixel_in_overflow->b = 0;
-					pixel_in_overflow->last_effect_frame_b = ditheringFrame;
-				}
+		// Render each strip into a free SPI buffer of its own; this waits if a bus is still busy with the frames before
+		uint8_t* spi_buffers[SPISCAPE_MAX_STRIPS];
+		render_range_t render_ranges[SPISCAPE_MAX_STRIPS];
+		for (uint32_t strip_index=0; strip_index<used_strip_count; strip_index++, data_index += leds_per_strip) {
+			uint8_t* spi_buffer = spio_writer_acquire(g_runtime_state.spi_writers[strip_index]);
+
+			// Initialize SPI buffer with the chipset's start and end frames
+			chipset_write_frame_edges(chipset, spi_buffer, leds_per_strip);
+
+			spi_buffers[strip_index] = spi_buffer;
+			render_ranges[strip_index].first_pixel = data_index;
+			render_ranges[strip_index].pixel_count = leds_per_strip;
+			render_ranges[strip_index].pixels_out = chipset->encode != NULL
+				? &led_frames[data_index * 4]
+				: &spi_buffer[chipset->start_length];
+			render_ranges[strip_index].bytes_per_led = chipset->wide ? RENDER_WIDE_BYTES_PER_LED : 4;
+		}
 
-				// Apply dithering overflow
-				int32_t	ditheredR = interpolatedR;
-				int32_t	ditheredG = interpolatedG;
-				int32_t	ditheredB = interpolatedB;
+		struct timeval render_start_tv, render_stop_tv, render_delta_tv;
+		monotonic_time(&render_start_tv);
+
+		render_pool_render(
+			render_pool,
+			render_kernel_variant(chipset->wide ? &g_render_wide_kernel : render_kernel, &render_params),
+			&render_params,
+			&previous_slot->frame,
+			&current_slot->frame,
+			&g_runtime_state.frame_dithering_overflow,
+			render_ranges,
+			used_strip_count
+		);
 
-				if (dithering_enabled) {
-					ditheredR += pixel_in_overflow->r;
-					ditheredG += pixel_in_overflow->g;
-					ditheredB += pixel_in_overflow->b;
-				}
+		if (chipset->encode != NULL) {
+			for (uint32_t strip_index=0; strip_index<used_strip_count; strip_index++) {
+				chipset->encode(
+					render_ranges[strip_index].pixels_out,
+					leds_per_strip,
+					&spi_buffers[strip_index][chipset->start_length]
+				);
+			}
+		}
 
-				// Calculate and assign output values
-				uint8_t r = (uint8_t) min((ditheredR+0x80) >> 8, 255);
-				uint8_t g = (uint8_t) min((ditheredG+0x80) >> 8, 255);
-				uint8_t b = (uint8_t) min((ditheredB+0x80) >> 8, 255);
-
-
-				// TODO: Supprt color ordering properly
-				uint8_t* pixel_out = &spi_buffer[4 + led_index*4];
-				pixel_out[0] = 255;
-				pixel_out[1] = b;
-				pixel_out[2] = g;
-				pixel_out[3] = r;
-
-//				if (led_index == 0 && strip_index == 3) {
-//					printf("channel %d: %03d %03d %03d\n", strip_index, r, g, b);
-//				}
-
-				// Check for interpolation effect
-				if (r != (interpolatedR+0x80)>>8) pixel_in_overflow->last_effect_frame_r = ditheringFrame;
-				if (g != (interpolatedG+0x80)>>8) pixel_in_overflow->last_effect_frame_g = ditheringFrame;
-				if (b != (interpolatedB+0x80)>>8) pixel_in_overflow->last_effect_frame_b = ditheringFrame;
-
-				// Recalculate Overflow
-				// NOTE: For some strange reason, reading the values from pixel_out causes strange memory corruption. As such
-				// we use temporary variables, r, g, and b. It probably has to do with things being loaded into the CPU cache
-				// when read, as such, don't read pixel_out from here.
-				if (dithering_enabled) {
-					pixel_in_overflow->r = (uint8_t) ((int16_t)ditheredR - (r * 257));
-					pixel_in_overflow->g = (uint8_t) ((int16_t)ditheredG - (g * 257));
-					pixel_in_overflow->b = (uint8_t) ((int16_t)ditheredB - (b * 257));
+		// Hand the rendered pixels to network output, which sends them from its own thread
+		if (g_runtime_state.netout != NULL) {
+			if (net_rgb_size < led_count * 3) {
+				free(net_rgb);
+				net_rgb_size = led_count * 3;
+				net_rgb = malloc(net_rgb_size);
+				if (net_rgb == NULL) {
+					die("[render] Failed to allocate network output buffer for %u pixels\n", led_count);
 				}
 			}
+
+			for (uint32_t strip_index=0; strip_index<used_strip_count; strip_index++) {
+				render_led_frames_to_rgb(
+					&render_params,
+					render_ranges[strip_index].pixels_out,
+					leds_per_strip,
+					chipset->wide,
+					&net_rgb[render_ranges[strip_index].first_pixel * 3]
+				);
+			}
+
+			netout_submit(g_runtime_state.netout, net_rgb, used_strip_count * leds_per_strip);
 		}
 
-		// Render the frame
-		spio_write(g_runtime_state.spio_conn, spi_buffer, 4 + leds_per_strip*4 + leds_per_strip/16 + 1);
+		monotonic_time(&render_stop_tv);
 
-		pthread_mutex_unlock(&g_runtime_state.mutex);
+		// Count how long the output has stayed the same; only worth hashing while the inputs are unchanged
+		uint64_t output_hash = 0;
+		if (scene_unchanged) {
+			uint64_t strip_hashes[SPISCAPE_MAX_STRIPS];
+			for (uint32_t strip_index=0; strip_index<used_strip_count; strip_index++) {
+				strip_hashes[strip_index] = hash64(spi_buffers[strip_index], spi_length);
+			}
+			output_hash = hash64(strip_hashes, used_strip_count * sizeof(uint64_t));
+		}
+		unchanged_output_frames = (scene_unchanged && output_hash == last_output_hash) ? unchanged_output_frames + 1 : 0;
+		last_output_hash = output_hash;
+
+		// Send the frame. Every strip was rendered before any is submitted, so the writer threads start their strips
+		// together and put them on the wire in parallel while the next frame is rendered.
+		uint32_t write_usec = 0;
+		for (uint32_t strip_index=0; strip_index<used_strip_count; strip_index++) {
+			spio_writer_t* spi_writer = g_runtime_state.spi_writers[strip_index];
+
+			spio_writer_submit(spi_writer, g_runtime_state.spio_conns[strip_index], spi_buffers[strip_index], spi_length);
+			write_usec = max(write_usec, spio_writer_last_write_usec(spi_writer));
+		}
+		last_write_tv = render_stop_tv;
+		output_frame_size = led_count;
+
+		// Latency runs until the output is closer to a frame than to the one before it, and the bus has clocked it out
+		frame_slot_t* presented_slot = interpolation_enabled && ! low_latency && frame_progress16 < 0x8000
+			? previous_slot
+			: current_slot;
+		render_latency_presented(
+			&latency,
+			(uint64_t) presented_slot->arrival_tv.tv_sec*1000000 + presented_slot->arrival_tv.tv_usec,
+			(uint64_t) render_stop_tv.tv_sec*1000000 + render_stop_tv.tv_usec + write_usec
+		);
+
+		// Let the governor see render and bus time separately, since only render time can be traded for quality
+		timersub(&render_stop_tv, &render_start_tv, &render_delta_tv);
+		render_quality_t previous_quality = governor.quality;
+		if (render_governor_update(
+			&governor,
+			(uint32_t) (render_delta_tv.tv_sec*1000000 + render_delta_tv.tv_usec),
+			write_usec,
+			(uint64_t) render_stop_tv.tv_sec*1000000 + render_stop_tv.tv_usec
+		)) {
+			printf("[render] Quality governor: %s -> %s (render %u usec, write %u usec per frame, bus limit %u hz)\n",
+				render_quality_to_string(previous_quality),
+				render_quality_to_string(governor.quality),
+				render_governor_render_usec(&governor),
+				render_governor_write_usec(&governor),
+				render_governor_bus_limit_hz(&governor)
+			);
+		}
 
-		// Give other threads time... this was found through expirmenting on an Raspberry Pi B+, where the animation
-		// was quite choppy without it. Not totally sure of the reason.
-		usleep(10);
+		pthread_mutex_unlock(&g_runtime_state.mutex);
 
 		// Output Timing Info
-		gettimeofday(&stop_tv, NULL);
+		monotonic_time(&stop_tv);
 		timersub(&stop_tv, &start_tv, &delta_tv);
 
 		frames_since_last_fps_report++;
@@ -1397,20 +2475,88 @@ void* render_thread(void* unused_data)
 			last_report = stop_tv.tv_sec;
 
 			frame_duration_avg_usec = frame_duration_sum_usec / frames_since_last_fps_report;
-			printf("[render] fps_info={frame_avg_usec: %qu, possible_fps: %.2f, actual_fps: %.2f, sample_frames: %u}\n",
+			printf("[render] fps_info={frame_avg_usec: %qu, possible_fps: %.2f, actual_fps: %.2f, sample_frames: %u, "
+				"paused_usec: %llu}\n",
 				frame_duration_avg_usec,
 				(1.0e6 / frame_duration_avg_usec),
 				frames_since_last_fps_report * 1.0 / fps_report_interval_seconds,
-				frames_since_last_fps_report
+				frames_since_last_fps_report,
+				(unsigned long long) paused_usec_since_last_fps_report
 			);
+			printf("[render] governor_info={quality: \"%s\", render_usec: %u, write_usec: %u, bus_usec: %u, bus_limit_fps: %u, target_fps: %u}\n",
+				render_quality_to_string(governor.quality),
+				render_governor_render_usec(&governor),
+				render_governor_write_usec(&governor),
+				governor.bus_usec,
+				render_governor_bus_limit_hz(&governor),
+				render_clock_rate_hz
+			);
+			printf("[render] latency_info={mode: \"%s\", avg_usec: %u, min_usec: %u, max_usec: %u, sample_frames: %u, extrapolation: %.2f}\n",
+				low_latency ? "low-latency" : cubic_enabled ? "cubic" : interpolation_enabled ? "linear" : "none",
+				render_latency_avg_usec(&latency),
+				latency.latency_samples > 0 ? latency.latency_min_usec : 0,
+				latency.latency_max_usec,
+				latency.latency_samples,
+				low_latency ? latency.confidence16 / 65536.0 : 0.0
+			);
+			render_latency_reset_stats(&latency);
+			printf("[render] clock_info={locked: %s, period_usec: %llu, jitter_usec: %llu, tick_usec: %.1f, frames: %u, outliers: %u, skipped_frames: %u, relocks: %u}\n",
+				render_pll_locked(&frame_clock) ? "true" : "false",
+				(unsigned long long) render_pll_period_usec(&frame_clock),
+				(unsigned long long) frame_clock.jitter_usec16 / 16,
+				render_clock_tick_nsec / 1000.0,
+				frame_clock.stat_frames,
+				frame_clock.stat_outliers,
+				frame_clock.stat_skipped_frames,
+				frame_clock.stat_relocks
+			);
+			render_pll_reset_stats(&frame_clock);
+
+			pthread_mutex_lock(&g_server_config.mutex);
+			int32_t jitter_buffer_ms = g_server_config.jitter_buffer_ms;
+			pthread_mutex_unlock(&g_server_config.mutex);
+
+			pthread_mutex_lock(&g_runtime_state.jitter_mutex);
+			render_jitter_t* jitter = &g_runtime_state.jitter;
+			printf("[render] jitter_info={mode: \"%s\", depth_usec: %llu, queued_frames: %u, timed_frames: %u, late_frames: %u, dropped_frames: %u, resyncs: %u}\n",
+				jitter_buffer_ms == RENDER_JITTER_DEPTH_AUTO ? "auto" : jitter_buffer_ms > 0 ? "fixed" : "off",
+				(unsigned long long) render_jitter_depth_usec(jitter, jitter_buffer_ms),
+				g_runtime_state.jitter_count,
+				jitter->stat_frames,
+				jitter->stat_late_frames,
+				g_runtime_state.jitter_dropped_frames,
+				jitter->stat_resyncs
+			);
+			render_jitter_reset_stats(jitter);
+			g_runtime_state.jitter_dropped_frames = 0;
+			pthread_mutex_unlock(&g_runtime_state.jitter_mutex);
 
 
 			frames_since_last_fps_report = 0;
 			frame_duration_sum_usec = 0;
+			paused_usec_since_last_fps_report = 0;
+		}
+
+		// Wait for the next tick. New frames are picked up on the next tick rather than waking the thread early, so the
+		// output rate stays steady while data is streaming. Without a clock, just give other threads a chance to run;
+		// the animation was found to be quite choppy on a Raspberry Pi B+ without that.
+		if (render_clock_rate_hz > 0) {
+			wait_for_render_event(render_timer_fd, -1, -1);
+		} else {
+			sched_yield();
 		}
 	}
 
-	spio_close(g_runtime_state.spio_conn);
+	close(render_timer_fd);
+	render_pool_destroy(render_pool);
+	free(led_frames);
+	free(net_rgb);
+	for (uint32_t i=0; i<g_runtime_state.spio_conn_count; i++) {
+		if (g_runtime_state.spi_writers[i] != NULL) {
+			spio_writer_flush(g_runtime_state.spi_writers[i]);
+		}
+		spio_close(g_runtime_state.spio_conns[i]);
+	}
 	pthread_exit(NULL);
 }
 
@@ -1435,9 +2581,40 @@ typedef enum
 
 typedef enum
 {
-	OPC_LEDSPI_CMD_GET_CONFIG = 1
+	OPC_LEDSPI_CMD_GET_CONFIG = 1,
+
+	// Pixel data for a channel, as for command 0, that the sender means to be shown at a given time
+	OPC_LEDSPI_CMD_TIMED_FRAME = 2
 } opc_ledspi_cmd_id_t;
 
+// A timed frame's payload starts with the system and command ids, and the time the sender means the frame to be shown
+// at, as a big-endian 64-bit count of microseconds on any clock of the sender's that doesn't jump. Then come the
+// pixels.
+#define OPC_LEDSPI_TIMED_FRAME_HEADER_SIZE (2 + 1 + 8)
+
+/**
+* Handle a LedSPI timed frame for the given channel. Returns FALSE if the payload is too short to hold one.
+*/
+static uint8_t handle_timed_frame(uint8_t channel, uint8_t* payload, size_t payload_len) {
+	if (payload_len < OPC_LEDSPI_TIMED_FRAME_HEADER_SIZE) {
+		return FALSE;
+	}
+
+	uint64_t sender_usec = 0;
+	for (uint32_t i=3; i<OPC_LEDSPI_TIMED_FRAME_HEADER_SIZE; i++) {
+		sender_usec = sender_usec << 8 | payload[i];
+	}
+
+	set_timed_channel_data(
+		channel,
+		sender_usec,
+		payload + OPC_LEDSPI_TIMED_FRAME_HEADER_SIZE,
+		(uint32_t) (payload_len - OPC_LEDSPI_TIMED_FRAME_HEADER_SIZE),
+		TRUE
+	);
+	return TRUE;
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Demo Data Thread
 //
@@ -1514,14 +2691,15 @@ void* demo_thread(void* unused_data)
 #pragma clang diagnostic ignored "-Wmissing-noreturn"
 	for (uint16_t frame_index = 0; /*ever*/; frame_index +=3) {
 		// Calculate time since last remote data
-		pthread_mutex_lock(&g_runtime_state.mutex);
-		gettimeofday(&now_tv, NULL);
+		pthread_mutex_lock(&g_runtime_state.producer_mutex);
+		monotonic_time(&now_tv);
 		timersub(&now_tv, &g_runtime_state.last_remote_data_tv, &delta_tv);
-		pthread_mutex_unlock(&g_runtime_state.mutex);
+		pthread_mutex_unlock(&g_runtime_state.producer_mutex);
 
 		pthread_mutex_lock(&g_server_config.mutex);
 		uint32_t leds_per_strip = g_server_config.leds_per_strip;
-		uint32_t channel_count = g_server_config.leds_per_strip*3* SPISCAPE_MAX_STRIPS;
+		uint32_t strip_count = g_server_config.used_strip_count;
+		uint32_t channel_count = g_server_config.leds_per_strip*3* strip_count;
 		demo_mode_t demo_mode = g_server_config.demo_mode;
 		pthread_mutex_unlock(&g_server_config.mutex);
 
@@ -1547,7 +2725,7 @@ void* demo_thread(void* unused_data)
 				memset(buffer, 0, buffer_size);
 			}
 
-			for (uint32_t strip = 0, data_index = 0 ; strip < SPISCAPE_MAX_STRIPS; strip++)
+			for (uint32_t strip = 0, data_index = 0 ; strip < strip_count; strip++)
 			{
 				for (uint16_t p = 0 ; p < leds_per_strip; p++, data_index+=3)
 				{
@@ -1692,12 +2870,6 @@ void* e131_server_thread(void* unused_data)
 		fprintf(stderr, "[e131] failed to bind to multicast addresses\n");
 	}
 
-	uint8_t* dmx_buffer = NULL;
-	uint32_t dmx_buffer_size = 0;
-
-	uint32_t packets_since_update = 0;
-	uint32_t frame_counter_at_last_update = g_runtime_state.frame_counter;
-
 	while (1)
 	{
 		const ssize_t received_packet_size = recv(sock, packet_buffer, sizeof(packet_buffer), 0);
@@ -1706,18 +2878,6 @@ void* e131_server_thread(void* unused_data)
 			continue;
 		}
 
-		// Ensure the buffer
-		pthread_mutex_lock(&g_server_config.mutex);
-		uint32_t leds_per_strip = g_server_config.leds_per_strip;
-		uint32_t led_count = g_server_config.leds_per_strip * SPISCAPE_MAX_STRIPS;
-		pthread_mutex_unlock(&g_server_config.mutex);
-
-		if (dmx_buffer == NULL || dmx_buffer_size != led_count) {
-			if (dmx_buffer != NULL) free(dmx_buffer);
-			dmx_buffer_size = led_count * sizeof(buffer_pixel_t);
-			dmx_buffer = malloc(dmx_buffer_size);
-		}
-
 		// Packet should be at least 126 bytes for the header
 		if (received_packet_size >= 126) {
 			int32_t current_seq_num = packet_buffer[111];
@@ -1729,24 +2889,11 @@ void* e131_server_thread(void* unused_data)
 				uint16_t dmx_universe_num = ((uint16_t)packet_buffer[113] << 8) | packet_buffer[114];
 
 				if (dmx_universe_num >= 1 && dmx_universe_num <= 48) {
-					uint16_t ledspi_channel_num = dmx_universe_num - 1;
-					// Data OK
-//					set_next_frame_single_channel_data(
-//						ledspi_channel_num,
-//						packet_buffer + 126,
-//						received_packet_size - 126,
-//						TRUE
-//					);
-
-					memcpy(
-						dmx_buffer + ledspi_channel_num * leds_per_strip * sizeof(buffer_pixel_t),
+					// Data OK; each universe drives the strip with the same number
+					set_next_channel_data(
+						(uint8_t) dmx_universe_num,
 						packet_buffer + 126,
-						min(received_packet_size - 126, led_count * sizeof(buffer_pixel_t))
-					);
-
-					set_next_frame_data(
-						dmx_buffer,
-						dmx_buffer_size * sizeof(buffer_pixel_t),
+						received_packet_size - 126,
 						TRUE
 					);
 				} else {
@@ -1763,19 +2910,6 @@ void* e131_server_thread(void* unused_data)
 		} else {
 			fprintf(stderr, "[e131] packet too small: %d < 126 \n", received_packet_size);
 		}
-
-		// Increment counter
-		packets_since_update ++;
-		if (g_runtime_state.frame_counter != frame_counter_at_last_update) {
-			packets_since_update = 0;
-			frame_counter_at_last_update = g_runtime_state.frame_counter;
-		}
-
-		if (packets_since_update >= SPISCAPE_MAX_STRIPS) {
-			// Force an update here
-			while (g_runtime_state.frame_counter == frame_counter_at_last_update)
-				usleep(1e3 /* 1ms */);
-		}
 	}
 
 	pthread_exit(NULL);
@@ -1841,7 +2975,7 @@ void* udp_server_thread(void* unused_data)
 			// Enough data for the entire command?
 			if (rc >= sizeof(opc_cmd_t) + cmd_len) {
 				if (cmd->command == 0) {
-					set_next_frame_data(opc_cmd_payload, cmd_len, TRUE);
+					set_next_channel_data(cmd->channel, opc_cmd_payload, cmd_len, TRUE);
 				} else if (cmd->command == 255) {
 					// System specific commands
 					const uint16_t system_id = opc_cmd_payload[0] << 8 | opc_cmd_payload[1];
@@ -1851,6 +2985,10 @@ void* udp_server_thread(void* unused_data)
 
 						if (ledspi_cmd_id == OPC_LEDSPI_CMD_GET_CONFIG) {
 							warn("[udp] WARN: Config request request received but not supported on UDP.\n");
+						} else if (ledspi_cmd_id == OPC_LEDSPI_CMD_TIMED_FRAME) {
+							if (! handle_timed_frame(cmd->channel, opc_cmd_payload, cmd_len)) {
+								warn("[udp] WARN: Received timed frame without a timestamp\n");
+							}
 						} else {
 							warn("[udp] WARN: Received command for unsupported LedSPI Command: %d\n", (int)ledspi_cmd_id);
 						}
@@ -1872,38 +3010,44 @@ static void event_handler(struct ns_connection *conn, enum ns_event ev, void *ev
 
 	switch (ev) {
 		case NS_RECV: {
-			// Enough data for an OPC command header?
-			if (io->len >= sizeof(opc_cmd_t)) {
+			// Handle every complete OPC command received, since frames sent in a burst often arrive together
+			while (io->len >= sizeof(opc_cmd_t)) {
 				opc_cmd_t* cmd = (opc_cmd_t*) io->buf;
 				const size_t cmd_len = cmd->len_hi << 8 | cmd->len_lo;
 
 				uint8_t* opc_cmd_payload = ((uint8_t*)io->buf) + sizeof(opc_cmd_t);
 
-				// Enough data for the entire command?
-				if (io->len >= sizeof(opc_cmd_t) + cmd_len) {
-					if (cmd->command == 0) {
-						set_next_frame_data(opc_cmd_payload, cmd_len, TRUE);
-					} else if (cmd->command == 255) {
-						// System specific commands
-						const uint16_t system_id = opc_cmd_payload[0] << 8 | opc_cmd_payload[1];
-
-						if (system_id == OPC_SYSID_LEDSPI) {
-							const opc_ledspi_cmd_id_t ledspi_cmd_id = opc_cmd_payload[2];
-
-							if (ledspi_cmd_id == OPC_LEDSPI_CMD_GET_CONFIG) {
-								warn("[tcp] Responding to config request\n");
-								ns_send(conn, g_server_config.json, strlen(g_server_config.json)+1);
-							} else {
-								warn("[tcp] WARN: Received command for unsupported LedSPI Command: %d\n", (int)ledspi_cmd_id);
+				// Wait for the rest of the command
+				if (io->len < sizeof(opc_cmd_t) + cmd_len) {
+					break;
+				}
+
+				if (cmd->command == 0) {
+					set_next_channel_data(cmd->channel, opc_cmd_payload, cmd_len, TRUE);
+				} else if (cmd->command == 255) {
+					// System specific commands
+					const uint16_t system_id = opc_cmd_payload[0] << 8 | opc_cmd_payload[1];
+
+					if (system_id == OPC_SYSID_LEDSPI) {
+						const opc_ledspi_cmd_id_t ledspi_cmd_id = opc_cmd_payload[2];
+
+						if (ledspi_cmd_id == OPC_LEDSPI_CMD_GET_CONFIG) {
+							warn("[tcp] Responding to config request\n");
+							ns_send(conn, g_server_config.json, strlen(g_server_config.json)+1);
+						} else if (ledspi_cmd_id == OPC_LEDSPI_CMD_TIMED_FRAME) {
+							if (! handle_timed_frame(cmd->channel, opc_cmd_payload, cmd_len)) {
+								warn("[tcp] WARN: Received timed frame without a timestamp\n");
 							}
 						} else {
-							warn("[tcp] WARN: Received command for unsupported system-id: %d\n", (int)system_id);
+							warn("[tcp] WARN: Received command for unsupported LedSPI Command: %d\n", (int)ledspi_cmd_id);
 						}
+					} else {
+						warn("[tcp] WARN: Received command for unsupported system-id: %d\n", (int)system_id);
 					}
-
-					// Removed the processed command from the buffer
-					iobuf_remove(io, sizeof(opc_cmd_t) + cmd_len);
 				}
+
+				// Removed the processed command from the buffer
+				iobuf_remove(io, sizeof(opc_cmd_t) + cmd_len);
 			}
 
 			// Fallback to handle misformed data. Clear the io buffer if we have more
@@ -0,0 +1,599 @@
+/** \file
+ * Network output: E1.31 and DDP senders.
+ */
+#define _GNU_SOURCE
+
+#include "netout.h"
+#include "util.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#define min(a,b) ((a)<(b)?(a):(b))
+
+// E1.31 data packet: root, framing and DMP layers, then the start code and up to 512 slots
+#define NETOUT_E131_HEADER_BYTES 126
+#define NETOUT_E131_PIXELS_PER_UNIVERSE 170
+#define NETOUT_E131_MAX_UNIVERSE 63999
+
+// DDP: 10-byte header, and no more data than fits in a standard Ethernet frame
+#define NETOUT_DDP_HEADER_BYTES 10
+#define NETOUT_DDP_PIXELS_PER_PACKET 480
+
+#define NETOUT_MAX_PACKET_BYTES (NETOUT_DDP_HEADER_BYTES + NETOUT_DDP_PIXELS_PER_PACKET * 3)
+
+// Packets handed to one sendmmsg() call
+#define NETOUT_SEND_BATCH 64
+
+typedef struct {
+	netout_destination_t config;
+	struct sockaddr_in address;
+
+	// E1.31 sequence number, or DDP sequence number from 1 to 15
+	uint8_t sequence;
+
+	// Number of the frame last sent and when, on the monotonic clock
+	uint64_t sent_frame;
+	uint64_t sent_usec;
+} netout_target_t;
+
+typedef struct {
+	uint8_t* rgb;
+	uint32_t pixel_count;
+	uint32_t capacity;
+} netout_frame_t;
+
+struct netout {
+	netout_target_t targets[NETOUT_MAX_DESTINATIONS];
+	uint32_t target_count;
+
+	int socket_fd;
+
+	// E1.31 component identifier, a random UUID
+	uint8_t cid[16];
+
+	// The latest submitted frame; guarded by mutex
+	netout_frame_t pending;
+	bool has_pending;
+
+	// The frame being sent, and how many frames have been taken from pending; only used by the sender thread
+	netout_frame_t sending;
+	uint64_t frame_number;
+
+	// Packets built for the current frame, and the target each one goes to
+	uint8_t (*packets)[NETOUT_MAX_PACKET_BYTES];
+	uint32_t* packet_lengths;
+	netout_target_t** packet_targets;
+	uint32_t packet_count;
+	uint32_t packet_capacity;
+
+	// Frames in a row that failed to send
+	uint32_t failed_frames;
+
+	pthread_t thread;
+	pthread_mutex_t mutex;
+
+	// Signalled when a frame is submitted or the sender is stopping
+	pthread_cond_t submitted_cond;
+
+	bool stopping;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Destination Lists
+
+static bool netout_parse_number(const char** cursor, uint32_t max_value, uint32_t* value_out) {
+	char* end = NULL;
+	errno = 0;
+	unsigned long value = strtoul(*cursor, &end, 10);
+
+	if (end == *cursor || errno != 0 || value > max_value) {
+		return false;
+	}
+
+	*cursor = end;
+	*value_out = (uint32_t) value;
+	return true;
+}
+
+static bool netout_parse_destination(const char* spec, netout_destination_t* dest, char* error, size_t error_size) {
+	memset(dest, 0, sizeof(netout_destination_t));
+	dest->universe = 1;
+
+	const char* cursor = spec;
+	if (strncasecmp(cursor, "e131:", 5) == 0) {
+		dest->protocol = NETOUT_PROTOCOL_E131;
+		dest->port = NETOUT_E131_PORT;
+		cursor += 5;
+	} else if (strncasecmp(cursor, "ddp:", 4) == 0) {
+		dest->protocol = NETOUT_PROTOCOL_DDP;
+		dest->port = NETOUT_DDP_PORT;
+		cursor += 4;
+	} else {
+		snprintf(error, error_size, "Network output %s has no e131: or ddp: prefix", spec);
+		return false;
+	}
+
+	size_t host_length = strcspn(cursor, ":/#@");
+	if (host_length == 0 || host_length >= sizeof(dest->host)) {
+		snprintf(error, error_size, "Network output %s has no valid host", spec);
+		return false;
+	}
+	memcpy(dest->host, cursor, host_length);
+	dest->host[host_length] = 0;
+	cursor += host_length;
+
+	uint32_t value = 0;
+	bool valid = true;
+
+	if (*cursor == ':') {
+		cursor++;
+		valid = netout_parse_number(&cursor, 65535, &value) && value > 0;
+		dest->port = (uint16_t) value;
+	}
+
+	if (valid && *cursor == '/') {
+		cursor++;
+		valid = netout_parse_number(&cursor, UINT32_MAX, &dest->first_pixel);
+
+		if (valid && *cursor == '+') {
+			cursor++;
+			valid = netout_parse_number(&cursor, UINT32_MAX, &dest->pixel_count) && dest->pixel_count > 0;
+		}
+	}
+
+	if (valid && *cursor == '#') {
+		cursor++;
+		valid = dest->protocol == NETOUT_PROTOCOL_E131
+			&& netout_parse_number(&cursor, NETOUT_E131_MAX_UNIVERSE, &value)
+			&& value > 0;
+		dest->universe = (uint16_t) value;
+	}
+
+	if (valid && *cursor == '@') {
+		cursor++;
+		valid = netout_parse_number(&cursor, 10000, &dest->max_rate_hz);
+	}
+
+	if (! valid || *cursor != 0) {
+		snprintf(error, error_size, "Network output %s is not <protocol>:<host>[:<port>][/<first>[+<count>]][#<universe>][@<hz>]", spec);
+		return false;
+	}
+
+	return true;
+}
+
+int netout_parse_destinations(
+	const char* list,
+	netout_destination_t* destinations,
+	char* error,
+	size_t error_size
+) {
+	int count = 0;
+	const char* cursor = list;
+
+	while (*cursor != 0) {
+		size_t length = strcspn(cursor, ",");
+		char spec[512];
+
+		// Trim surrounding whitespace
+		const char* start = cursor;
+		const char* end = cursor + length;
+		while (start < end && (*start == ' ' || *start == '\t')) start++;
+		while (end > start && (end[-1] == ' ' || end[-1] == '\t')) end--;
+
+		if (end > start) {
+			if (count == NETOUT_MAX_DESTINATIONS) {
+				snprintf(error, error_size, "More than %d network outputs given", NETOUT_MAX_DESTINATIONS);
+				return -1;
+			}
+
+			snprintf(spec, sizeof(spec), "%.*s", (int) (end - start), start);
+			if (! netout_parse_destination(spec, &destinations[count], error, error_size)) {
+				return -1;
+			}
+			count++;
+		}
+
+		cursor += length;
+		if (*cursor == ',') cursor++;
+	}
+
+	return count;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Packets
+
+static inline void netout_put16(uint8_t* out, uint32_t value) {
+	out[0] = (uint8_t) (value >> 8);
+	out[1] = (uint8_t) value;
+}
+
+static inline void netout_put32(uint8_t* out, uint32_t value) {
+	out[0] = (uint8_t) (value >> 24);
+	out[1] = (uint8_t) (value >> 16);
+	out[2] = (uint8_t) (value >> 8);
+	out[3] = (uint8_t) value;
+}
+
+static uint8_t* netout_add_packet(netout_t* netout, netout_target_t* target, uint32_t length) {
+	if (netout->packet_count == netout->packet_capacity) {
+		uint32_t capacity = netout->packet_capacity * 2 + 16;
+		void* packets = realloc(netout->packets, capacity * sizeof(netout->packets[0]));
+		if (packets != NULL) netout->packets = packets;
+		void* lengths = realloc(netout->packet_lengths, capacity * sizeof(uint32_t));
+		if (lengths != NULL) netout->packet_lengths = lengths;
+		void* targets = realloc(netout->packet_targets, capacity * sizeof(netout_target_t*));
+		if (targets != NULL) netout->packet_targets = targets;
+
+		if (packets == NULL || lengths == NULL || targets == NULL) {
+			return NULL;
+		}
+		netout->packet_capacity = capacity;
+	}
+
+	uint32_t index = netout->packet_count++;
+	netout->packet_lengths[index] = length;
+	netout->packet_targets[index] = target;
+	return netout->packets[index];
+}
+
+/**
+ * Builds an E1.31 data packet for up to NETOUT_E131_PIXELS_PER_UNIVERSE pixels, following ANSI E1.31-2018.
+ */
+static void netout_build_e131(netout_t* netout, netout_target_t* target, uint16_t universe, const uint8_t* rgb, uint32_t pixel_count) {
+	uint32_t slot_count = pixel_count * 3;
+	uint32_t length = NETOUT_E131_HEADER_BYTES + slot_count;
+	uint8_t* packet = netout_add_packet(netout, target, length);
+	if (packet == NULL) {
+		return;
+	}
+
+	memset(packet, 0, NETOUT_E131_HEADER_BYTES);
+
+	// Root layer
+	netout_put16(&packet[0], 0x0010);
+	memcpy(&packet[4], "ASC-E1.17", 9);
+	netout_put16(&packet[16], 0x7000 | (length - 16));
+	netout_put32(&packet[18], 0x00000004);
+	memcpy(&packet[22], netout->cid, sizeof(netout->cid));
+
+	// Framing layer
+	netout_put16(&packet[38], 0x7000 | (length - 38));
+	netout_put32(&packet[40], 0x00000002);
+	memcpy(&packet[44], "LedSPI", 6);
+	packet[108] = 100; // Default priority
+	packet[111] = target->sequence;
+	netout_put16(&packet[113], universe);
+
+	// DMP layer: one property value per slot, after the start code
+	netout_put16(&packet[115], 0x7000 | (length - 115));
+	packet[117] = 0x02;
+	packet[118] = 0xA1;
+	netout_put16(&packet[121], 0x0001);
+	netout_put16(&packet[123], 1 + slot_count);
+	packet[125] = 0x00;
+
+	memcpy(&packet[NETOUT_E131_HEADER_BYTES], rgb, slot_count);
+}
+
+/**
+ * Builds a DDP data packet for up to NETOUT_DDP_PIXELS_PER_PACKET pixels, byte_offset bytes into the receiver's pixels.
+ */
+static void netout_build_ddp(netout_t* netout, netout_target_t* target, uint32_t byte_offset, const uint8_t* rgb, uint32_t pixel_count, bool push) {
+	uint32_t data_length = pixel_count * 3;
+	uint8_t* packet = netout_add_packet(netout, target, NETOUT_DDP_HEADER_BYTES + data_length);
+	if (packet == NULL) {
+		return;
+	}
+
+	// Version 1, with the push flag on the last packet of the frame telling the receiver to show it
+	packet[0] = (uint8_t) (0x40 | (push ? 0x01 : 0x00));
+	packet[1] = target->sequence;
+	packet[2] = 0x0B; // RGB, 8 bits per channel
+	packet[3] = 0x01; // Default output device
+	netout_put32(&packet[4], byte_offset);
+	netout_put16(&packet[8], data_length);
+
+	memcpy(&packet[NETOUT_DDP_HEADER_BYTES], rgb, data_length);
+}
+
+/**
+ * Builds the packets sending the target's pixels of the current frame.
+ */
+static void netout_build_frame(netout_t* netout, netout_target_t* target) {
+	const netout_frame_t* frame = &netout->sending;
+	uint32_t first_pixel = target->config.first_pixel;
+	if (first_pixel >= frame->pixel_count) {
+		return;
+	}
+
+	uint32_t pixel_count = frame->pixel_count - first_pixel;
+	if (target->config.pixel_count > 0) {
+		pixel_count = min(pixel_count, target->config.pixel_count);
+	}
+
+	const uint8_t* rgb = &frame->rgb[first_pixel * 3];
+
+	if (target->config.protocol == NETOUT_PROTOCOL_E131) {
+		target->sequence++;
+
+		uint32_t universe = target->config.universe;
+		for (uint32_t i=0; i<pixel_count && universe <= NETOUT_E131_MAX_UNIVERSE; i+=NETOUT_E131_PIXELS_PER_UNIVERSE, universe++) {
+			netout_build_e131(netout, target, (uint16_t) universe, &rgb[i*3], min(pixel_count - i, NETOUT_E131_PIXELS_PER_UNIVERSE));
+		}
+	} else {
+		target->sequence = (uint8_t) (target->sequence % 15 + 1);
+
+		for (uint32_t i=0; i<pixel_count; i+=NETOUT_DDP_PIXELS_PER_PACKET) {
+			uint32_t packet_pixels = min(pixel_count - i, NETOUT_DDP_PIXELS_PER_PACKET);
+			netout_build_ddp(netout, target, i*3, &rgb[i*3], packet_pixels, i + packet_pixels == pixel_count);
+		}
+	}
+}
+
+/**
+ * Sends the built packets, NETOUT_SEND_BATCH per system call.
+ */
+static void netout_send_packets(netout_t* netout) {
+	int send_errno = 0;
+	uint32_t sent = 0;
+
+	while (sent < netout->packet_count) {
+		struct mmsghdr messages[NETOUT_SEND_BATCH];
+		struct iovec iovecs[NETOUT_SEND_BATCH];
+		uint32_t batch_count = min(netout->packet_count - sent, NETOUT_SEND_BATCH);
+
+		memset(messages, 0, batch_count * sizeof(struct mmsghdr));
+		for (uint32_t i=0; i<batch_count; i++) {
+			iovecs[i].iov_base = netout->packets[sent + i];
+			iovecs[i].iov_len = netout->packet_lengths[sent + i];
+			messages[i].msg_hdr.msg_name = &netout->packet_targets[sent + i]->address;
+			messages[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+			messages[i].msg_hdr.msg_iov = &iovecs[i];
+			messages[i].msg_hdr.msg_iovlen = 1;
+		}
+
+		int result = sendmmsg(netout->socket_fd, messages, batch_count, 0);
+		if (result < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+
+			// Skip the packet that failed, so one unreachable destination doesn't hold up the others
+			send_errno = errno;
+			result = 1;
+		}
+
+		sent += (uint32_t) result;
+	}
+
+	// Log when sends start and stop failing, not every failed frame
+	if (send_errno != 0) {
+		if (netout->failed_frames++ == 0) {
+			fprintf(stderr, "[net] Failed to send frame: %s\n", strerror(send_errno));
+		}
+	} else if (netout->failed_frames > 0 && netout->packet_count > 0) {
+		fprintf(stderr, "[net] Sends recovered after %u failed frames\n", netout->failed_frames);
+		netout->failed_frames = 0;
+	}
+
+	netout->packet_count = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Sender Thread
+
+static uint64_t netout_now_usec(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t) now.tv_sec * 1000000 + (uint64_t) now.tv_nsec / 1000;
+}
+
+static void* netout_thread(void* netout_data) {
+	netout_t* netout = netout_data;
+
+	pthread_mutex_lock(&netout->mutex);
+
+	while (! netout->stopping) {
+		if (netout->has_pending) {
+			netout_frame_t taken = netout->pending;
+			netout->pending = netout->sending;
+			netout->sending = taken;
+			netout->has_pending = false;
+			netout->frame_number++;
+		}
+
+		pthread_mutex_unlock(&netout->mutex);
+
+		// Send the new frame to every destination whose rate allows it, and the last one again to destinations that
+		// haven't been sent anything for a while
+		uint64_t now_usec = netout_now_usec();
+		uint64_t wake_usec = now_usec + NETOUT_KEEPALIVE_USEC;
+
+		for (uint32_t i=0; i<netout->target_count && netout->frame_number > 0; i++) {
+			netout_target_t* target = &netout->targets[i];
+			uint64_t due_usec = target->sent_frame != netout->frame_number
+				? target->sent_usec + (target->config.max_rate_hz > 0 ? 1000000 / target->config.max_rate_hz : 0)
+				: target->sent_usec + NETOUT_KEEPALIVE_USEC;
+
+			if (due_usec <= now_usec) {
+				netout_build_frame(netout, target);
+				target->sent_frame = netout->frame_number;
+				target->sent_usec = now_usec;
+				due_usec = now_usec + NETOUT_KEEPALIVE_USEC;
+			}
+
+			wake_usec = min(wake_usec, due_usec);
+		}
+
+		netout_send_packets(netout);
+
+		pthread_mutex_lock(&netout->mutex);
+
+		if (! netout->has_pending && ! netout->stopping) {
+			struct timespec deadline = {
+				.tv_sec = (time_t) (wake_usec / 1000000),
+				.tv_nsec = (long) (wake_usec % 1000000) * 1000
+			};
+			pthread_cond_timedwait(&netout->submitted_cond, &netout->mutex, &deadline);
+		}
+	}
+
+	pthread_mutex_unlock(&netout->mutex);
+
+	return NULL;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Lifecycle
+
+static void netout_make_cid(uint8_t* cid) {
+	int fd = open("/dev/urandom", O_RDONLY);
+	ssize_t length = fd >= 0 ? read(fd, cid, 16) : -1;
+	if (fd >= 0) close(fd);
+
+	if (length != 16) {
+		struct timeval now;
+		monotonic_time(&now);
+		uint64_t seed[] = { (uint64_t) getpid(), (uint64_t) now.tv_sec, (uint64_t) now.tv_usec };
+		uint64_t halves[2];
+		halves[0] = hash64(seed, sizeof(seed));
+		halves[1] = hash64(halves, sizeof(halves[0]));
+		memcpy(cid, halves, 16);
+	}
+
+	// Version 4 (random) UUID
+	cid[6] = (uint8_t) ((cid[6] & 0x0F) | 0x40);
+	cid[8] = (uint8_t) ((cid[8] & 0x3F) | 0x80);
+}
+
+netout_t* netout_create(const char* list) {
+	netout_destination_t destinations[NETOUT_MAX_DESTINATIONS];
+	char error[1024];
+	int destination_count = netout_parse_destinations(list, destinations, error, sizeof(error));
+	if (destination_count < 0) {
+		fprintf(stderr, "[net] %s\n", error);
+		return NULL;
+	}
+
+	netout_t* netout = calloc(1, sizeof(netout_t));
+	if (netout == NULL) {
+		return NULL;
+	}
+
+	netout->socket_fd = socket(AF_INET, SOCK_DGRAM, 0);
+	if (netout->socket_fd < 0) {
+		fprintf(stderr, "[net] socket failed: %s\n", strerror(errno));
+		free(netout);
+		return NULL;
+	}
+
+	// Allow sending to broadcast addresses, which DMX gateways are often set up with
+	int enable = 1;
+	setsockopt(netout->socket_fd, SOL_SOCKET, SO_BROADCAST, &enable, sizeof(enable));
+
+	netout_make_cid(netout->cid);
+
+	for (int i=0; i<destination_count; i++) {
+		struct addrinfo hints = { .ai_family = AF_INET, .ai_socktype = SOCK_DGRAM };
+		struct addrinfo* addresses = NULL;
+
+		int error_code = getaddrinfo(destinations[i].host, NULL, &hints, &addresses);
+		if (error_code != 0 || addresses == NULL) {
+			fprintf(stderr, "[net] Can't resolve %s: %s; skipping\n", destinations[i].host, gai_strerror(error_code));
+			continue;
+		}
+
+		netout_target_t* target = &netout->targets[netout->target_count++];
+		target->config = destinations[i];
+		memcpy(&target->address, addresses->ai_addr, sizeof(struct sockaddr_in));
+		target->address.sin_port = htons(destinations[i].port);
+		freeaddrinfo(addresses);
+
+		printf(
+			"[net] Sending %s to %s:%d\n",
+			target->config.protocol == NETOUT_PROTOCOL_E131 ? "E1.31" : "DDP",
+			target->config.host,
+			target->config.port
+		);
+	}
+
+	pthread_condattr_t cond_attr;
+	pthread_condattr_init(&cond_attr);
+	pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC);
+	pthread_mutex_init(&netout->mutex, NULL);
+	pthread_cond_init(&netout->submitted_cond, &cond_attr);
+	pthread_condattr_destroy(&cond_attr);
+
+	int error_code = pthread_create(&netout->thread, NULL, netout_thread, netout);
+	if (error_code != 0) {
+		fprintf(stderr, "[net] Failed to start network output thread\n");
+
+		pthread_mutex_destroy(&netout->mutex);
+		pthread_cond_destroy(&netout->submitted_cond);
+		close(netout->socket_fd);
+		free(netout);
+		return NULL;
+	}
+
+	return netout;
+}
+
+void netout_destroy(netout_t* netout) {
+	if (netout == NULL) {
+		return;
+	}
+
+	pthread_mutex_lock(&netout->mutex);
+	netout->stopping = true;
+	pthread_cond_signal(&netout->submitted_cond);
+	pthread_mutex_unlock(&netout->mutex);
+
+	pthread_join(netout->thread, NULL);
+
+	pthread_mutex_destroy(&netout->mutex);
+	pthread_cond_destroy(&netout->submitted_cond);
+	close(netout->socket_fd);
+
+	free(netout->pending.rgb);
+	free(netout->sending.rgb);
+	free(netout->packets);
+	free(netout->packet_lengths);
+	free(netout->packet_targets);
+	free(netout);
+}
+
+void netout_submit(netout_t* netout, const uint8_t* rgb, uint32_t pixel_count) {
+	pthread_mutex_lock(&netout->mutex);
+
+	netout_frame_t* pending = &netout->pending;
+	if (pending->capacity < pixel_count) {
+		uint8_t* grown = realloc(pending->rgb, (size_t) pixel_count * 3);
+		if (grown == NULL) {
+			pthread_mutex_unlock(&netout->mutex);
+			return;
+		}
+
+		pending->rgb = grown;
+		pending->capacity = pixel_count;
+	}
+
+	memcpy(pending->rgb, rgb, (size_t) pixel_count * 3);
+	pending->pixel_count = pixel_count;
+	netout->has_pending = true;
+
+	pthread_cond_signal(&netout->submitted_cond);
+	pthread_mutex_unlock(&netout->mutex);
+}
@@ -0,0 +1,84 @@
+/** \file
+ * Network output: forwards slices of each rendered frame to E1.31 (sACN) or DDP receivers, such as DMX gateways and
+ * pixel controllers, alongside the SPI output.
+ *
+ * Frames are handed over as 8-bit RGB after interpolation, LUT and dithering, and sent from a thread of its own: the
+ * render thread only copies the frame into a pending buffer, replacing any frame the thread hasn't picked up yet, so a
+ * slow network drops frames instead of holding up the SPI output. Each frame's packets for all destinations go out in
+ * as few sendmmsg() calls as possible.
+ *
+ * Destinations are listed in one string, separated by commas:
+ *
+ *     <protocol>:<host>[:<port>][/<first pixel>[+<pixel count>]][#<universe>][@<max rate hz>]
+ *
+ * protocol is e131 or ddp. The pixel range defaults to the whole frame, the universe (E1.31 only) to 1 and the rate to
+ * every frame. E1.31 destinations take 170 pixels per universe, in consecutive universes.
+ */
+#ifndef SPISCAPE_NETOUT_H
+#define SPISCAPE_NETOUT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define NETOUT_MAX_DESTINATIONS 16
+
+#define NETOUT_E131_PORT 5568
+#define NETOUT_DDP_PORT 4048
+
+// Receivers drop E1.31 sources they haven't heard from in 2.5 s, so frames are resent at least this often
+#define NETOUT_KEEPALIVE_USEC 1000000
+
+typedef enum {
+	NETOUT_PROTOCOL_E131,
+	NETOUT_PROTOCOL_DDP
+} netout_protocol_t;
+
+typedef struct {
+	netout_protocol_t protocol;
+	char host[256];
+	uint16_t port;
+
+	// Pixels of the frame to send; a pixel_count of 0 sends everything from first_pixel on
+	uint32_t first_pixel;
+	uint32_t pixel_count;
+
+	// First E1.31 universe
+	uint16_t universe;
+
+	// Frames per second to send at most, or 0 for every frame
+	uint32_t max_rate_hz;
+} netout_destination_t;
+
+typedef struct netout netout_t;
+
+/**
+ * Parses a destination list into destinations, which must have room for NETOUT_MAX_DESTINATIONS.
+ *
+ * \return the number of destinations, or -1 with a description of the problem in error
+ */
+extern int netout_parse_destinations(
+	const char* list,
+	netout_destination_t* destinations,
+	char* error,
+	size_t error_size
+);
+
+/**
+ * Resolves the destinations in the list and starts the sender thread. Destinations that can't be resolved are
+ * skipped. Returns NULL after printing why if the list is invalid or the thread can't be started.
+ */
+extern netout_t* netout_create(const char* list);
+
+/**
+ * Stops the sender thread and frees everything.
+ */
+extern void netout_destroy(netout_t* netout);
+
+/**
+ * Queues a frame of pixel_count 8-bit RGB pixels to be sent, replacing any frame still waiting. Never waits for the
+ * network.
+ */
+extern void netout_submit(netout_t* netout, const uint8_t* rgb, uint32_t pixel_count);
+
+#endif //SPISCAPE_NETOUT_H
@@ -0,0 +1,875 @@
+/** \file
+ * Scalar reference render kernel, runtime kernel selection and kernel verification.
+ */
+#include "render.h"
+
+#include <endian.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#if defined(__arm__) && !defined(__aarch64__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+
+#ifndef HWCAP_NEON
+#define HWCAP_NEON (1 << 12)
+#endif
+#endif
+
+#define min(a, b) ((a) < (b) ? (a) : (b))
+#define max(a, b) ((a) > (b) ? (a) : (b))
+
+static inline uint32_t lutInterpolate(uint32_t value, const uint32_t* lut) {
+	// Inspired by FadeCandy: https://github.com/scanlime/fadecandy/blob/master/firmware/fc_pixel_lut.cpp
+
+	uint32_t index = value >> 8; // Range [0, 0xFF]
+	uint32_t alpha = value & 0xFF; // Range [0, 0xFF]
+	uint32_t invAlpha = 0x100 - alpha; // Range [1, 0x100]
+
+	// Result in range [0, 0xFFFF]
+	return (lut[index] * invAlpha + lut[index + 1] * alpha) >> 8;
+}
+
+/**
+ * Interpolates and applies the LUT to one channel of one pixel, returning the 16-bit value. before_previous and
+ * after_current are only read for cubic interpolation.
+ */
+RENDER_ALWAYS_INLINE int32_t render_shade_scalar(
+	const render_params_t* params,
+	const uint32_t* lookup,
+	uint8_t before_previous,
+	uint8_t previous,
+	uint8_t current,
+	uint8_t after_current,
+	const bool interpolation_enabled,
+	const bool lut_enabled,
+	const bool cubic_enabled
+) {
+	int32_t interpolated;
+
+	// Interpolate
+	if (interpolation_enabled && cubic_enabled) {
+		interpolated = render_cubic_scalar(params, before_previous, previous, current, after_current);
+	} else if (interpolation_enabled) {
+		interpolated = (previous*params->inv_frame_progress16 + current*params->frame_progress16) >> 8;
+	} else {
+		interpolated = current << 8;
+	}
+
+	// Apply LUT
+	if (lut_enabled) {
+		interpolated = lutInterpolate((uint32_t) interpolated, lookup);
+	}
+
+	return interpolated;
+}
+
+/**
+ * Dithers one 16-bit channel value down to 8 bits, updating its dithering state.
+ */
+RENDER_ALWAYS_INLINE uint8_t render_dither_scalar(
+	const render_params_t* params,
+	int32_t interpolated,
+	int16_t* overflow,
+	int8_t* last_effect_frame,
+	const bool dithering_enabled
+) {
+	// Reset dithering for this pixel if it's been too long since it actually changed anything. This serves to prevent
+	// visible blinking pixels.
+	if ((uint32_t) abs(abs(*last_effect_frame) - abs(params->dithering_frame)) > params->max_dither_frames) {
+		*overflow = 0;
+		*last_effect_frame = params->dithering_frame;
+	}
+
+	// Apply dithering overflow
+	int32_t dithered = interpolated;
+
+	if (dithering_enabled) {
+		dithered += *overflow;
+	}
+
+	// Calculate output value; a negative overflow can take a dark pixel below zero
+	uint8_t out = (uint8_t) max(0, min((dithered+0x80) >> 8, 255));
+
+	// Check for interpolation effect
+	if (out != (interpolated+0x80)>>8) *last_effect_frame = params->dithering_frame;
+
+	// Recalculate Overflow against the 16-bit value the output actually represents. The result always stays within
+	// [-0x17F, 0x7F]: anything outside is pulled back in by rounding or clamping on the next frame.
+	if (dithering_enabled) {
+		*overflow = (int16_t) (dithered - out*257);
+	}
+
+	return out;
+}
+
+RENDER_ALWAYS_INLINE void render_pixels_scalar_impl(
+	const render_params_t* params,
+	const render_frame_t* previous,
+	const render_frame_t* current,
+	render_dither_t* dither,
+	uint32_t first_pixel,
+	uint32_t pixel_count,
+	uint8_t* pixels_out,
+	const bool interpolation_enabled,
+	const bool lut_enabled,
+	const bool dithering_enabled,
+	const bool hdr_enabled,
+	const bool gain_enabled,
+	const bool cubic_enabled,
+	const bool ordered_enabled
+) {
+	const uint32_t* lookups[] = {
+		params->red_lookup,
+		params->green_lookup,
+		params->blue_lookup
+	};
+
+	// Only read for cubic interpolation
+	const render_frame_t* before_previous = interpolation_enabled && cubic_enabled ? params->before_previous : current;
+	const render_frame_t* after_current = interpolation_enabled && cubic_enabled ? params->after_current : current;
+
+	for (uint32_t i=0; i<pixel_count; i++) {
+		uint32_t pixel_index = first_pixel + i;
+		uint8_t* pixel_out = &pixels_out[i*4];
+		int32_t values[3];
+
+		for (int channel=0; channel<3; channel++) {
+			values[channel] = render_shade_scalar(
+				params,
+				lookups[channel],
+				before_previous->planes[channel][pixel_index],
+				previous->planes[channel][pixel_index],
+				current->planes[channel][pixel_index],
+				after_current->planes[channel][pixel_index],
+				interpolation_enabled,
+				lut_enabled,
+				cubic_enabled
+			);
+
+			// Apply calibration gain
+			if (gain_enabled) {
+				values[channel] = (int32_t) render_gain_apply((uint32_t) values[channel], params->gain->gains[channel][pixel_index]);
+			}
+		}
+
+		if (hdr_enabled) {
+			// APA102 LED frame: 0b111 and the pixel's global brightness, then the color channels in output order
+			uint32_t brightness = g_render_hdr_brightness[max(values[0], max(values[1], values[2])) >> 8];
+			pixel_out[0] = (uint8_t) (0xE0 | brightness);
+
+			for (int channel=0; channel<3; channel++) {
+				pixel_out[params->channel_offsets[channel]] = render_hdr_pwm((uint32_t) values[channel], brightness);
+			}
+		} else {
+			// APA102 LED frame: 0xFF (full global brightness), then the color channels in output order
+			pixel_out[0] = 255;
+
+			for (int channel=0; channel<3; channel++) {
+				if (dithering_enabled && ordered_enabled) {
+					pixel_out[params->channel_offsets[channel]] = render_dither_ordered(
+						(uint32_t) values[channel],
+						params->dither_thresholds[(pixel_index + channel) % RENDER_DITHER_PATTERN_PIXELS]
+					);
+					continue;
+				}
+
+				pixel_out[params->channel_offsets[channel]] = render_dither_scalar(
+					params,
+					values[channel],
+					&dither->overflow[channel][pixel_index],
+					&dither->last_effect_frame[channel][pixel_index],
+					dithering_enabled
+				);
+			}
+		}
+	}
+}
+
+RENDER_DEFINE_VARIANTS(render_pixels_scalar, render_pixels_scalar_impl)
+
+RENDER_ALWAYS_INLINE void render_pixels_wide_impl(
+	const render_params_t* params,
+	const render_frame_t* previous,
+	const render_frame_t* current,
+	render_dither_t* dither,
+	uint32_t first_pixel,
+	uint32_t pixel_count,
+	uint8_t* pixels_out,
+	const bool interpolation_enabled,
+	const bool lut_enabled,
+	const bool dithering_enabled,
+	const bool hdr_enabled,
+	const bool gain_enabled,
+	const bool cubic_enabled,
+	const bool ordered_enabled
+) {
+	// Nothing to dither at 16 bits
+	(void) dither;
+	(void) dithering_enabled;
+	(void) hdr_enabled;
+	(void) ordered_enabled;
+
+	const uint32_t* lookups[] = {
+		params->red_lookup,
+		params->green_lookup,
+		params->blue_lookup
+	};
+
+	// Only read for cubic interpolation
+	const render_frame_t* before_previous = interpolation_enabled && cubic_enabled ? params->before_previous : current;
+	const render_frame_t* after_current = interpolation_enabled && cubic_enabled ? params->after_current : current;
+
+	for (uint32_t i=0; i<pixel_count; i++) {
+		uint32_t pixel_index = first_pixel + i;
+		uint8_t* pixel_out = &pixels_out[i*RENDER_WIDE_BYTES_PER_LED];
+
+		// HD108 LED frame: 1 and full brightness on all three channels, then the color channels in output order
+		pixel_out[0] = 0xFF;
+		pixel_out[1] = 0xFF;
+
+		for (int channel=0; channel<3; channel++) {
+			uint32_t value = (uint32_t) render_shade_scalar(
+				params,
+				lookups[channel],
+				before_previous->planes[channel][pixel_index],
+				previous->planes[channel][pixel_index],
+				current->planes[channel][pixel_index],
+				after_current->planes[channel][pixel_index],
+				interpolation_enabled,
+				lut_enabled,
+				cubic_enabled
+			);
+			value = min(value, 0xFFFFu);
+
+			// Apply calibration gain
+			if (gain_enabled) {
+				value = render_gain_apply(value, params->gain->gains[channel][pixel_index]);
+			}
+
+			// channel_offsets count 1-byte channels after the brightness byte
+			uint8_t* channel_out = &pixel_out[2 * params->channel_offsets[channel]];
+			channel_out[0] = (uint8_t) (value >> 8);
+			channel_out[1] = (uint8_t) value;
+		}
+	}
+}
+
+RENDER_DEFINE_VARIANTS(render_pixels_wide, render_pixels_wide_impl)
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// HDR Packing
+
+uint8_t g_render_hdr_brightness[256];
+uint16_t g_render_hdr_scale[RENDER_HDR_MAX_BRIGHTNESS + 1];
+
+static pthread_once_t g_render_hdr_once = PTHREAD_ONCE_INIT;
+
+static void render_hdr_build_tables(void) {
+	for (uint32_t high_byte=0; high_byte<256; high_byte++) {
+		// Enough brightness for the largest value with this high byte to stay within 255 at full PWM
+		uint32_t largest_value = (high_byte << 8) | 0xFF;
+		uint32_t brightness = (largest_value * RENDER_HDR_MAX_BRIGHTNESS + 0xFFFE) / 0xFFFF;
+		g_render_hdr_brightness[high_byte] = (uint8_t) max(brightness, 1);
+	}
+
+	g_render_hdr_scale[0] = 0;
+	for (uint32_t brightness=1; brightness<=RENDER_HDR_MAX_BRIGHTNESS; brightness++) {
+		uint32_t divisor = 257 * brightness;
+		g_render_hdr_scale[brightness] = (uint16_t) ((65536 * RENDER_HDR_MAX_BRIGHTNESS + divisor / 2) / divisor);
+	}
+}
+
+void render_hdr_init(void) {
+	pthread_once(&g_render_hdr_once, render_hdr_build_tables);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Ordered Dithering
+
+static uint32_t render_reverse_bits(uint32_t value, uint32_t bits) {
+	uint32_t reversed = 0;
+	for (uint32_t bit=0; bit<bits; bit++) {
+		reversed = (reversed << 1) | ((value >> bit) & 1);
+	}
+	return reversed;
+}
+
+uint32_t render_dither_cycle_frames(uint32_t max_dither_frames) {
+	uint32_t cycle_frames = 1;
+	while (cycle_frames * 2 <= max_dither_frames && cycle_frames < RENDER_DITHER_PATTERN_PIXELS) {
+		cycle_frames *= 2;
+	}
+	return cycle_frames;
+}
+
+void render_params_set_dither_thresholds(render_params_t* params) {
+	uint32_t cycle_frames = render_dither_cycle_frames(params->max_dither_frames);
+	uint32_t cycle_bits = 0;
+	while ((1u << cycle_bits) < cycle_frames) {
+		cycle_bits++;
+	}
+
+	// The cycle divides the 8-bit frame counter's range, so it carries on seamlessly when the counter wraps
+	uint32_t frame = (uint8_t) params->dithering_frame;
+	uint32_t offset_bits = RENDER_DITHER_PATTERN_BITS - cycle_bits;
+
+	// The step of the cycle this frame is on, in bit-reversed order
+	uint32_t step = render_reverse_bits(frame & (cycle_frames - 1), cycle_bits) << offset_bits;
+
+	for (uint32_t pixel=0; pixel<RENDER_DITHER_PATTERN_PIXELS; pixel++) {
+		// Within a frame, thresholds follow a one-dimensional Bayer pattern, so any run of pixels gets thresholds spread
+		// as evenly as its length allows. Flipping the pattern's high bits by the step moves each pixel on through the
+		// cycle without breaking that up, while its low bits stay a fixed offset within the step.
+		uint32_t rank = render_reverse_bits(pixel, RENDER_DITHER_PATTERN_BITS) ^ step;
+
+		// Thresholds average 128 over a cycle, so the output rounds to nearest on average
+		uint8_t threshold = (uint8_t) ((rank << (8 - RENDER_DITHER_PATTERN_BITS)) | 2);
+		params->dither_thresholds[pixel] = threshold;
+		params->dither_thresholds[pixel + RENDER_DITHER_PATTERN_PIXELS] = threshold;
+	}
+}
+
+void render_params_set_channel_order(render_params_t* params, color_channel_order_t color_channel_order) {
+	// Output order of red, green and blue
+	static const uint8_t positions[][3] = {
+		[COLOR_ORDER_RGB] = { 0, 1, 2 },
+		[COLOR_ORDER_RBG] = { 0, 2, 1 },
+		[COLOR_ORDER_GRB] = { 1, 0, 2 },
+		[COLOR_ORDER_GBR] = { 2, 0, 1 },
+		[COLOR_ORDER_BGR] = { 2, 1, 0 },
+		[COLOR_ORDER_BRG] = { 1, 2, 0 }
+	};
+
+	if ((unsigned) color_channel_order >= sizeof(positions) / sizeof(positions[0])) {
+		color_channel_order = COLOR_ORDER_BGR;
+	}
+
+	for (int channel=0; channel<3; channel++) {
+		params->channel_offsets[channel] = (uint8_t) (1 + positions[color_channel_order][channel]);
+	}
+}
+
+void render_params_set_cubic_weights(render_params_t* params) {
+	// Catmull-Rom basis at t, halved: (-t^3 + 2t^2 - t, 3t^3 - 5t^2 + 2, -3t^3 + 4t^2 + t, t^3 - t^2) / 2, from Q16 to
+	// Q14. The previous frame's weight takes up the rounding, so a still scene renders exactly as it is.
+	int64_t t = params->frame_progress16;
+	int64_t t2 = (t * t) >> 16;
+	int64_t t3 = (t2 * t) >> 16;
+
+	params->cubic_weights[0] = (int16_t) ((-t3 + 2*t2 - t + 4) >> 3);
+	params->cubic_weights[2] = (int16_t) ((-3*t3 + 4*t2 + t + 4) >> 3);
+	params->cubic_weights[3] = (int16_t) ((t3 - t2 + 4) >> 3);
+	params->cubic_weights[1] = (int16_t) (16384 - params->cubic_weights[0] - params->cubic_weights[2] - params->cubic_weights[3]);
+}
+
+void render_params_set_extrapolation_weights(render_params_t* params, int32_t extrapolation14) {
+	params->cubic_weights[0] = 0;
+	params->cubic_weights[1] = (int16_t) -extrapolation14;
+	params->cubic_weights[2] = (int16_t) (16384 + extrapolation14);
+	params->cubic_weights[3] = 0;
+}
+
+void render_led_frames_to_rgb(
+	const render_params_t* params,
+	const uint8_t* led_frames,
+	uint32_t pixel_count,
+	bool wide,
+	uint8_t* rgb_out
+) {
+	for (uint32_t i=0; i<pixel_count; i++) {
+		uint8_t* pixel_rgb = &rgb_out[i*3];
+
+		if (wide) {
+			const uint8_t* led_frame = &led_frames[i*RENDER_WIDE_BYTES_PER_LED];
+
+			for (int channel=0; channel<3; channel++) {
+				const uint8_t* channel_in = &led_frame[2 * params->channel_offsets[channel]];
+				uint32_t value = ((uint32_t) channel_in[0] << 8) | channel_in[1];
+				pixel_rgb[channel] = (uint8_t) ((value * 255 + 0x7FFF) / 0xFFFF);
+			}
+		} else {
+			const uint8_t* led_frame = &led_frames[i*4];
+			uint32_t brightness = led_frame[0] & RENDER_HDR_MAX_BRIGHTNESS;
+
+			for (int channel=0; channel<3; channel++) {
+				uint32_t pwm = led_frame[params->channel_offsets[channel]];
+				pixel_rgb[channel] = (uint8_t) ((pwm * brightness + RENDER_HDR_MAX_BRIGHTNESS / 2) / RENDER_HDR_MAX_BRIGHTNESS);
+			}
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Frame and Dithering Buffers
+
+static size_t render_plane_stride(uint32_t pixel_count, size_t element_size) {
+	size_t plane_size = max((size_t) pixel_count * element_size, 1);
+	return (plane_size + RENDER_CACHE_LINE_BYTES - 1) / RENDER_CACHE_LINE_BYTES * RENDER_CACHE_LINE_BYTES;
+}
+
+bool render_frame_alloc(render_frame_t* frame, uint32_t pixel_count) {
+	size_t stride = render_plane_stride(pixel_count, sizeof(uint8_t));
+	uint8_t* data = NULL;
+
+	if (posix_memalign((void**) &data, RENDER_CACHE_LINE_BYTES, stride * 3) != 0) {
+		return false;
+	}
+
+	memset(data, 0, stride * 3);
+
+	for (int channel=0; channel<3; channel++) {
+		frame->planes[channel] = data + channel * stride;
+	}
+
+	frame->pixel_count = pixel_count;
+	return true;
+}
+
+void render_frame_free(render_frame_t* frame) {
+	free(frame->planes[0]);
+
+	for (int channel=0; channel<3; channel++) {
+		frame->planes[channel] = NULL;
+	}
+
+	frame->pixel_count = 0;
+}
+
+void render_frame_set_rgb(render_frame_t* frame, const uint8_t* rgb_data, uint32_t data_size) {
+	for (uint32_t channel=0; channel<3; channel++) {
+		uint8_t* plane = frame->planes[channel];
+		uint32_t pixel_index = 0;
+
+		for (; pixel_index < frame->pixel_count && pixel_index*3 + channel < data_size; pixel_index++) {
+			plane[pixel_index] = rgb_data[pixel_index*3 + channel];
+		}
+
+		// Zero out any pixels not set by the new frame
+		memset(plane + pixel_index, 0, frame->pixel_count - pixel_index);
+	}
+}
+
+bool render_dither_alloc(render_dither_t* dither, uint32_t pixel_count) {
+	size_t overflow_stride = render_plane_stride(pixel_count, sizeof(int16_t));
+	size_t last_effect_stride = render_plane_stride(pixel_count, sizeof(int8_t));
+	size_t size = (overflow_stride + last_effect_stride) * 3;
+	uint8_t* data = NULL;
+
+	if (posix_memalign((void**) &data, RENDER_CACHE_LINE_BYTES, size) != 0) {
+		return false;
+	}
+
+	memset(data, 0, size);
+
+	for (int channel=0; channel<3; channel++) {
+		dither->overflow[channel] = (int16_t*) (data + channel * overflow_stride);
+		dither->last_effect_frame[channel] = (int8_t*) (data + 3 * overflow_stride + channel * last_effect_stride);
+	}
+
+	dither->pixel_count = pixel_count;
+	return true;
+}
+
+void render_dither_free(render_dither_t* dither) {
+	free(dither->overflow[0]);
+
+	for (int channel=0; channel<3; channel++) {
+		dither->overflow[channel] = NULL;
+		dither->last_effect_frame[channel] = NULL;
+	}
+
+	dither->pixel_count = 0;
+}
+
+bool render_gain_alloc(render_gain_t* gain, uint32_t pixel_count) {
+	size_t stride = render_plane_stride(pixel_count, sizeof(uint16_t));
+	uint8_t* data = NULL;
+
+	if (posix_memalign((void**) &data, RENDER_CACHE_LINE_BYTES, stride * 3) != 0) {
+		return false;
+	}
+
+	for (int channel=0; channel<3; channel++) {
+		gain->gains[channel] = (uint16_t*) (data + channel * stride);
+
+		for (uint32_t i=0; i<pixel_count; i++) {
+			gain->gains[channel][i] = RENDER_GAIN_UNITY;
+		}
+	}
+
+	gain->pixel_count = pixel_count;
+	return true;
+}
+
+void render_gain_free(render_gain_t* gain) {
+	free(gain->gains[0]);
+
+	for (int channel=0; channel<3; channel++) {
+		gain->gains[channel] = NULL;
+	}
+
+	gain->pixel_count = 0;
+}
+
+bool render_gain_load(render_gain_t* gain, const char* path) {
+	FILE* file = fopen(path, "rb");
+	if (file == NULL) {
+		fprintf(stderr, "[render] Can't open calibration file %s: %s\n", path, strerror(errno));
+		return false;
+	}
+
+	render_gain_file_header_t header;
+	if (fread(&header, sizeof(header), 1, file) != 1 || le32toh(header.magic) != RENDER_GAIN_FILE_MAGIC) {
+		fprintf(stderr, "[render] %s is not a calibration file\n", path);
+		fclose(file);
+		return false;
+	}
+
+	uint32_t file_pixel_count = le32toh(header.pixel_count);
+	uint32_t pixel_count = min(file_pixel_count, gain->pixel_count);
+
+	for (uint32_t i=0; i<pixel_count; i++) {
+		uint16_t rgb[3];
+		if (fread(rgb, sizeof(rgb), 1, file) != 1) {
+			fprintf(stderr, "[render] Calibration file %s ends after %u of %u pixels\n", path, i, file_pixel_count);
+			fclose(file);
+			return false;
+		}
+
+		for (int channel=0; channel<3; channel++) {
+			gain->gains[channel][i] = le16toh(rgb[channel]);
+		}
+	}
+
+	fclose(file);
+
+	for (int channel=0; channel<3; channel++) {
+		for (uint32_t i=pixel_count; i<gain->pixel_count; i++) {
+			gain->gains[channel][i] = RENDER_GAIN_UNITY;
+		}
+	}
+
+	if (file_pixel_count != gain->pixel_count) {
+		fprintf(stderr, "[render] Calibration file %s has gains for %u pixels, using them for %u of %u pixels\n",
+			path, file_pixel_count, pixel_count, gain->pixel_count);
+	}
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Kernel Selection
+
+static bool render_cpu_supports_scalar(void) {
+	return true;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+static bool render_cpu_supports_sse2(void) {
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("sse2");
+}
+
+static bool render_cpu_supports_avx2(void) {
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2");
+}
+#endif
+
+#if defined(__arm__) || defined(__aarch64__)
+static bool render_cpu_supports_neon(void) {
+#if defined(__aarch64__)
+	// Advanced SIMD is mandatory on ARMv8
+	return true;
+#else
+	return (getauxval(AT_HWCAP) & HWCAP_NEON) != 0;
+#endif
+}
+#endif
+
+// Ordered from most to least preferred
+static const render_kernel_t g_render_kernels[] = {
+#if defined(__x86_64__) || defined(__i386__)
+	{ "avx2", render_pixels_avx2_variants, render_cpu_supports_avx2 },
+	{ "sse2", render_pixels_sse2_variants, render_cpu_supports_sse2 },
+#endif
+#if defined(__arm__) || defined(__aarch64__)
+	{ "neon", render_pixels_neon_variants, render_cpu_supports_neon },
+#endif
+	{ "scalar", render_pixels_scalar_variants, render_cpu_supports_scalar }
+};
+
+static const size_t g_render_kernel_count = sizeof(g_render_kernels) / sizeof(g_render_kernels[0]);
+
+const render_kernel_t g_render_wide_kernel = { "wide", render_pixels_wide_variants, render_cpu_supports_scalar };
+
+const render_kernel_t* render_kernel_by_name(const char* name) {
+	for (size_t i=0; i<g_render_kernel_count; i++) {
+		if (strcasecmp(g_render_kernels[i].name, name) == 0) {
+			return &g_render_kernels[i];
+		}
+	}
+
+	return NULL;
+}
+
+/**
+ * Verifies a kernel over RENDER_VERIFY_STARTUP_FRAMES frames, logging how long that took.
+ */
+static bool render_kernel_verify_at_startup(const render_kernel_t* kernel) {
+	struct timeval start_tv, stop_tv;
+
+	monotonic_time(&start_tv);
+	bool passed = render_kernel_verify(kernel, RENDER_VERIFY_STARTUP_FRAMES);
+	monotonic_time(&stop_tv);
+
+	if (kernel->variants != render_pixels_scalar_variants) {
+		printf("[render] Verified render kernel %s in %.1f ms\n",
+			kernel->name,
+			(stop_tv.tv_sec - start_tv.tv_sec) * 1000.0 + (stop_tv.tv_usec - start_tv.tv_usec) / 1000.0
+		);
+	}
+
+	return passed;
+}
+
+const render_kernel_t* render_kernel_select(const char* name) {
+	render_hdr_init();
+
+	if (name != NULL && strlen(name) > 0 && strcasecmp(name, "auto") != 0) {
+		const render_kernel_t* requested = render_kernel_by_name(name);
+
+		if (requested == NULL) {
+			fprintf(stderr, "[render] Unknown render kernel %s; selecting automatically\n", name);
+		} else if (! requested->is_supported()) {
+			fprintf(stderr, "[render] Render kernel %s is not supported by this CPU; selecting automatically\n", name);
+		} else if (! render_kernel_verify_at_startup(requested)) {
+			fprintf(stderr, "[render] Render kernel %s failed verification; selecting automatically\n", name);
+		} else {
+			return requested;
+		}
+	}
+
+	for (size_t i=0; i<g_render_kernel_count; i++) {
+		const render_kernel_t* kernel = &g_render_kernels[i];
+
+		if (kernel->is_supported()) {
+			if (render_kernel_verify_at_startup(kernel)) {
+				return kernel;
+			}
+
+			fprintf(stderr, "[render] Render kernel %s failed verification; skipping\n", kernel->name);
+		}
+	}
+
+	// The scalar kernel is always supported and is its own reference
+	return &g_render_kernels[g_render_kernel_count - 1];
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Kernel Verification
+
+static inline uint32_t render_verify_random(uint32_t* state) {
+	// xorshift32
+	uint32_t x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return *state = x;
+}
+
+static void render_verify_fill(uint32_t* state, void* buffer, size_t length) {
+	uint8_t* bytes = buffer;
+	for (size_t i=0; i<length; i++) {
+		bytes[i] = (uint8_t) render_verify_random(state);
+	}
+}
+
+static void render_verify_fill_dither(uint32_t* state, render_dither_t* dither) {
+	for (int channel=0; channel<3; channel++) {
+		for (uint32_t i=0; i<dither->pixel_count; i++) {
+			// Any overflow a kernel can leave behind: [-0x17F, 0x7F]
+			dither->overflow[channel][i] = (int16_t) (render_verify_random(state) % 0x1FF) - 0x17F;
+			dither->last_effect_frame[channel][i] = (int8_t) render_verify_random(state);
+		}
+	}
+}
+
+static void render_dither_copy(render_dither_t* dest, const render_dither_t* src) {
+	for (int channel=0; channel<3; channel++) {
+		memcpy(dest->overflow[channel], src->overflow[channel], src->pixel_count * sizeof(int16_t));
+		memcpy(dest->last_effect_frame[channel], src->last_effect_frame[channel], src->pixel_count * sizeof(int8_t));
+	}
+}
+
+static bool render_dither_equal(const render_dither_t* a, const render_dither_t* b) {
+	for (int channel=0; channel<3; channel++) {
+		if (memcmp(a->overflow[channel], b->overflow[channel], a->pixel_count * sizeof(int16_t)) != 0
+			|| memcmp(a->last_effect_frame[channel], b->last_effect_frame[channel], a->pixel_count * sizeof(int8_t)) != 0
+		) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool render_kernel_verify(const render_kernel_t* kernel, uint32_t frame_count) {
+	if (kernel->variants == render_pixels_scalar_variants) {
+		return true;
+	}
+
+	render_hdr_init();
+
+	// Not a multiple of any kernel's block size, so the partial block at the end is covered as well
+	const uint32_t pixel_count = 1021;
+
+	// Rendered in two ranges, the second one starting in the middle of a block
+	const uint32_t split_pixel = 509;
+
+	static const uint32_t max_dither_frames[] = { 0, 1, 3, 8, 127, 128, 100000 };
+
+	uint32_t lookup[3][257];
+	render_frame_t before_previous = { .pixel_count = 0 }, previous = { .pixel_count = 0 };
+	render_frame_t current = { .pixel_count = 0 }, after_current = { .pixel_count = 0 };
+	render_dither_t expected_dither = { .pixel_count = 0 }, actual_dither = { .pixel_count = 0 };
+	render_gain_t gain = { .pixel_count = 0 };
+	uint8_t* expected_out = malloc(pixel_count * 4);
+	uint8_t* actual_out = malloc(pixel_count * 4);
+
+	uint32_t random_state = 0x1ED5B1;
+	const render_kernel_t* reference = &g_render_kernels[g_render_kernel_count - 1];
+	bool passed = expected_out != NULL
+		&& actual_out != NULL
+		&& render_frame_alloc(&previous, pixel_count)
+		&& render_frame_alloc(&current, pixel_count)
+		&& render_frame_alloc(&before_previous, pixel_count)
+		&& render_frame_alloc(&after_current, pixel_count)
+		&& render_dither_alloc(&expected_dither, pixel_count)
+		&& render_dither_alloc(&actual_dither, pixel_count)
+		&& render_gain_alloc(&gain, pixel_count);
+
+	if (! passed) {
+		fprintf(stderr, "[render] Failed to allocate buffers to verify kernel %s\n", kernel->name);
+	}
+
+	for (uint32_t options=0; options<RENDER_VARIANT_COUNT && passed; options++) {
+		// Cubic interpolation is only ever selected together with interpolation, and ordered dithering with dithering
+		if (((options & RENDER_VARIANT_CUBIC) != 0 && (options & RENDER_VARIANT_INTERPOLATION) == 0)
+			|| ((options & RENDER_VARIANT_ORDERED) != 0 && (options & RENDER_VARIANT_DITHERING) == 0)
+		) {
+			continue;
+		}
+
+		// Arbitrary lookup tables, including the extreme values
+		render_verify_fill(&random_state, lookup, sizeof(lookup));
+		for (int c=0; c<3; c++) {
+			for (int i=0; i<257; i++) {
+				lookup[c][i] &= 0xFFFF;
+			}
+			lookup[c][256] = 0xFFFF;
+		}
+
+		for (int channel=0; channel<3; channel++) {
+			render_verify_fill(&random_state, before_previous.planes[channel], pixel_count);
+			render_verify_fill(&random_state, previous.planes[channel], pixel_count);
+			render_verify_fill(&random_state, current.planes[channel], pixel_count);
+			render_verify_fill(&random_state, after_current.planes[channel], pixel_count);
+		}
+
+		// Arbitrary gains, including the extreme values
+		for (int channel=0; channel<3; channel++) {
+			render_verify_fill(&random_state, gain.gains[channel], pixel_count * sizeof(uint16_t));
+			gain.gains[channel][0] = 0;
+			gain.gains[channel][1] = RENDER_GAIN_UNITY;
+			gain.gains[channel][2] = 0xFFFF;
+		}
+
+		render_verify_fill_dither(&random_state, &expected_dither);
+		render_dither_copy(&actual_dither, &expected_dither);
+
+		for (uint32_t frame=0; frame<frame_count && passed; frame++) {
+			// Swap in new frame data every so often, like the network threads would
+			if (frame % 17 == 0) {
+				render_frame_t temp = before_previous;
+				before_previous = previous;
+				previous = current;
+				current = after_current;
+				after_current = temp;
+
+				for (int channel=0; channel<3; channel++) {
+					render_verify_fill(&random_state, after_current.planes[channel], pixel_count);
+				}
+			}
+
+			uint16_t frame_progress16 = (uint16_t) render_verify_random(&random_state);
+			if (frame % 5 == 0) frame_progress16 = 0;
+			if (frame % 7 == 0) frame_progress16 = 0xFFFF;
+
+			render_params_t params = {
+				.frame_progress16 = frame_progress16,
+				.inv_frame_progress16 = (uint16_t) (0xFFFF - frame_progress16),
+				.dithering_frame = (int8_t) frame,
+				.max_dither_frames = max_dither_frames[frame % (sizeof(max_dither_frames) / sizeof(max_dither_frames[0]))],
+				.interpolation_enabled = (options & RENDER_VARIANT_INTERPOLATION) != 0,
+				.lut_enabled = (options & RENDER_VARIANT_LUT) != 0,
+				.dithering_enabled = (options & RENDER_VARIANT_DITHERING) != 0,
+				.hdr_enabled = (options & RENDER_VARIANT_HDR) != 0,
+				.gain_enabled = (options & RENDER_VARIANT_GAIN) != 0,
+				.gain = &gain,
+				.cubic_enabled = (options & RENDER_VARIANT_CUBIC) != 0,
+				.ordered_dithering_enabled = (options & RENDER_VARIANT_ORDERED) != 0,
+				.before_previous = &before_previous,
+				.after_current = &after_current,
+				.red_lookup = lookup[0],
+				.green_lookup = lookup[1],
+				.blue_lookup = lookup[2]
+			};
+			render_params_set_channel_order(&params, (color_channel_order_t) (frame % 6));
+			render_params_set_cubic_weights(&params);
+			render_params_set_dither_thresholds(&params);
+
+			render_pixels_fn expected_render_pixels = render_kernel_variant(reference, &params);
+			render_pixels_fn actual_render_pixels = render_kernel_variant(kernel, &params);
+
+			expected_render_pixels(&params, &previous, &current, &expected_dither, 0, pixel_count, expected_out);
+			actual_render_pixels(&params, &previous, &current, &actual_dither, 0, split_pixel, actual_out);
+			actual_render_pixels(&params, &previous, &current, &actual_dither, split_pixel, pixel_count - split_pixel, actual_out + split_pixel*4);
+
+			if (memcmp(expected_out, actual_out, pixel_count * 4) != 0
+				|| ! render_dither_equal(&expected_dither, &actual_dither)
+			) {
+				fprintf(stderr,
+					"[render] Kernel %s does not match scalar output (interpolation=%d, lut=%d, dithering=%d, hdr=%d, gain=%d, cubic=%d, ordered=%d, frame=%u)\n",
+					kernel->name,
+					params.interpolation_enabled,
+					params.lut_enabled,
+					params.dithering_enabled,
+					params.hdr_enabled,
+					params.gain_enabled,
+					params.cubic_enabled,
+					params.ordered_dithering_enabled,
+					frame
+				);
+				passed = false;
+			}
+		}
+	}
+
+	render_frame_free(&previous);
+	render_frame_free(&current);
+	render_frame_free(&before_previous);
+	render_frame_free(&after_current);
+	render_dither_free(&expected_dither);
+	render_dither_free(&actual_dither);
+	render_gain_free(&gain);
+	free(expected_out);
+	free(actual_out);
+
+	return passed;
+}
@@ -0,0 +1,544 @@
+/** \file
+ * Pixel render kernels: interpolation, luminance lookup, dithering and APA102 packing.
+ *
+ * Frames and dithering state are stored as planes, one contiguous and cache-line aligned array per color channel, so
+ * that kernels read each channel with unit stride and every lane of a vector register holds a different pixel.
+ *
+ * Every kernel is compiled once per combination of interpolation (linear or cubic), LUT, dithering (error diffusion or
+ * ordered), HDR and calibration gain, with the options as constants so that no instance tests them per pixel. The
+ * instance matching a frame's options is looked up once per frame with render_kernel_variant().
+ *
+ * The scalar kernel is the reference implementation; vectorized kernels must produce bit-identical output and
+ * dithering state for the same inputs, and are only selected after verifying that against the scalar kernel.
+ */
+#ifndef SPISCAPE_RENDER_H
+#define SPISCAPE_RENDER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "util.h"
+
+#define RENDER_CACHE_LINE_BYTES 64
+
+// Pixels after which the ordered dithering pattern repeats
+#define RENDER_DITHER_PATTERN_BITS 6
+#define RENDER_DITHER_PATTERN_PIXELS (1 << RENDER_DITHER_PATTERN_BITS)
+
+/**
+ * One frame of 8-bit pixel data; planes[0..2] hold red, green and blue.
+ */
+typedef struct {
+	uint8_t* planes[3];
+	uint32_t pixel_count;
+} render_frame_t;
+
+/**
+ * Per-pixel, per-channel dithering state.
+ *
+ * overflow holds the 16-bit error left over from rounding the previous output, in the range [-0x17F, 0x7F].
+ * last_effect_frame holds the dithering frame on which dithering last changed the output.
+ */
+typedef struct {
+	int16_t* overflow[3];
+	int8_t* last_effect_frame[3];
+	uint32_t pixel_count;
+} render_dither_t;
+
+/**
+ * Per-pixel, per-channel calibration gain, applied after the LUT. Gains are unsigned Q1.15 fixed point:
+ * RENDER_GAIN_UNITY leaves a channel as it is, and results above 0xFFFF saturate.
+ */
+typedef struct {
+	uint16_t* gains[3];
+	uint32_t pixel_count;
+} render_gain_t;
+
+#define RENDER_GAIN_UNITY 0x8000
+
+// Calibration files: this header, then pixel_count little-endian red, green and blue gains per pixel
+#define RENDER_GAIN_FILE_MAGIC 0x4E41474C /* "LGAN" */
+
+typedef struct {
+	uint32_t magic;
+	uint32_t pixel_count;
+} render_gain_file_header_t;
+
+/**
+ * Per-frame render parameters, shared by all pixels of a frame.
+ */
+typedef struct {
+	uint16_t frame_progress16;
+	uint16_t inv_frame_progress16;
+
+	int8_t dithering_frame;
+	uint32_t max_dither_frames;
+
+	bool interpolation_enabled;
+	bool dithering_enabled;
+	bool lut_enabled;
+
+	// Dither against dither_thresholds instead of diffusing each pixel's rounding error into its next frame, leaving
+	// the dithering state untouched; see render_params_set_dither_thresholds(). Needs dithering_enabled.
+	bool ordered_dithering_enabled;
+
+	// Threshold added to each channel before truncating it to 8 bits, indexed by pixel index plus channel modulo
+	// RENDER_DITHER_PATTERN_PIXELS; repeated once so a block can be loaded from any index without wrapping
+	uint8_t dither_thresholds[RENDER_DITHER_PATTERN_PIXELS * 2];
+
+	// Interpolate along a Catmull-Rom spline through before_previous, previous, current and after_current instead of
+	// blending previous and current linearly; see render_params_set_cubic_weights(). Needs interpolation_enabled.
+	bool cubic_enabled;
+	const render_frame_t* before_previous;
+	const render_frame_t* after_current;
+
+	// Signed Q2.14 weights of the four frames at frame_progress16, adding up to 1
+	int16_t cubic_weights[4];
+
+	// Use the 5-bit global brightness field for extra resolution instead of dithering; see render_hdr_pwm()
+	bool hdr_enabled;
+
+	// Scale every channel of every pixel by its gain in gain
+	bool gain_enabled;
+	const render_gain_t* gain;
+
+	const uint32_t* red_lookup;
+	const uint32_t* green_lookup;
+	const uint32_t* blue_lookup;
+
+	// Byte offset of red, green and blue within each 4-byte LED frame; see render_params_set_channel_order()
+	uint8_t channel_offsets[3];
+} render_params_t;
+
+/**
+ * Renders pixel_count pixels starting at first_pixel into 4-byte APA102 LED frames at pixels_out, updating the
+ * dithering state for those pixels.
+ */
+typedef void (*render_pixels_fn)(
+	const render_params_t* params,
+	const render_frame_t* previous,
+	const render_frame_t* current,
+	render_dither_t* dither,
+	uint32_t first_pixel,
+	uint32_t pixel_count,
+	uint8_t* pixels_out
+);
+
+// Bits of a kernel variant index
+#define RENDER_VARIANT_INTERPOLATION (1 << 0)
+#define RENDER_VARIANT_LUT (1 << 1)
+#define RENDER_VARIANT_DITHERING (1 << 2)
+#define RENDER_VARIANT_HDR (1 << 3)
+#define RENDER_VARIANT_GAIN (1 << 4)
+#define RENDER_VARIANT_CUBIC (1 << 5)
+#define RENDER_VARIANT_ORDERED (1 << 6)
+#define RENDER_VARIANT_COUNT 128
+
+#define RENDER_VARIANT_INDEX(interpolation, lut, dithering, hdr, gain, cubic, ordered) \
+	(((interpolation) ? RENDER_VARIANT_INTERPOLATION : 0) \
+	| ((lut) ? RENDER_VARIANT_LUT : 0) \
+	| ((dithering) ? RENDER_VARIANT_DITHERING : 0) \
+	| ((hdr) ? RENDER_VARIANT_HDR : 0) \
+	| ((gain) ? RENDER_VARIANT_GAIN : 0) \
+	| ((interpolation) && (cubic) ? RENDER_VARIANT_CUBIC : 0) \
+	| ((dithering) && (ordered) ? RENDER_VARIANT_ORDERED : 0))
+
+typedef struct {
+	const char* name;
+
+	// One instance per combination of render options, indexed by RENDER_VARIANT_INDEX()
+	const render_pixels_fn* variants;
+
+	bool (*is_supported)(void);
+} render_kernel_t;
+
+extern const render_pixels_fn render_pixels_scalar_variants[RENDER_VARIANT_COUNT];
+extern const render_pixels_fn render_pixels_wide_variants[RENDER_VARIANT_COUNT];
+
+#if defined(__x86_64__) || defined(__i386__)
+extern const render_pixels_fn render_pixels_sse2_variants[RENDER_VARIANT_COUNT];
+extern const render_pixels_fn render_pixels_avx2_variants[RENDER_VARIANT_COUNT];
+#endif
+
+#if defined(__arm__) || defined(__aarch64__)
+extern const render_pixels_fn render_pixels_neon_variants[RENDER_VARIANT_COUNT];
+#endif
+
+/**
+ * Returns the instance of the kernel specialized for the options in params.
+ */
+static inline render_pixels_fn render_kernel_variant(const render_kernel_t* kernel, const render_params_t* params) {
+	return kernel->variants[RENDER_VARIANT_INDEX(
+		params->interpolation_enabled,
+		params->lut_enabled,
+		params->dithering_enabled,
+		params->hdr_enabled,
+		params->gain_enabled,
+		params->cubic_enabled,
+		params->ordered_dithering_enabled
+	)];
+}
+
+/**
+ * Defines name_variants[], instantiating impl once per combination of render options. impl takes the render_pixels_fn
+ * arguments followed by the interpolation, LUT, dithering, HDR, gain, cubic interpolation and ordered dithering
+ * options, and must be always inlined so that each instance is compiled with the options as constants. Cubic
+ * interpolation is only set together with interpolation, and ordered dithering together with dithering.
+ */
+#define RENDER_DEFINE_VARIANT(name, impl, index) \
+	static void name##_##index( \
+		const render_params_t* params, \
+		const render_frame_t* previous, \
+		const render_frame_t* current, \
+		render_dither_t* dither, \
+		uint32_t first_pixel, \
+		uint32_t pixel_count, \
+		uint8_t* pixels_out \
+	) { \
+		impl(params, previous, current, dither, first_pixel, pixel_count, pixels_out, \
+			((index) & RENDER_VARIANT_INTERPOLATION) != 0, \
+			((index) & RENDER_VARIANT_LUT) != 0, \
+			((index) & RENDER_VARIANT_DITHERING) != 0, \
+			((index) & RENDER_VARIANT_HDR) != 0, \
+			((index) & RENDER_VARIANT_GAIN) != 0, \
+			((index) & RENDER_VARIANT_CUBIC) != 0, \
+			((index) & RENDER_VARIANT_ORDERED) != 0 \
+		); \
+	}
+
+#define RENDER_DEFINE_VARIANTS(name, impl) \
+	RENDER_DEFINE_VARIANT(name, impl, 0) \
+	RENDER_DEFINE_VARIANT(name, impl, 1) \
+	RENDER_DEFINE_VARIANT(name, impl, 2) \
+	RENDER_DEFINE_VARIANT(name, impl, 3) \
+	RENDER_DEFINE_VARIANT(name, impl, 4) \
+	RENDER_DEFINE_VARIANT(name, impl, 5) \
+	RENDER_DEFINE_VARIANT(name, impl, 6) \
+	RENDER_DEFINE_VARIANT(name, impl, 7) \
+	RENDER_DEFINE_VARIANT(name, impl, 8) \
+	RENDER_DEFINE_VARIANT(name, impl, 9) \
+	RENDER_DEFINE_VARIANT(name, impl, 10) \
+	RENDER_DEFINE_VARIANT(name, impl, 11) \
+	RENDER_DEFINE_VARIANT(name, impl, 12) \
+	RENDER_DEFINE_VARIANT(name, impl, 13) \
+	RENDER_DEFINE_VARIANT(name, impl, 14) \
+	RENDER_DEFINE_VARIANT(name, impl, 15) \
+	RENDER_DEFINE_VARIANT(name, impl, 16) \
+	RENDER_DEFINE_VARIANT(name, impl, 17) \
+	RENDER_DEFINE_VARIANT(name, impl, 18) \
+	RENDER_DEFINE_VARIANT(name, impl, 19) \
+	RENDER_DEFINE_VARIANT(name, impl, 20) \
+	RENDER_DEFINE_VARIANT(name, impl, 21) \
+	RENDER_DEFINE_VARIANT(name, impl, 22) \
+	RENDER_DEFINE_VARIANT(name, impl, 23) \
+	RENDER_DEFINE_VARIANT(name, impl, 24) \
+	RENDER_DEFINE_VARIANT(name, impl, 25) \
+	RENDER_DEFINE_VARIANT(name, impl, 26) \
+	RENDER_DEFINE_VARIANT(name, impl, 27) \
+	RENDER_DEFINE_VARIANT(name, impl, 28) \
+	RENDER_DEFINE_VARIANT(name, impl, 29) \
+	RENDER_DEFINE_VARIANT(name, impl, 30) \
+	RENDER_DEFINE_VARIANT(name, impl, 31) \
+	RENDER_DEFINE_VARIANT(name, impl, 32) \
+	RENDER_DEFINE_VARIANT(name, impl, 33) \
+	RENDER_DEFINE_VARIANT(name, impl, 34) \
+	RENDER_DEFINE_VARIANT(name, impl, 35) \
+	RENDER_DEFINE_VARIANT(name, impl, 36) \
+	RENDER_DEFINE_VARIANT(name, impl, 37) \
+	RENDER_DEFINE_VARIANT(name, impl, 38) \
+	RENDER_DEFINE_VARIANT(name, impl, 39) \
+	RENDER_DEFINE_VARIANT(name, impl, 40) \
+	RENDER_DEFINE_VARIANT(name, impl, 41) \
+	RENDER_DEFINE_VARIANT(name, impl, 42) \
+	RENDER_DEFINE_VARIANT(name, impl, 43) \
+	RENDER_DEFINE_VARIANT(name, impl, 44) \
+	RENDER_DEFINE_VARIANT(name, impl, 45) \
+	RENDER_DEFINE_VARIANT(name, impl, 46) \
+	RENDER_DEFINE_VARIANT(name, impl, 47) \
+	RENDER_DEFINE_VARIANT(name, impl, 48) \
+	RENDER_DEFINE_VARIANT(name, impl, 49) \
+	RENDER_DEFINE_VARIANT(name, impl, 50) \
+	RENDER_DEFINE_VARIANT(name, impl, 51) \
+	RENDER_DEFINE_VARIANT(name, impl, 52) \
+	RENDER_DEFINE_VARIANT(name, impl, 53) \
+	RENDER_DEFINE_VARIANT(name, impl, 54) \
+	RENDER_DEFINE_VARIANT(name, impl, 55) \
+	RENDER_DEFINE_VARIANT(name, impl, 56) \
+	RENDER_DEFINE_VARIANT(name, impl, 57) \
+	RENDER_DEFINE_VARIANT(name, impl, 58) \
+	RENDER_DEFINE_VARIANT(name, impl, 59) \
+	RENDER_DEFINE_VARIANT(name, impl, 60) \
+	RENDER_DEFINE_VARIANT(name, impl, 61) \
+	RENDER_DEFINE_VARIANT(name, impl, 62) \
+	RENDER_DEFINE_VARIANT(name, impl, 63) \
+	RENDER_DEFINE_VARIANT(name, impl, 64) \
+	RENDER_DEFINE_VARIANT(name, impl, 65) \
+	RENDER_DEFINE_VARIANT(name, impl, 66) \
+	RENDER_DEFINE_VARIANT(name, impl, 67) \
+	RENDER_DEFINE_VARIANT(name, impl, 68) \
+	RENDER_DEFINE_VARIANT(name, impl, 69) \
+	RENDER_DEFINE_VARIANT(name, impl, 70) \
+	RENDER_DEFINE_VARIANT(name, impl, 71) \
+	RENDER_DEFINE_VARIANT(name, impl, 72) \
+	RENDER_DEFINE_VARIANT(name, impl, 73) \
+	RENDER_DEFINE_VARIANT(name, impl, 74) \
+	RENDER_DEFINE_VARIANT(name, impl, 75) \
+	RENDER_DEFINE_VARIANT(name, impl, 76) \
+	RENDER_DEFINE_VARIANT(name, impl, 77) \
+	RENDER_DEFINE_VARIANT(name, impl, 78) \
+	RENDER_DEFINE_VARIANT(name, impl, 79) \
+	RENDER_DEFINE_VARIANT(name, impl, 80) \
+	RENDER_DEFINE_VARIANT(name, impl, 81) \
+	RENDER_DEFINE_VARIANT(name, impl, 82) \
+	RENDER_DEFINE_VARIANT(name, impl, 83) \
+	RENDER_DEFINE_VARIANT(name, impl, 84) \
+	RENDER_DEFINE_VARIANT(name, impl, 85) \
+	RENDER_DEFINE_VARIANT(name, impl, 86) \
+	RENDER_DEFINE_VARIANT(name, impl, 87) \
+	RENDER_DEFINE_VARIANT(name, impl, 88) \
+	RENDER_DEFINE_VARIANT(name, impl, 89) \
+	RENDER_DEFINE_VARIANT(name, impl, 90) \
+	RENDER_DEFINE_VARIANT(name, impl, 91) \
+	RENDER_DEFINE_VARIANT(name, impl, 92) \
+	RENDER_DEFINE_VARIANT(name, impl, 93) \
+	RENDER_DEFINE_VARIANT(name, impl, 94) \
+	RENDER_DEFINE_VARIANT(name, impl, 95) \
+	RENDER_DEFINE_VARIANT(name, impl, 96) \
+	RENDER_DEFINE_VARIANT(name, impl, 97) \
+	RENDER_DEFINE_VARIANT(name, impl, 98) \
+	RENDER_DEFINE_VARIANT(name, impl, 99) \
+	RENDER_DEFINE_VARIANT(name, impl, 100) \
+	RENDER_DEFINE_VARIANT(name, impl, 101) \
+	RENDER_DEFINE_VARIANT(name, impl, 102) \
+	RENDER_DEFINE_VARIANT(name, impl, 103) \
+	RENDER_DEFINE_VARIANT(name, impl, 104) \
+	RENDER_DEFINE_VARIANT(name, impl, 105) \
+	RENDER_DEFINE_VARIANT(name, impl, 106) \
+	RENDER_DEFINE_VARIANT(name, impl, 107) \
+	RENDER_DEFINE_VARIANT(name, impl, 108) \
+	RENDER_DEFINE_VARIANT(name, impl, 109) \
+	RENDER_DEFINE_VARIANT(name, impl, 110) \
+	RENDER_DEFINE_VARIANT(name, impl, 111) \
+	RENDER_DEFINE_VARIANT(name, impl, 112) \
+	RENDER_DEFINE_VARIANT(name, impl, 113) \
+	RENDER_DEFINE_VARIANT(name, impl, 114) \
+	RENDER_DEFINE_VARIANT(name, impl, 115) \
+	RENDER_DEFINE_VARIANT(name, impl, 116) \
+	RENDER_DEFINE_VARIANT(name, impl, 117) \
+	RENDER_DEFINE_VARIANT(name, impl, 118) \
+	RENDER_DEFINE_VARIANT(name, impl, 119) \
+	RENDER_DEFINE_VARIANT(name, impl, 120) \
+	RENDER_DEFINE_VARIANT(name, impl, 121) \
+	RENDER_DEFINE_VARIANT(name, impl, 122) \
+	RENDER_DEFINE_VARIANT(name, impl, 123) \
+	RENDER_DEFINE_VARIANT(name, impl, 124) \
+	RENDER_DEFINE_VARIANT(name, impl, 125) \
+	RENDER_DEFINE_VARIANT(name, impl, 126) \
+	RENDER_DEFINE_VARIANT(name, impl, 127) \
+	const render_pixels_fn name##_variants[RENDER_VARIANT_COUNT] = { \
+		name##_0, name##_1, name##_2, name##_3, name##_4, name##_5, name##_6, name##_7, \
+		name##_8, name##_9, name##_10, name##_11, name##_12, name##_13, name##_14, name##_15, \
+		name##_16, name##_17, name##_18, name##_19, name##_20, name##_21, name##_22, name##_23, \
+		name##_24, name##_25, name##_26, name##_27, name##_28, name##_29, name##_30, name##_31, \
+		name##_32, name##_33, name##_34, name##_35, name##_36, name##_37, name##_38, name##_39, \
+		name##_40, name##_41, name##_42, name##_43, name##_44, name##_45, name##_46, name##_47, \
+		name##_48, name##_49, name##_50, name##_51, name##_52, name##_53, name##_54, name##_55, \
+		name##_56, name##_57, name##_58, name##_59, name##_60, name##_61, name##_62, name##_63, \
+		name##_64, name##_65, name##_66, name##_67, name##_68, name##_69, name##_70, name##_71, \
+		name##_72, name##_73, name##_74, name##_75, name##_76, name##_77, name##_78, name##_79, \
+		name##_80, name##_81, name##_82, name##_83, name##_84, name##_85, name##_86, name##_87, \
+		name##_88, name##_89, name##_90, name##_91, name##_92, name##_93, name##_94, name##_95, \
+		name##_96, name##_97, name##_98, name##_99, name##_100, name##_101, name##_102, name##_103, \
+		name##_104, name##_105, name##_106, name##_107, name##_108, name##_109, name##_110, name##_111, \
+		name##_112, name##_113, name##_114, name##_115, name##_116, name##_117, name##_118, name##_119, \
+		name##_120, name##_121, name##_122, name##_123, name##_124, name##_125, name##_126, name##_127 \
+	};
+
+#define RENDER_ALWAYS_INLINE static inline __attribute__((always_inline))
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// 16-bit Output
+//
+// HD108 LED frames carry the 16-bit values straight from interpolation and the LUT: a 16-bit header of a 1 bit and
+// three 5-bit channel brightnesses, then the three 16-bit color channels in output order, all big-endian. With nothing
+// rounded away, there is no dithering: the 16-bit kernel ignores the dithering and HDR options and never touches the
+// dithering state, which may be left unallocated.
+
+#define RENDER_WIDE_BYTES_PER_LED 8
+
+// Renders HD108 LED frames; scalar only, as the kernel does no more than interpolate, look up and store
+extern const render_kernel_t g_render_wide_kernel;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// HDR Packing
+//
+// APA102 LED frames start with a 5-bit global brightness that scales all three 8-bit PWM values of the pixel. In HDR
+// mode each pixel gets the lowest brightness that can still represent its brightest channel, and each channel's 16-bit
+// value is divided down to a PWM value at that brightness, so dark pixels keep up to 5 more bits of resolution.
+//
+// HDR replaces dithering: HDR variants ignore the dithering option and leave the dithering state untouched.
+
+#define RENDER_HDR_MAX_BRIGHTNESS 31
+
+// Brightness for a pixel, indexed by the high byte of its brightest channel
+extern uint8_t g_render_hdr_brightness[256];
+
+// 65536 * RENDER_HDR_MAX_BRIGHTNESS / (257 * brightness), indexed by brightness
+extern uint16_t g_render_hdr_scale[RENDER_HDR_MAX_BRIGHTNESS + 1];
+
+/**
+ * Fills the HDR tables; called by render_kernel_select().
+ */
+extern void render_hdr_init(void);
+
+/**
+ * Returns the 8-bit PWM value representing the 16-bit value at the given brightness, rounded to nearest.
+ */
+static inline uint8_t render_hdr_pwm(uint32_t value, uint32_t brightness) {
+	uint32_t pwm = (value * g_render_hdr_scale[brightness] + 0x8000) >> 16;
+	return (uint8_t) (pwm > 255 ? 255 : pwm);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Ordered Dithering
+//
+// Instead of carrying each pixel's rounding error into its next frame, ordered dithering adds a threshold from a fixed
+// pattern and truncates: over the frames of one cycle every pixel goes through evenly spaced thresholds, so its output
+// averages out to its 16-bit value. Thresholds follow the frame counter in bit-reversed order, so any few frames in a
+// row already come close to the average and the remaining flicker is as fast as it can be. Neighboring pixels and the
+// three channels of a pixel start the cycle at different points, so they don't all step up on the same frame.
+//
+// The cycle is the longest power of two up to max_dither_frames frames, at most RENDER_DITHER_PATTERN_PIXELS; the
+// threshold bits the cycle doesn't cover are spread over the pattern's pixels instead.
+//
+// Kernels read no dithering state in this mode and never write it.
+
+/**
+ * Returns the frames in the ordered dithering cycle for the given max_dither_frames.
+ */
+extern uint32_t render_dither_cycle_frames(uint32_t max_dither_frames);
+
+/**
+ * Fills params->dither_thresholds for params->dithering_frame and params->max_dither_frames.
+ */
+extern void render_params_set_dither_thresholds(render_params_t* params);
+
+/**
+ * Returns min((value + threshold) >> 8, 255) for a 16-bit value.
+ */
+static inline uint8_t render_dither_ordered(uint32_t value, uint32_t threshold) {
+	uint32_t out = (value + threshold) >> 8;
+	return (uint8_t) (out > 255 ? 255 : out);
+}
+
+/**
+ * Sets the LED frame byte offsets of the color channels for the given output order. The order names the three bytes
+ * after the brightness byte, so BGR produces 0xFF, blue, green, red.
+ */
+extern void render_params_set_channel_order(render_params_t* params, color_channel_order_t color_channel_order);
+
+/**
+ * Sets the Catmull-Rom weights of the four frames for params->frame_progress16.
+ */
+extern void render_params_set_cubic_weights(render_params_t* params);
+
+/**
+ * Sets weights for the four frames that extrapolate past current along the step from previous, by extrapolation14
+ * (Q2.14, below 1) times that step, for low-latency output. Rendered with cubic_enabled.
+ */
+extern void render_params_set_extrapolation_weights(render_params_t* params, int32_t extrapolation14);
+
+/**
+ * Returns the 16-bit value at the given point of the Catmull-Rom spline through four 8-bit values, weighted by
+ * params->cubic_weights: (sum + 32) >> 6, clamped to [0, 0xFF00] where the curve overshoots the brightest frame.
+ */
+static inline int32_t render_cubic_scalar(
+	const render_params_t* params,
+	uint8_t before_previous,
+	uint8_t previous,
+	uint8_t current,
+	uint8_t after_current
+) {
+	int32_t sum = before_previous*params->cubic_weights[0]
+		+ previous*params->cubic_weights[1]
+		+ current*params->cubic_weights[2]
+		+ after_current*params->cubic_weights[3];
+	int32_t value = (sum + 32) >> 6;
+	return value < 0 ? 0 : value > 0xFF00 ? 0xFF00 : value;
+}
+
+/**
+ * Reads pixel_count pixels back from LED frames written by a kernel with the given params into 8-bit RGB: 4-byte
+ * APA102 LED frames, with HDR brightness applied, or 8-byte HD108 LED frames from g_render_wide_kernel if wide.
+ */
+extern void render_led_frames_to_rgb(
+	const render_params_t* params,
+	const uint8_t* led_frames,
+	uint32_t pixel_count,
+	bool wide,
+	uint8_t* rgb_out
+);
+
+/**
+ * Allocates a zeroed frame with cache-line aligned planes. Returns false if the allocation failed.
+ */
+extern bool render_frame_alloc(render_frame_t* frame, uint32_t pixel_count);
+extern void render_frame_free(render_frame_t* frame);
+
+/**
+ * Copies interleaved 8-bit RGB data into the frame's planes, zeroing any pixels not covered by data_size.
+ */
+extern void render_frame_set_rgb(render_frame_t* frame, const uint8_t* rgb_data, uint32_t data_size);
+
+/**
+ * Returns min((value * gain) >> 15, 0xFFFF) for a 16-bit value and a Q1.15 gain.
+ */
+static inline uint32_t render_gain_apply(uint32_t value, uint32_t gain) {
+	uint32_t scaled = (value * gain) >> 15;
+	return scaled > 0xFFFF ? 0xFFFF : scaled;
+}
+
+/**
+ * Allocates gains for pixel_count pixels with cache-line aligned planes, all at RENDER_GAIN_UNITY. Returns false if
+ * the allocation failed.
+ */
+extern bool render_gain_alloc(render_gain_t* gain, uint32_t pixel_count);
+extern void render_gain_free(render_gain_t* gain);
+
+/**
+ * Loads gains from a calibration file into gain, which must already be allocated. Pixels the file doesn't cover keep
+ * RENDER_GAIN_UNITY. Returns false after printing why if the file can't be read.
+ */
+extern bool render_gain_load(render_gain_t* gain, const char* path);
+
+/**
+ * Allocates zeroed dithering state with cache-line aligned planes. Returns false if the allocation failed.
+ */
+extern bool render_dither_alloc(render_dither_t* dither, uint32_t pixel_count);
+extern void render_dither_free(render_dither_t* dither);
+
+/**
+ * Selects the render kernel with the given name ("scalar", "sse2", "avx2", "neon"), or the fastest kernel supported by
+ * this CPU for "auto". Vectorized kernels are verified against the scalar kernel over RENDER_VERIFY_STARTUP_FRAMES
+ * frames before being returned; if the requested kernel is unsupported or fails verification, the next best kernel is
+ * used instead.
+ */
+extern const render_kernel_t* render_kernel_select(const char* name);
+
+/**
+ * Returns the render kernel with the given name, or NULL if there is none. The kernel may not be supported by this CPU.
+ */
+extern const render_kernel_t* render_kernel_by_name(const char* name);
+
+// Frames render_kernel_select() verifies a kernel over, and frames for a full verification: enough for the 8-bit
+// dithering frame counter to wrap. The full verification runs in `make check`.
+#define RENDER_VERIFY_STARTUP_FRAMES 8
+#define RENDER_VERIFY_FULL_FRAMES 300
+
+/**
+ * Runs the given kernel and the scalar reference kernel over the same pseudo-random inputs for every combination of
+ * render options and frame_count consecutive frames, returning true if output and dithering state match bit for bit.
+ */
+extern bool render_kernel_verify(const render_kernel_t* kernel, uint32_t frame_count);
+
+#endif //SPISCAPE_RENDER_H
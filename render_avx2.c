@@ -0,0 +1,374 @@
+/** \file
+ * AVX2 render kernel. Bit-exact with render_pixels_scalar().
+ *
+ * This file is compiled with -mavx2 and must only be called after checking for AVX2 support at runtime.
+ */
+#if defined(__x86_64__) || defined(__i386__)
+
+#include "render_simd.h"
+
+#include <stdlib.h>
+#include <immintrin.h>
+
+/**
+ * (a*wa + b*wb) >> 8 for unsigned 16-bit lanes whose full sum fits in 24 bits.
+ */
+static inline __m256i render_blend_epu16(__m256i a, __m256i wa, __m256i b, __m256i wb) {
+	const __m256i bias = _mm256_set1_epi16((int16_t) 0x8000);
+
+	__m256i lo_a = _mm256_mullo_epi16(a, wa);
+	__m256i hi_a = _mm256_mulhi_epu16(a, wa);
+	__m256i lo_b = _mm256_mullo_epi16(b, wb);
+	__m256i hi_b = _mm256_mulhi_epu16(b, wb);
+
+	// Add the 32-bit products as 16-bit halves, carrying from the low half when it wraps
+	__m256i lo = _mm256_add_epi16(lo_a, lo_b);
+	__m256i carry = _mm256_cmpgt_epi16(_mm256_xor_si256(lo_a, bias), _mm256_xor_si256(lo, bias));
+	__m256i hi = _mm256_sub_epi16(_mm256_add_epi16(hi_a, hi_b), carry);
+
+	return _mm256_or_si256(_mm256_slli_epi16(hi, 8), _mm256_srli_epi16(lo, 8));
+}
+
+/**
+ * Gathers lookup[index] for sixteen 16-bit indices.
+ */
+/**
+ * min((value * gain) >> 15, 0xFFFF) for unsigned 16-bit lanes.
+ */
+static inline __m256i render_gain_epu16(__m256i value, __m256i gain) {
+	__m256i hi = _mm256_mulhi_epu16(value, gain);
+	__m256i lo = _mm256_mullo_epi16(value, gain);
+
+	// The top bit of the high half shifts out exactly when the result overflows, and saturates it instead
+	__m256i scaled = _mm256_or_si256(_mm256_slli_epi16(hi, 1), _mm256_srli_epi16(lo, 15));
+	return _mm256_or_si256(scaled, _mm256_srai_epi16(hi, 15));
+}
+
+static inline __m256i render_gather_epu16(const uint32_t* lookup, __m256i index) {
+	__m256i index_lo = _mm256_cvtepu16_epi32(_mm256_castsi256_si128(index));
+	__m256i index_hi = _mm256_cvtepu16_epi32(_mm256_extracti128_si256(index, 1));
+
+	__m256i lo = _mm256_i32gather_epi32((const int*) lookup, index_lo, 4);
+	__m256i hi = _mm256_i32gather_epi32((const int*) lookup, index_hi, 4);
+
+	// packus works within 128-bit lanes; restore the element order afterwards
+	return _mm256_permute4x64_epi64(_mm256_packus_epi32(lo, hi), _MM_SHUFFLE(3, 1, 2, 0));
+}
+
+/**
+ * The Catmull-Rom spline through four frames at params->cubic_weights, as in render_cubic_scalar().
+ */
+static inline __m256i render_cubic_epu16(
+	const render_params_t* params,
+	__m256i before_previous,
+	__m256i previous,
+	__m256i current,
+	__m256i after_current
+) {
+	const int16_t* weights = params->cubic_weights;
+	const __m256i weights01 = _mm256_set1_epi32((int32_t) ((uint16_t) weights[0] | (uint32_t) (uint16_t) weights[1] << 16));
+	const __m256i weights23 = _mm256_set1_epi32((int32_t) ((uint16_t) weights[2] | (uint32_t) (uint16_t) weights[3] << 16));
+
+	// Rounds, and moves the result down by 0x8000 so that packing with signed saturation clamps it to [0, 0xFFFF]
+	const __m256i bias = _mm256_set1_epi32(32 - (0x8000 << 6));
+
+	// Each pixel's four weighted values, added up in 32 bits as two pairs of 16-bit products
+	__m256i lo = _mm256_add_epi32(
+		_mm256_madd_epi16(_mm256_unpacklo_epi16(before_previous, previous), weights01),
+		_mm256_madd_epi16(_mm256_unpacklo_epi16(current, after_current), weights23)
+	);
+	__m256i hi = _mm256_add_epi32(
+		_mm256_madd_epi16(_mm256_unpackhi_epi16(before_previous, previous), weights01),
+		_mm256_madd_epi16(_mm256_unpackhi_epi16(current, after_current), weights23)
+	);
+
+	lo = _mm256_srai_epi32(_mm256_add_epi32(lo, bias), 6);
+	hi = _mm256_srai_epi32(_mm256_add_epi32(hi, bias), 6);
+
+	// unpack and packs both work within 128-bit lanes, so the elements come out in the order they went in
+	__m256i value = _mm256_xor_si256(_mm256_packs_epi32(lo, hi), _mm256_set1_epi16((int16_t) 0x8000));
+	return _mm256_min_epu16(value, _mm256_set1_epi16((int16_t) 0xFF00));
+}
+
+/**
+ * Interpolates and applies the LUT to a block of one channel, returning 16-bit values. The planes before previous and
+ * after current are only read for cubic interpolation.
+ */
+RENDER_ALWAYS_INLINE __m256i render_shade_avx2(
+	const render_params_t* params,
+	const uint32_t* lookup,
+	const uint8_t* before_previous_plane,
+	const uint8_t* previous_plane,
+	const uint8_t* current_plane,
+	const uint8_t* after_current_plane,
+	const bool interpolation_enabled,
+	const bool lut_enabled,
+	const bool cubic_enabled
+) {
+	__m256i previous = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*) previous_plane));
+	__m256i current = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*) current_plane));
+	__m256i value;
+
+	// Interpolate
+	if (interpolation_enabled && cubic_enabled) {
+		value = render_cubic_epu16(
+			params,
+			_mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*) before_previous_plane)),
+			previous,
+			current,
+			_mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*) after_current_plane))
+		);
+	} else if (interpolation_enabled) {
+		value = render_blend_epu16(
+			previous, _mm256_set1_epi16((int16_t) params->inv_frame_progress16),
+			current, _mm256_set1_epi16((int16_t) params->frame_progress16)
+		);
+	} else {
+		value = _mm256_slli_epi16(current, 8);
+	}
+
+	// Apply LUT
+	if (lut_enabled) {
+		__m256i index = _mm256_srli_epi16(value, 8);
+		__m256i alpha = _mm256_and_si256(value, _mm256_set1_epi16(0xFF));
+		__m256i inv_alpha = _mm256_sub_epi16(_mm256_set1_epi16(0x100), alpha);
+
+		value = render_blend_epu16(
+			render_gather_epu16(lookup, index), inv_alpha,
+			render_gather_epu16(lookup + 1, index), alpha
+		);
+	}
+
+	return value;
+}
+
+/**
+ * Dithers a block of one channel down to 8 bits, updating its dithering state.
+ */
+RENDER_ALWAYS_INLINE void render_quantize_avx2(
+	const render_params_t* params,
+	__m256i value,
+	int16_t* overflow_plane,
+	int8_t* last_effect_frame_plane,
+	uint8_t* out,
+	const bool dithering_enabled
+) {
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i frame = _mm256_set1_epi16(params->dithering_frame);
+	const __m256i abs_frame = _mm256_set1_epi16((int16_t) abs(params->dithering_frame));
+	const __m256i max_frames = _mm256_set1_epi16(render_max_dither_frames16(params));
+	const __m256i rounding = _mm256_set1_epi16(0x80);
+
+	__m256i ovf = _mm256_loadu_si256((const __m256i*) overflow_plane);
+	__m256i last = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*) last_effect_frame_plane));
+
+	// Reset dithering for pixels that haven't been changed by it for too long
+	__m256i age = _mm256_abs_epi16(_mm256_sub_epi16(_mm256_abs_epi16(last), abs_frame));
+	__m256i reset = _mm256_cmpgt_epi16(age, max_frames);
+	ovf = _mm256_andnot_si256(reset, ovf);
+	last = _mm256_blendv_epi8(last, frame, reset);
+
+	// Round to 8 bits. The rounding term is in [-0xFF, 0xFF]; adding its positive and subtracting its negative part
+	// with unsigned saturation clamps the result to [0, 0xFFFF] before the shift.
+	__m256i dither = dithering_enabled ? _mm256_add_epi16(ovf, rounding) : rounding;
+	__m256i dither_up = _mm256_max_epi16(dither, zero);
+	__m256i dither_down = _mm256_max_epi16(_mm256_sub_epi16(zero, dither), zero);
+	__m256i out16 = _mm256_srli_epi16(_mm256_subs_epu16(_mm256_adds_epu16(value, dither_up), dither_down), 8);
+
+	// Check for dithering effect against the undithered value, (value + 0x80) >> 8 without overflowing 16 bits
+	__m256i undithered = _mm256_srli_epi16(_mm256_add_epi16(_mm256_srli_epi16(value, 1), _mm256_set1_epi16(0x40)), 7);
+	last = _mm256_blendv_epi8(frame, last, _mm256_cmpeq_epi16(out16, undithered));
+
+	// The residual always fits in 16 bits, so wrapping arithmetic gives the exact result
+	if (dithering_enabled) {
+		ovf = _mm256_sub_epi16(_mm256_add_epi16(value, ovf), _mm256_mullo_epi16(out16, _mm256_set1_epi16(257)));
+	}
+
+	_mm256_storeu_si256((__m256i*) overflow_plane, ovf);
+	_mm_storeu_si128(
+		(__m128i*) last_effect_frame_plane,
+		_mm_packs_epi16(_mm256_castsi256_si128(last), _mm256_extracti128_si256(last, 1))
+	);
+
+	_mm_store_si128(
+		(__m128i*) out,
+		_mm_packus_epi16(_mm256_castsi256_si128(out16), _mm256_extracti128_si256(out16, 1))
+	);
+}
+
+/**
+ * Dithers a block of one channel down to 8 bits against the ordered dithering thresholds starting at thresholds.
+ */
+static inline void render_quantize_ordered_avx2(__m256i value, const uint8_t* thresholds, uint8_t* out) {
+	__m256i threshold = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*) thresholds));
+
+	// Saturating at 0xFFFF keeps the result within 255, like the clamp of the scalar kernel
+	__m256i out16 = _mm256_srli_epi16(_mm256_adds_epu16(value, threshold), 8);
+
+	_mm_store_si128(
+		(__m128i*) out,
+		_mm_packus_epi16(_mm256_castsi256_si128(out16), _mm256_extracti128_si256(out16, 1))
+	);
+}
+
+/**
+ * Splits a block of 16-bit values, already in output order, into per-pixel HDR brightness and 8-bit PWM values.
+ */
+static inline void render_hdr_avx2(
+	const __m256i values[3],
+	uint8_t header[RENDER_BLOCK_PIXELS],
+	uint8_t out[3][RENDER_BLOCK_PIXELS]
+) {
+	uint16_t brightest[RENDER_BLOCK_PIXELS] __attribute__((aligned(32)));
+	uint16_t scale[RENDER_BLOCK_PIXELS] __attribute__((aligned(32)));
+
+	_mm256_store_si256((__m256i*) brightest, _mm256_max_epu16(_mm256_max_epu16(values[0], values[1]), values[2]));
+
+	for (int i=0; i<RENDER_BLOCK_PIXELS; i++) {
+		uint8_t brightness = g_render_hdr_brightness[brightest[i] >> 8];
+		header[i] = (uint8_t) (0xE0 | brightness);
+		scale[i] = g_render_hdr_scale[brightness];
+	}
+
+	__m256i scale_v = _mm256_load_si256((const __m256i*) scale);
+
+	for (int position=0; position<3; position++) {
+		// (value * scale + 0x8000) >> 16: the rounding carries exactly when bit 15 of the low half is set
+		__m256i high = _mm256_mulhi_epu16(values[position], scale_v);
+		__m256i round = _mm256_srli_epi16(_mm256_mullo_epi16(values[position], scale_v), 15);
+		__m256i pwm = _mm256_add_epi16(high, round);
+
+		// Saturates the occasional 256 from rounding down to 255
+		_mm_store_si128(
+			(__m128i*) out[position],
+			_mm_packus_epi16(_mm256_castsi256_si128(pwm), _mm256_extracti128_si256(pwm, 1))
+		);
+	}
+}
+
+/**
+ * Interleaves a block's brightness bytes and output planes, already in output order, into APA102 LED frames.
+ */
+static inline void render_pack_avx2(
+	__m128i header,
+	uint8_t out[3][RENDER_BLOCK_PIXELS],
+	uint8_t* pixels_out
+) {
+	__m128i first = _mm_load_si128((const __m128i*) out[0]);
+	__m128i second = _mm_load_si128((const __m128i*) out[1]);
+	__m128i third = _mm_load_si128((const __m128i*) out[2]);
+
+	__m128i header_first_lo = _mm_unpacklo_epi8(header, first);
+	__m128i header_first_hi = _mm_unpackhi_epi8(header, first);
+	__m128i second_third_lo = _mm_unpacklo_epi8(second, third);
+	__m128i second_third_hi = _mm_unpackhi_epi8(second, third);
+
+	_mm256_storeu_si256(
+		(__m256i*) &pixels_out[0],
+		_mm256_set_m128i(_mm_unpackhi_epi16(header_first_lo, second_third_lo), _mm_unpacklo_epi16(header_first_lo, second_third_lo))
+	);
+	_mm256_storeu_si256(
+		(__m256i*) &pixels_out[32],
+		_mm256_set_m128i(_mm_unpackhi_epi16(header_first_hi, second_third_hi), _mm_unpacklo_epi16(header_first_hi, second_third_hi))
+	);
+}
+
+RENDER_ALWAYS_INLINE void render_pixels_avx2_impl(
+	const render_params_t* params,
+	const render_frame_t* previous,
+	const render_frame_t* current,
+	render_dither_t* dither,
+	uint32_t first_pixel,
+	uint32_t pixel_count,
+	uint8_t* pixels_out,
+	const bool interpolation_enabled,
+	const bool lut_enabled,
+	const bool dithering_enabled,
+	const bool hdr_enabled,
+	const bool gain_enabled,
+	const bool cubic_enabled,
+	const bool ordered_enabled
+) {
+	uint32_t block_end = pixel_count - pixel_count % RENDER_BLOCK_PIXELS;
+	uint8_t out[3][RENDER_BLOCK_PIXELS] __attribute__((aligned(16)));
+
+	// Only read for cubic interpolation
+	const render_frame_t* before_previous = interpolation_enabled && cubic_enabled ? params->before_previous : current;
+	const render_frame_t* after_current = interpolation_enabled && cubic_enabled ? params->after_current : current;
+
+	// Render each channel straight into its output position, so packing needs no further shuffling
+	for (uint32_t i=0; i<block_end; i += RENDER_BLOCK_PIXELS) {
+		uint32_t pixel_index = first_pixel + i;
+		__m256i values[3];
+
+		for (int channel=0; channel<3; channel++) {
+			values[params->channel_offsets[channel] - 1] = render_shade_avx2(
+				params,
+				render_channel_lookup(params, channel),
+				&before_previous->planes[channel][pixel_index],
+				&previous->planes[channel][pixel_index],
+				&current->planes[channel][pixel_index],
+				&after_current->planes[channel][pixel_index],
+				interpolation_enabled,
+				lut_enabled,
+				cubic_enabled
+			);
+
+			// Apply calibration gain
+			if (gain_enabled) {
+				uint32_t position = params->channel_offsets[channel] - 1u;
+				__m256i gain = _mm256_loadu_si256((const __m256i*) &params->gain->gains[channel][pixel_index]);
+
+				values[position] = render_gain_epu16(values[position], gain);
+			}
+		}
+
+		if (hdr_enabled) {
+			uint8_t header[RENDER_BLOCK_PIXELS] __attribute__((aligned(16)));
+
+			render_hdr_avx2(values, header, out);
+			render_pack_avx2(_mm_load_si128((const __m128i*) header), out, &pixels_out[i*4]);
+		} else {
+			for (int channel=0; channel<3; channel++) {
+				uint32_t position = params->channel_offsets[channel] - 1u;
+
+				if (dithering_enabled && ordered_enabled) {
+					render_quantize_ordered_avx2(
+						values[position],
+						&params->dither_thresholds[(pixel_index + channel) % RENDER_DITHER_PATTERN_PIXELS],
+						out[position]
+					);
+					continue;
+				}
+
+				render_quantize_avx2(
+					params,
+					values[position],
+					&dither->overflow[channel][pixel_index],
+					&dither->last_effect_frame[channel][pixel_index],
+					out[position],
+					dithering_enabled
+				);
+			}
+
+			render_pack_avx2(_mm_set1_epi8((char) 0xFF), out, &pixels_out[i*4]);
+		}
+	}
+
+	// Finish the partial block at the end with the reference kernel
+	render_pixels_scalar_variants[RENDER_VARIANT_INDEX(
+		interpolation_enabled, lut_enabled, dithering_enabled, hdr_enabled, gain_enabled, cubic_enabled, ordered_enabled
+	)](
+		params,
+		previous,
+		current,
+		dither,
+		first_pixel + block_end,
+		pixel_count - block_end,
+		&pixels_out[block_end*4]
+	);
+}
+
+RENDER_DEFINE_VARIANTS(render_pixels_avx2, render_pixels_avx2_impl)
+
+#endif
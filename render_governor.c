@@ -0,0 +1,153 @@
+/** \file
+ * Render quality governor.
+ */
+#include "render_governor.h"
+
+#include <string.h>
+
+#define min(a,b) ((a)<(b)?(a):(b))
+#define max(a,b) ((a)>(b)?(a):(b))
+
+/**
+ * Returns the frame time the given quality level has to stay within.
+ */
+static uint32_t render_governor_budget_usec(const render_governor_t* governor, render_quality_t quality) {
+	// Without a target refresh rate, keep up the rate dithering needs
+	uint32_t budget = governor->target_period_usec > 0
+		? governor->target_period_usec
+		: RENDER_GOVERNOR_DITHERING_MAX_PERIOD_USEC;
+	budget = max(budget, governor->bus_usec);
+
+	if (quality < RENDER_QUALITY_NO_DITHERING) {
+		budget = min(budget, RENDER_GOVERNOR_DITHERING_MAX_PERIOD_USEC);
+	}
+
+	return budget;
+}
+
+/**
+ * Returns the render time the given quality level has to stay within. Rendering overlaps the previous frame's transfer,
+ * so it can take the period left after the transfer, or as long as the transfer itself if that is longer: beyond that
+ * the bus, not the render features, sets the frame rate.
+ */
+static uint32_t render_governor_render_budget_usec(const render_governor_t* governor, render_quality_t quality) {
+	uint32_t budget = render_governor_budget_usec(governor, quality);
+	uint32_t bus_usec = min(governor->bus_usec, budget);
+
+	return max(budget - bus_usec, bus_usec);
+}
+
+static void render_governor_set_quality(render_governor_t* governor, render_quality_t quality) {
+	// Stepping down pairs the higher level's last render time with a fresh reference for the new level
+	if (quality > governor->quality) {
+		governor->level_reference_usec[quality] = 0;
+	}
+
+	governor->quality = quality;
+	governor->over_budget_since_usec = 0;
+	governor->under_budget_since_usec = 0;
+
+	// The averages were taken at the old level; start over with the next frame
+	governor->has_samples = false;
+	governor->settled_frames = 0;
+}
+
+void render_governor_init(render_governor_t* governor) {
+	memset(governor, 0, sizeof(render_governor_t));
+	governor->quality = RENDER_QUALITY_FULL;
+}
+
+void render_governor_set_target(
+	render_governor_t* governor,
+	uint32_t refresh_rate_hz,
+	uint32_t spi_speed_hz,
+	uint32_t frame_bytes,
+	uint32_t latch_usec
+) {
+	governor->target_period_usec = refresh_rate_hz > 0 ? 1000000 / refresh_rate_hz : 0;
+	governor->bus_usec = spi_speed_hz > 0 ? (uint32_t) ((uint64_t) frame_bytes * 8 * 1000000 / spi_speed_hz) : 0;
+
+	// spio_write() idles the bus for the latch time after every frame, as part of the write
+	governor->bus_usec += latch_usec;
+}
+
+bool render_governor_update(
+	render_governor_t* governor,
+	uint32_t render_usec,
+	uint32_t write_usec,
+	uint64_t now_usec
+) {
+	if (governor->has_samples) {
+		governor->render_usec16 = governor->render_usec16 - governor->render_usec16 / 16 + render_usec;
+		governor->write_usec16 = governor->write_usec16 - governor->write_usec16 / 16 + write_usec;
+	} else {
+		governor->render_usec16 = render_usec * 16;
+		governor->write_usec16 = write_usec * 16;
+		governor->has_samples = true;
+	}
+
+	render_quality_t quality = governor->quality;
+	uint32_t render_avg = render_governor_render_usec(governor);
+	governor->level_render_usec[quality] = render_avg;
+
+	if (governor->settled_frames < RENDER_GOVERNOR_SETTLE_FRAMES && ++governor->settled_frames == RENDER_GOVERNOR_SETTLE_FRAMES) {
+		if (governor->level_reference_usec[quality] == 0) {
+			governor->level_reference_usec[quality] = render_avg;
+		}
+	}
+
+	// Step down while rendering stays over budget. Write time is left out: no render feature shortens the transfer.
+	uint64_t budget = render_governor_render_budget_usec(governor, quality);
+	bool over_budget = (uint64_t) render_avg * 100 > budget * RENDER_GOVERNOR_STEP_DOWN_PERCENT;
+
+	if (over_budget && quality + 1 < RENDER_QUALITY_LEVEL_COUNT) {
+		if (governor->over_budget_since_usec == 0) {
+			governor->over_budget_since_usec = now_usec;
+		} else if (now_usec - governor->over_budget_since_usec >= RENDER_GOVERNOR_STEP_DOWN_HOLD_USEC) {
+			render_governor_set_quality(governor, quality + 1);
+			return true;
+		}
+	} else {
+		governor->over_budget_since_usec = 0;
+	}
+
+	// Step up once the higher level's predicted render time would fit its budget with room to spare
+	if (quality > RENDER_QUALITY_FULL && governor->level_reference_usec[quality] > 0) {
+		render_quality_t higher = quality - 1;
+		uint64_t higher_budget = render_governor_render_budget_usec(governor, higher);
+		uint64_t predicted_render_usec = (uint64_t) governor->level_render_usec[higher] * render_avg
+			/ governor->level_reference_usec[quality];
+
+		if (predicted_render_usec * 100 < higher_budget * RENDER_GOVERNOR_STEP_UP_PERCENT) {
+			if (governor->under_budget_since_usec == 0) {
+				governor->under_budget_since_usec = now_usec;
+			} else if (now_usec - governor->under_budget_since_usec >= RENDER_GOVERNOR_STEP_UP_HOLD_USEC) {
+				render_governor_set_quality(governor, higher);
+				return true;
+			}
+		} else {
+			governor->under_budget_since_usec = 0;
+		}
+	}
+
+	return false;
+}
+
+uint32_t render_governor_frame_period_usec(const render_governor_t* governor) {
+	uint32_t frame_usec = max(render_governor_render_usec(governor), render_governor_write_usec(governor));
+	return max(frame_usec, governor->target_period_usec);
+}
+
+uint32_t render_governor_bus_limit_hz(const render_governor_t* governor) {
+	return governor->bus_usec > 0 ? 1000000 / governor->bus_usec : 0;
+}
+
+const char* render_quality_to_string(render_quality_t quality) {
+	switch (quality) {
+		case RENDER_QUALITY_FULL: return "full";
+		case RENDER_QUALITY_NO_DITHERING: return "no-dithering";
+		case RENDER_QUALITY_LINEAR_INTERPOLATION: return "linear-interpolation";
+		case RENDER_QUALITY_NO_INTERPOLATION: return "no-interpolation";
+		default: return "unknown";
+	}
+}
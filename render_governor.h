@@ -0,0 +1,136 @@
+/** \file
+ * Render quality governor: trades render features for frame rate when a frame takes longer than its budget.
+ *
+ * The governor tracks how long rendering and the SPI transfer take, separately. Only render time depends on the render
+ * features, so only render time is compared against a budget. The frame period is the target refresh period, but
+ * never less than the time the SPI bus needs to clock out one frame; dithering has a tighter period of its own, because
+ * dithering that blinks slower than RENDER_GOVERNOR_DITHERING_MAX_PERIOD_USEC is visible as flicker. A frame is
+ * rendered while the previous one is on the wire, so rendering gets whatever the transfer leaves of the period, or the
+ * transfer time itself if that is longer.
+ *
+ * When rendering stays over budget, features are switched off one step at a time: dithering first, then cubic
+ * interpolation falls back to linear, then interpolation goes altogether. The governor remembers what rendering cost at
+ * the higher level and, shortly after stepping down, at the lower one. The ratio between the two predicts what the
+ * higher level would cost now, as the load on the CPU changes, and the governor steps back up once that prediction fits
+ * the budget with room to spare. Both directions have a hold time, so the quality doesn't flap.
+ */
+#ifndef SPISCAPE_RENDER_GOVERNOR_H
+#define SPISCAPE_RENDER_GOVERNOR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Dithering needs at least 100fps to be invisible
+#define RENDER_GOVERNOR_DITHERING_MAX_PERIOD_USEC 10000
+
+// Render time, as a percentage of the budget, above which the governor steps down
+#define RENDER_GOVERNOR_STEP_DOWN_PERCENT 105
+
+// Predicted render time, as a percentage of the budget, below which the governor steps back up
+#define RENDER_GOVERNOR_STEP_UP_PERCENT 80
+
+// Frames averaged after a change of quality before the new level's render time is taken as its reference
+#define RENDER_GOVERNOR_SETTLE_FRAMES 16
+
+#define RENDER_GOVERNOR_STEP_DOWN_HOLD_USEC 500000
+#define RENDER_GOVERNOR_STEP_UP_HOLD_USEC 3000000
+
+typedef enum {
+	RENDER_QUALITY_FULL = 0,
+	RENDER_QUALITY_NO_DITHERING,
+	RENDER_QUALITY_LINEAR_INTERPOLATION,
+	RENDER_QUALITY_NO_INTERPOLATION,
+
+	RENDER_QUALITY_LEVEL_COUNT
+} render_quality_t;
+
+typedef struct {
+	render_quality_t quality;
+
+	// Moving averages, in microseconds times 16
+	uint32_t render_usec16;
+	uint32_t write_usec16;
+	bool has_samples;
+
+	// Frames since the quality last changed, up to RENDER_GOVERNOR_SETTLE_FRAMES
+	uint32_t settled_frames;
+
+	// Render time last measured at each quality level, or 0 if never measured
+	uint32_t level_render_usec[RENDER_QUALITY_LEVEL_COUNT];
+
+	// Render time at each level once settled after stepping down into it, or 0 if never measured
+	uint32_t level_reference_usec[RENDER_QUALITY_LEVEL_COUNT];
+
+	// Time on the wire for one frame at the SPI clock rate plus the latch time, and the target refresh period (0 for none)
+	uint32_t bus_usec;
+	uint32_t target_period_usec;
+
+	// When the current run of over- or under-budget frames started, or 0
+	uint64_t over_budget_since_usec;
+	uint64_t under_budget_since_usec;
+} render_governor_t;
+
+/**
+ * Starts the governor at full quality with no measurements.
+ */
+extern void render_governor_init(render_governor_t* governor);
+
+/**
+ * Sets the target refresh rate (0 for as fast as possible) and what the bus time follows from: the SPI clock rate, the
+ * frame size, and how long the bus stays idle after each frame for the LEDs to latch. Cheap enough to call every frame.
+ */
+extern void render_governor_set_target(
+	render_governor_t* governor,
+	uint32_t refresh_rate_hz,
+	uint32_t spi_speed_hz,
+	uint32_t frame_bytes,
+	uint32_t latch_usec
+);
+
+/**
+ * Adds the render and SPI write time of a frame rendered at the current quality, taken at now_usec on a monotonic
+ * clock, and steps the quality up or down if needed.
+ *
+ * \return true if the quality changed
+ */
+extern bool render_governor_update(
+	render_governor_t* governor,
+	uint32_t render_usec,
+	uint32_t write_usec,
+	uint64_t now_usec
+);
+
+/**
+ * Returns the time between frames: the longer of the average render and write times, or the target refresh period if
+ * that is longer still.
+ */
+extern uint32_t render_governor_frame_period_usec(const render_governor_t* governor);
+
+/**
+ * Returns the refresh rate the SPI bus could sustain if rendering took no time at all.
+ */
+extern uint32_t render_governor_bus_limit_hz(const render_governor_t* governor);
+
+static inline uint32_t render_governor_render_usec(const render_governor_t* governor) {
+	return governor->render_usec16 / 16;
+}
+
+static inline uint32_t render_governor_write_usec(const render_governor_t* governor) {
+	return governor->write_usec16 / 16;
+}
+
+static inline bool render_governor_allows_dithering(const render_governor_t* governor) {
+	return governor->quality < RENDER_QUALITY_NO_DITHERING;
+}
+
+static inline bool render_governor_allows_cubic_interpolation(const render_governor_t* governor) {
+	return governor->quality < RENDER_QUALITY_LINEAR_INTERPOLATION;
+}
+
+static inline bool render_governor_allows_interpolation(const render_governor_t* governor) {
+	return governor->quality < RENDER_QUALITY_NO_INTERPOLATION;
+}
+
+extern const char* render_quality_to_string(render_quality_t quality);
+
+#endif //SPISCAPE_RENDER_GOVERNOR_H
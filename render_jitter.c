@@ -0,0 +1,67 @@
+/** \file
+ * Jitter buffer timing.
+ */
+#include "render_jitter.h"
+
+#include <string.h>
+
+#define min(a,b) ((a)<(b)?(a):(b))
+#define max(a,b) ((a)>(b)?(a):(b))
+
+void render_jitter_init(render_jitter_t* jitter) {
+	memset(jitter, 0, sizeof(render_jitter_t));
+}
+
+uint64_t render_jitter_depth_usec(const render_jitter_t* jitter, int32_t depth_ms) {
+	if (depth_ms == RENDER_JITTER_DEPTH_AUTO) {
+		return min(jitter->jitter_peak_usec16 / 16 + RENDER_JITTER_MARGIN_USEC, RENDER_JITTER_MAX_DEPTH_USEC);
+	}
+	return depth_ms > 0 ? (uint64_t) depth_ms * 1000 : 0;
+}
+
+uint64_t render_jitter_frame_arrived(
+	render_jitter_t* jitter,
+	uint64_t sender_usec,
+	uint64_t arrival_usec,
+	int32_t depth_ms
+) {
+	int64_t difference_usec = (int64_t) (arrival_usec - sender_usec);
+	int64_t change_usec = difference_usec - jitter->offset_usec;
+
+	// A sender that goes back in time, or jumps far ahead, has restarted its clock
+	if (! jitter->synced
+		|| sender_usec < jitter->sender_usec
+		|| change_usec > RENDER_JITTER_RESYNC_USEC
+		|| change_usec < -RENDER_JITTER_RESYNC_USEC
+	) {
+		jitter->stat_resyncs += jitter->synced ? 1 : 0;
+		jitter->synced = true;
+		jitter->offset_usec = difference_usec;
+		jitter->jitter_peak_usec16 = 0;
+		change_usec = 0;
+	} else if (change_usec < 0) {
+		jitter->offset_usec = difference_usec;
+		change_usec = 0;
+	} else {
+		jitter->offset_usec += change_usec >> RENDER_JITTER_DRIFT_SHIFT;
+	}
+	jitter->sender_usec = sender_usec;
+	jitter->stat_frames++;
+
+	uint64_t peak_usec16 = jitter->jitter_peak_usec16 - (jitter->jitter_peak_usec16 >> RENDER_JITTER_DECAY_SHIFT);
+	jitter->jitter_peak_usec16 = max(peak_usec16, (uint64_t) change_usec * 16);
+
+	uint64_t present_usec = (uint64_t) ((int64_t) sender_usec + jitter->offset_usec)
+		+ render_jitter_depth_usec(jitter, depth_ms);
+	if (present_usec < arrival_usec) {
+		jitter->stat_late_frames++;
+		return arrival_usec;
+	}
+	return present_usec;
+}
+
+void render_jitter_reset_stats(render_jitter_t* jitter) {
+	jitter->stat_frames = 0;
+	jitter->stat_late_frames = 0;
+	jitter->stat_resyncs = 0;
+}
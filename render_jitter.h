@@ -0,0 +1,76 @@
+/** \file
+ * Jitter buffer timing: places frames that carry the sender's timestamp on our clock, so frames that arrive in bursts
+ * are shown as evenly as they were sent.
+ *
+ * The difference between a frame's arrival and its sender timestamp is the offset between the two clocks plus however
+ * long the frame took to get here. The smallest difference seen stands for the offset plus the fastest trip, and every
+ * frame is shown at its sender timestamp plus that offset plus the buffer depth: frames delayed by less than the depth
+ * are shown on the sender's timeline, later ones as soon as they arrive. Since the two clocks drift apart, the offset
+ * also creeps towards every frame's difference; a faster trip resets it right away.
+ *
+ * The depth is either fixed, or follows how much later than the fastest trip frames arrive: a peak that decays slowly,
+ * plus RENDER_JITTER_MARGIN_USEC.
+ */
+#ifndef SPISCAPE_RENDER_JITTER_H
+#define SPISCAPE_RENDER_JITTER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Longest depth the buffer adapts to
+#define RENDER_JITTER_MAX_DEPTH_USEC 500000
+
+// Added to the measured jitter for the adaptive depth
+#define RENDER_JITTER_MARGIN_USEC 2000
+
+// How fast the offset creeps towards each frame's difference, and the jitter peak decays, per frame, as right shifts
+#define RENDER_JITTER_DRIFT_SHIFT 8
+#define RENDER_JITTER_DECAY_SHIFT 8
+
+// Change in a frame's difference beyond which the sender is taken to have restarted its clock
+#define RENDER_JITTER_RESYNC_USEC 1000000
+
+// Depth setting that adapts the depth to the measured jitter
+#define RENDER_JITTER_DEPTH_AUTO -1
+
+typedef struct {
+	// Smallest recent difference between arrival and sender timestamp, in microseconds
+	int64_t offset_usec;
+	bool synced;
+
+	// Sender timestamp of the latest frame
+	uint64_t sender_usec;
+
+	// Decaying peak of how much later than the fastest trip frames arrive, in microseconds times 16
+	uint64_t jitter_peak_usec16;
+
+	// Counts over the current stats interval
+	uint32_t stat_frames;
+	uint32_t stat_late_frames;
+	uint32_t stat_resyncs;
+} render_jitter_t;
+
+extern void render_jitter_init(render_jitter_t* jitter);
+
+/**
+ * Returns the buffer depth in microseconds for a depth setting of depth_ms milliseconds, or RENDER_JITTER_DEPTH_AUTO.
+ */
+extern uint64_t render_jitter_depth_usec(const render_jitter_t* jitter, int32_t depth_ms);
+
+/**
+ * Notes a frame with the given sender timestamp that arrived at arrival_usec (monotonic), and returns when to show it,
+ * never before it arrived.
+ */
+extern uint64_t render_jitter_frame_arrived(
+	render_jitter_t* jitter,
+	uint64_t sender_usec,
+	uint64_t arrival_usec,
+	int32_t depth_ms
+);
+
+/**
+ * Starts a new stats interval.
+ */
+extern void render_jitter_reset_stats(render_jitter_t* jitter);
+
+#endif //SPISCAPE_RENDER_JITTER_H
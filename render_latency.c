@@ -0,0 +1,61 @@
+/** \file
+ * Low-latency presentation and latency measurement.
+ */
+#include "render_latency.h"
+
+#include <string.h>
+
+#define min(a,b) ((a)<(b)?(a):(b))
+#define max(a,b) ((a)>(b)?(a):(b))
+
+void render_latency_init(render_latency_t* latency) {
+	memset(latency, 0, sizeof(render_latency_t));
+	render_latency_reset_stats(latency);
+}
+
+void render_latency_frame_arrived(render_latency_t* latency, uint64_t interval_usec, bool changed) {
+	uint64_t period_usec = latency->period_usec16 / 16;
+	uint64_t deviation_usec = interval_usec > period_usec ? interval_usec - period_usec : period_usec - interval_usec;
+	bool on_time = latency->period_usec16 > 0 && deviation_usec * 100 <= period_usec * RENDER_LATENCY_MAX_JITTER_PERCENT;
+
+	latency->confidence16 = on_time && changed
+		? min(latency->confidence16 + RENDER_LATENCY_CONFIDENCE_STEP, 0x10000u)
+		: 0;
+
+	// Follow the source's frame rate, but don't let one long pause in the stream stand for it
+	if (latency->period_usec16 == 0 || ! on_time) {
+		latency->period_usec16 = interval_usec * 16;
+	} else {
+		latency->period_usec16 = latency->period_usec16 - latency->period_usec16 / 8 + interval_usec * 2;
+	}
+}
+
+int32_t render_latency_extrapolation14(const render_latency_t* latency, uint64_t position16) {
+	// Out along the last step until the next frame is due, then back to the latest frame if it doesn't arrive
+	uint64_t ramp16 = position16 <= 0x10000
+		? position16
+		: position16 <= 0x20000 ? 0x20000 - position16 : 0;
+
+	// Q16 * Q16 to Q14, kept within what a Q2.14 weight of 1 + extrapolation can hold
+	return (int32_t) min((ramp16 * latency->confidence16) >> 18, 0x3FFFu);
+}
+
+void render_latency_presented(render_latency_t* latency, uint64_t arrival_usec, uint64_t wire_usec) {
+	if (arrival_usec == latency->presented_arrival_usec) {
+		return;
+	}
+	latency->presented_arrival_usec = arrival_usec;
+
+	uint32_t latency_usec = (uint32_t) min(wire_usec > arrival_usec ? wire_usec - arrival_usec : 0, UINT32_MAX);
+	latency->latency_sum_usec += latency_usec;
+	latency->latency_min_usec = min(latency->latency_min_usec, latency_usec);
+	latency->latency_max_usec = max(latency->latency_max_usec, latency_usec);
+	latency->latency_samples++;
+}
+
+void render_latency_reset_stats(render_latency_t* latency) {
+	latency->latency_sum_usec = 0;
+	latency->latency_min_usec = UINT32_MAX;
+	latency->latency_max_usec = 0;
+	latency->latency_samples = 0;
+}
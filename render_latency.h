@@ -0,0 +1,75 @@
+/** \file
+ * Low-latency presentation and input-to-wire latency measurement.
+ *
+ * Interpolation only reaches a frame one frame period after it arrives, cubic interpolation one more. In low-latency
+ * mode, each frame is shown as soon as it arrives instead, and the output keeps moving between frames by extrapolating
+ * along the last two. Extrapolation only pays off while frames arrive at a steady rate, so it is weighted by a
+ * confidence that ramps up with every frame arriving on time and drops to zero when one doesn't. If no frame arrives
+ * when the next one is due, the extrapolated output eases back to the latest frame over another frame period and holds
+ * it there.
+ *
+ * Whatever the mode, the latency of every frame is measured from the moment it arrives until the first output closer to
+ * it than to any frame before it has been clocked out, and summed up for the render stats.
+ */
+#ifndef SPISCAPE_RENDER_LATENCY_H
+#define SPISCAPE_RENDER_LATENCY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Confidence gained per frame arriving on time, out of 0x10000
+#define RENDER_LATENCY_CONFIDENCE_STEP 0x2000
+
+// Deviation of a frame interval from the average, as a percentage of it, above which extrapolation stops
+#define RENDER_LATENCY_MAX_JITTER_PERCENT 25
+
+typedef struct {
+	// How far to extrapolate, 0x10000 for a whole frame period at the end of one
+	uint32_t confidence16;
+
+	// Moving average of the time between frames, in microseconds times 16, or 0 before the first interval
+	uint64_t period_usec16;
+
+	// Arrival time of the frame the output last reached
+	uint64_t presented_arrival_usec;
+
+	// Latency over the current stats interval
+	uint64_t latency_sum_usec;
+	uint32_t latency_min_usec;
+	uint32_t latency_max_usec;
+	uint32_t latency_samples;
+} render_latency_t;
+
+extern void render_latency_init(render_latency_t* latency);
+
+/**
+ * Notes a new frame that arrived interval_usec after the one before it, updating the extrapolation confidence. Frames
+ * that didn't change anything give no direction to extrapolate in.
+ */
+extern void render_latency_frame_arrived(render_latency_t* latency, uint64_t interval_usec, bool changed);
+
+/**
+ * Returns how far past the latest frame to extrapolate, in Q2.14 multiples of the difference between the last two
+ * frames, at position16 frame periods after the latest frame arrived (0x10000 = 1).
+ */
+extern int32_t render_latency_extrapolation14(const render_latency_t* latency, uint64_t position16);
+
+/**
+ * Notes an output that was closest to the frame which arrived at arrival_usec, clocked out at wire_usec. Adds a
+ * latency sample the first time the output reaches a frame.
+ */
+extern void render_latency_presented(render_latency_t* latency, uint64_t arrival_usec, uint64_t wire_usec);
+
+/**
+ * Returns the average latency over the current stats interval, or 0 without samples.
+ */
+static inline uint32_t render_latency_avg_usec(const render_latency_t* latency) {
+	return latency->latency_samples > 0 ? (uint32_t) (latency->latency_sum_usec / latency->latency_samples) : 0;
+}
+
+/**
+ * Starts a new stats interval.
+ */
+extern void render_latency_reset_stats(render_latency_t* latency);
+
+#endif //SPISCAPE_RENDER_LATENCY_H
@@ -0,0 +1,364 @@
+/** \file
+ * NEON render kernel for ARMv7 and ARMv8. Bit-exact with render_pixels_scalar().
+ *
+ * On ARMv7 this file is compiled with -mfpu=neon and must only be called after checking for NEON support at runtime.
+ */
+#if defined(__arm__) || defined(__aarch64__)
+
+#include "render_simd.h"
+
+#include <stdlib.h>
+#include <arm_neon.h>
+
+/**
+ * (a*wa + b*wb) >> 8 for unsigned 16-bit lanes whose full sum fits in 24 bits.
+ */
+static inline uint16x8_t render_blend_u16(uint16x8_t a, uint16x8_t wa, uint16x8_t b, uint16x8_t wb) {
+	uint32x4_t lo = vmull_u16(vget_low_u16(a), vget_low_u16(wa));
+	uint32x4_t hi = vmull_u16(vget_high_u16(a), vget_high_u16(wa));
+
+	lo = vmlal_u16(lo, vget_low_u16(b), vget_low_u16(wb));
+	hi = vmlal_u16(hi, vget_high_u16(b), vget_high_u16(wb));
+
+	return vcombine_u16(vshrn_n_u32(lo, 8), vshrn_n_u32(hi, 8));
+}
+
+/**
+ * min((value * gain) >> 15, 0xFFFF) for unsigned 16-bit lanes.
+ */
+static inline uint16x8_t render_gain_u16(uint16x8_t value, uint16x8_t gain) {
+	uint32x4_t lo = vmull_u16(vget_low_u16(value), vget_low_u16(gain));
+	uint32x4_t hi = vmull_u16(vget_high_u16(value), vget_high_u16(gain));
+
+	return vcombine_u16(vqshrn_n_u32(lo, 15), vqshrn_n_u32(hi, 15));
+}
+
+/**
+ * Dithers eight 16-bit values down to 8 bits, updating the dithering state. Returns the output values in 16-bit lanes.
+ */
+RENDER_ALWAYS_INLINE uint16x8_t render_dither_neon(
+	const render_params_t* params,
+	uint16x8_t value,
+	int16_t* overflow,
+	int8_t* last_effect_frame,
+	const bool dithering_enabled
+) {
+	const int16x8_t zero = vdupq_n_s16(0);
+	const int16x8_t frame = vdupq_n_s16(params->dithering_frame);
+	const int16x8_t abs_frame = vdupq_n_s16((int16_t) abs(params->dithering_frame));
+	const int16x8_t max_frames = vdupq_n_s16(render_max_dither_frames16(params));
+	const int16x8_t rounding = vdupq_n_s16(0x80);
+
+	int16x8_t ovf = vld1q_s16(overflow);
+	int16x8_t last = vmovl_s8(vld1_s8(last_effect_frame));
+
+	// Reset dithering for pixels that haven't been changed by it for too long
+	int16x8_t age = vabsq_s16(vsubq_s16(vabsq_s16(last), abs_frame));
+	uint16x8_t reset = vcgtq_s16(age, max_frames);
+	ovf = vbslq_s16(reset, zero, ovf);
+	last = vbslq_s16(reset, frame, last);
+
+	// Round to 8 bits. The rounding term is in [-0xFF, 0xFF]; adding its positive and subtracting its negative part
+	// with unsigned saturation clamps the result to [0, 0xFFFF] before the shift.
+	int16x8_t dither = dithering_enabled ? vaddq_s16(ovf, rounding) : rounding;
+	uint16x8_t dither_up = vreinterpretq_u16_s16(vmaxq_s16(dither, zero));
+	uint16x8_t dither_down = vreinterpretq_u16_s16(vmaxq_s16(vnegq_s16(dither), zero));
+	uint16x8_t out = vshrq_n_u16(vqsubq_u16(vqaddq_u16(value, dither_up), dither_down), 8);
+
+	// Check for dithering effect against the undithered value, (value + 0x80) >> 8 without overflowing 16 bits
+	uint16x8_t undithered = vshrq_n_u16(vaddq_u16(vshrq_n_u16(value, 1), vdupq_n_u16(0x40)), 7);
+	last = vbslq_s16(vceqq_u16(out, undithered), last, frame);
+
+	// The residual always fits in 16 bits, so wrapping arithmetic gives the exact result
+	if (dithering_enabled) {
+		uint16x8_t residual = vsubq_u16(vaddq_u16(value, vreinterpretq_u16_s16(ovf)), vmulq_n_u16(out, 257));
+		ovf = vreinterpretq_s16_u16(residual);
+	}
+
+	vst1q_s16(overflow, ovf);
+	vst1_s8(last_effect_frame, vmovn_s16(last));
+
+	return out;
+}
+
+/**
+ * The Catmull-Rom spline through four frames at params->cubic_weights, as in render_cubic_scalar().
+ */
+static inline uint16x8_t render_cubic_u16(
+	const render_params_t* params,
+	uint8x8_t before_previous,
+	uint8x8_t previous,
+	uint8x8_t current,
+	uint8x8_t after_current
+) {
+	const int16_t* weights = params->cubic_weights;
+	int16x8_t frames[4] = {
+		vreinterpretq_s16_u16(vmovl_u8(before_previous)),
+		vreinterpretq_s16_u16(vmovl_u8(previous)),
+		vreinterpretq_s16_u16(vmovl_u8(current)),
+		vreinterpretq_s16_u16(vmovl_u8(after_current))
+	};
+
+	int32x4_t lo = vmull_n_s16(vget_low_s16(frames[0]), weights[0]);
+	int32x4_t hi = vmull_n_s16(vget_high_s16(frames[0]), weights[0]);
+	for (int i=1; i<4; i++) {
+		lo = vmlal_n_s16(lo, vget_low_s16(frames[i]), weights[i]);
+		hi = vmlal_n_s16(hi, vget_high_s16(frames[i]), weights[i]);
+	}
+
+	// Rounds and clamps to [0, 0xFFFF] while narrowing
+	uint16x8_t value = vcombine_u16(vqrshrun_n_s32(lo, 6), vqrshrun_n_s32(hi, 6));
+	return vminq_u16(value, vdupq_n_u16(0xFF00));
+}
+
+/**
+ * Interpolates and applies the LUT to a block of one channel, returning 16-bit values in value[0..1]. The planes before
+ * previous and after current are only read for cubic interpolation.
+ */
+RENDER_ALWAYS_INLINE void render_shade_neon(
+	const render_params_t* params,
+	const uint32_t* lookup,
+	const uint8_t* before_previous_plane,
+	const uint8_t* previous_plane,
+	const uint8_t* current_plane,
+	const uint8_t* after_current_plane,
+	uint16x8_t value[2],
+	const bool interpolation_enabled,
+	const bool lut_enabled,
+	const bool cubic_enabled
+) {
+	uint8x16_t previous = vld1q_u8(previous_plane);
+	uint8x16_t current = vld1q_u8(current_plane);
+
+	// Interpolate
+	if (interpolation_enabled && cubic_enabled) {
+		uint8x16_t before_previous = vld1q_u8(before_previous_plane);
+		uint8x16_t after_current = vld1q_u8(after_current_plane);
+
+		value[0] = render_cubic_u16(params,
+			vget_low_u8(before_previous), vget_low_u8(previous), vget_low_u8(current), vget_low_u8(after_current)
+		);
+		value[1] = render_cubic_u16(params,
+			vget_high_u8(before_previous), vget_high_u8(previous), vget_high_u8(current), vget_high_u8(after_current)
+		);
+	} else if (interpolation_enabled) {
+		const uint16x8_t progress = vdupq_n_u16(params->frame_progress16);
+		const uint16x8_t inv_progress = vdupq_n_u16(params->inv_frame_progress16);
+
+		value[0] = render_blend_u16(vmovl_u8(vget_low_u8(previous)), inv_progress, vmovl_u8(vget_low_u8(current)), progress);
+		value[1] = render_blend_u16(vmovl_u8(vget_high_u8(previous)), inv_progress, vmovl_u8(vget_high_u8(current)), progress);
+	} else {
+		value[0] = vshlq_n_u16(vmovl_u8(vget_low_u8(current)), 8);
+		value[1] = vshlq_n_u16(vmovl_u8(vget_high_u8(current)), 8);
+	}
+
+	// Apply LUT
+	if (lut_enabled) {
+		uint16_t values[RENDER_BLOCK_PIXELS];
+		uint16_t lower[RENDER_BLOCK_PIXELS];
+		uint16_t upper[RENDER_BLOCK_PIXELS];
+
+		vst1q_u16(&values[0], value[0]);
+		vst1q_u16(&values[8], value[1]);
+
+		for (int i=0; i<RENDER_BLOCK_PIXELS; i++) {
+			lower[i] = (uint16_t) lookup[values[i] >> 8];
+			upper[i] = (uint16_t) lookup[(values[i] >> 8) + 1];
+		}
+
+		for (int h=0; h<2; h++) {
+			uint16x8_t alpha = vandq_u16(value[h], vdupq_n_u16(0xFF));
+			uint16x8_t inv_alpha = vsubq_u16(vdupq_n_u16(0x100), alpha);
+
+			value[h] = render_blend_u16(vld1q_u16(&lower[h*8]), inv_alpha, vld1q_u16(&upper[h*8]), alpha);
+		}
+	}
+}
+
+/**
+ * Dithers a block of one channel down to 8 bits, updating its dithering state.
+ */
+RENDER_ALWAYS_INLINE void render_quantize_neon(
+	const render_params_t* params,
+	const uint16x8_t value[2],
+	int16_t* overflow_plane,
+	int8_t* last_effect_frame_plane,
+	uint8_t* out,
+	const bool dithering_enabled
+) {
+	uint16x8_t out_lo = render_dither_neon(params, value[0], &overflow_plane[0], &last_effect_frame_plane[0], dithering_enabled);
+	uint16x8_t out_hi = render_dither_neon(params, value[1], &overflow_plane[8], &last_effect_frame_plane[8], dithering_enabled);
+
+	vst1q_u8(out, vcombine_u8(vmovn_u16(out_lo), vmovn_u16(out_hi)));
+}
+
+/**
+ * Dithers a block of one channel down to 8 bits against the ordered dithering thresholds starting at thresholds.
+ */
+static inline void render_quantize_ordered_neon(const uint16x8_t value[2], const uint8_t* thresholds, uint8_t* out) {
+	uint8x16_t threshold = vld1q_u8(thresholds);
+
+	// Saturating at 0xFFFF keeps the result within 255, like the clamp of the scalar kernel
+	uint16x8_t out_lo = vshrq_n_u16(vqaddq_u16(value[0], vmovl_u8(vget_low_u8(threshold))), 8);
+	uint16x8_t out_hi = vshrq_n_u16(vqaddq_u16(value[1], vmovl_u8(vget_high_u8(threshold))), 8);
+
+	vst1q_u8(out, vcombine_u8(vmovn_u16(out_lo), vmovn_u16(out_hi)));
+}
+
+/**
+ * Splits a block of 16-bit values, already in output order, into per-pixel HDR brightness and 8-bit PWM values.
+ */
+static inline void render_hdr_neon(
+	uint16x8_t values[3][2],
+	uint8_t header[RENDER_BLOCK_PIXELS],
+	uint8_t out[3][RENDER_BLOCK_PIXELS]
+) {
+	uint16_t brightest[RENDER_BLOCK_PIXELS];
+	uint16_t scale[RENDER_BLOCK_PIXELS];
+
+	for (int h=0; h<2; h++) {
+		vst1q_u16(&brightest[h*8], vmaxq_u16(vmaxq_u16(values[0][h], values[1][h]), values[2][h]));
+	}
+
+	for (int i=0; i<RENDER_BLOCK_PIXELS; i++) {
+		uint8_t brightness = g_render_hdr_brightness[brightest[i] >> 8];
+		header[i] = (uint8_t) (0xE0 | brightness);
+		scale[i] = g_render_hdr_scale[brightness];
+	}
+
+	for (int position=0; position<3; position++) {
+		uint16x8_t pwm[2];
+
+		for (int h=0; h<2; h++) {
+			uint16x8_t scale_h = vld1q_u16(&scale[h*8]);
+			uint32x4_t lo = vmull_u16(vget_low_u16(values[position][h]), vget_low_u16(scale_h));
+			uint32x4_t hi = vmull_u16(vget_high_u16(values[position][h]), vget_high_u16(scale_h));
+
+			// (value * scale + 0x8000) >> 16
+			pwm[h] = vcombine_u16(vrshrn_n_u32(lo, 16), vrshrn_n_u32(hi, 16));
+		}
+
+		// Saturates the occasional 256 from rounding down to 255
+		vst1q_u8(out[position], vcombine_u8(vqmovn_u16(pwm[0]), vqmovn_u16(pwm[1])));
+	}
+}
+
+/**
+ * Interleaves a block's brightness bytes and output planes, already in output order, into APA102 LED frames.
+ */
+static inline void render_pack_neon(
+	uint8x16_t header,
+	uint8_t out[3][RENDER_BLOCK_PIXELS],
+	uint8_t* pixels_out
+) {
+	uint8x16x4_t frames;
+
+	frames.val[0] = header;
+	frames.val[1] = vld1q_u8(out[0]);
+	frames.val[2] = vld1q_u8(out[1]);
+	frames.val[3] = vld1q_u8(out[2]);
+
+	vst4q_u8(pixels_out, frames);
+}
+
+RENDER_ALWAYS_INLINE void render_pixels_neon_impl(
+	const render_params_t* params,
+	const render_frame_t* previous,
+	const render_frame_t* current,
+	render_dither_t* dither,
+	uint32_t first_pixel,
+	uint32_t pixel_count,
+	uint8_t* pixels_out,
+	const bool interpolation_enabled,
+	const bool lut_enabled,
+	const bool dithering_enabled,
+	const bool hdr_enabled,
+	const bool gain_enabled,
+	const bool cubic_enabled,
+	const bool ordered_enabled
+) {
+	uint32_t block_end = pixel_count - pixel_count % RENDER_BLOCK_PIXELS;
+	uint8_t out[3][RENDER_BLOCK_PIXELS];
+
+	// Only read for cubic interpolation
+	const render_frame_t* before_previous = interpolation_enabled && cubic_enabled ? params->before_previous : current;
+	const render_frame_t* after_current = interpolation_enabled && cubic_enabled ? params->after_current : current;
+
+	// Render each channel straight into its output position, so packing needs no further shuffling
+	for (uint32_t i=0; i<block_end; i += RENDER_BLOCK_PIXELS) {
+		uint32_t pixel_index = first_pixel + i;
+		uint16x8_t values[3][2];
+
+		for (int channel=0; channel<3; channel++) {
+			render_shade_neon(
+				params,
+				render_channel_lookup(params, channel),
+				&before_previous->planes[channel][pixel_index],
+				&previous->planes[channel][pixel_index],
+				&current->planes[channel][pixel_index],
+				&after_current->planes[channel][pixel_index],
+				values[params->channel_offsets[channel] - 1],
+				interpolation_enabled,
+				lut_enabled,
+				cubic_enabled
+			);
+
+			// Apply calibration gain
+			if (gain_enabled) {
+				const uint16_t* gain_plane = &params->gain->gains[channel][pixel_index];
+				uint16x8_t* value = values[params->channel_offsets[channel] - 1];
+
+				value[0] = render_gain_u16(value[0], vld1q_u16(&gain_plane[0]));
+				value[1] = render_gain_u16(value[1], vld1q_u16(&gain_plane[8]));
+			}
+		}
+
+		if (hdr_enabled) {
+			uint8_t header[RENDER_BLOCK_PIXELS];
+
+			render_hdr_neon(values, header, out);
+			render_pack_neon(vld1q_u8(header), out, &pixels_out[i*4]);
+		} else {
+			for (int channel=0; channel<3; channel++) {
+				uint32_t position = params->channel_offsets[channel] - 1u;
+
+				if (dithering_enabled && ordered_enabled) {
+					render_quantize_ordered_neon(
+						values[position],
+						&params->dither_thresholds[(pixel_index + channel) % RENDER_DITHER_PATTERN_PIXELS],
+						out[position]
+					);
+					continue;
+				}
+
+				render_quantize_neon(
+					params,
+					values[position],
+					&dither->overflow[channel][pixel_index],
+					&dither->last_effect_frame[channel][pixel_index],
+					out[position],
+					dithering_enabled
+				);
+			}
+
+			render_pack_neon(vdupq_n_u8(0xFF), out, &pixels_out[i*4]);
+		}
+	}
+
+	// Finish the partial block at the end with the reference kernel
+	render_pixels_scalar_variants[RENDER_VARIANT_INDEX(
+		interpolation_enabled, lut_enabled, dithering_enabled, hdr_enabled, gain_enabled, cubic_enabled, ordered_enabled
+	)](
+		params,
+		previous,
+		current,
+		dither,
+		first_pixel + block_end,
+		pixel_count - block_end,
+		&pixels_out[block_end*4]
+	);
+}
+
+RENDER_DEFINE_VARIANTS(render_pixels_neon, render_pixels_neon_impl)
+
+#endif
@@ -0,0 +1,129 @@
+/** \file
+ * Source frame clock recovery.
+ */
+#include "render_pll.h"
+
+#include <string.h>
+
+#define min(a,b) ((a)<(b)?(a):(b))
+#define max(a,b) ((a)>(b)?(a):(b))
+
+void render_pll_init(render_pll_t* pll) {
+	memset(pll, 0, sizeof(render_pll_t));
+}
+
+static void render_pll_restart(render_pll_t* pll, uint64_t arrival_usec, uint64_t interval_usec) {
+	pll->period_usec16 = max(interval_usec, 1) * 16;
+	pll->phase_usec = arrival_usec;
+	pll->lock_frames = 0;
+	pll->outlier_frames = 0;
+	pll->jitter_usec16 = 0;
+}
+
+void render_pll_frame_arrived(render_pll_t* pll, uint64_t arrival_usec) {
+	uint64_t interval_usec = arrival_usec > pll->arrival_usec ? arrival_usec - pll->arrival_usec : 0;
+	bool first_frame = pll->arrival_usec == 0;
+	pll->arrival_usec = arrival_usec;
+	pll->stat_frames++;
+
+	if (first_frame) {
+		pll->phase_usec = arrival_usec;
+		return;
+	}
+	if (pll->period_usec16 == 0) {
+		render_pll_restart(pll, arrival_usec, interval_usec);
+		return;
+	}
+
+	// Frames about a whole period or more late mean frames were skipped, so the timeline moves on by that many periods
+	int64_t period_usec = (int64_t) render_pll_period_usec(pll);
+	int64_t due_usec = (int64_t) pll->phase_usec + period_usec;
+	int64_t error_usec = (int64_t) arrival_usec - due_usec;
+	int64_t skipped_frames = error_usec * 100 > period_usec * (100 - RENDER_PLL_OUTLIER_PERCENT)
+		? (error_usec + period_usec / 2) / period_usec
+		: 0;
+	due_usec += skipped_frames * period_usec;
+	error_usec -= skipped_frames * period_usec;
+	pll->stat_skipped_frames += (uint32_t) skipped_frames;
+
+	int64_t abs_error_usec = error_usec < 0 ? -error_usec : error_usec;
+	bool outlier = skipped_frames > 0 || abs_error_usec * 100 > period_usec * RENDER_PLL_OUTLIER_PERCENT;
+
+	bool locked = render_pll_locked(pll);
+
+	if (outlier) {
+		// Jitter scatters outliers on both sides of the timeline, but a change of rate keeps them on one
+		bool late = error_usec > 0 || skipped_frames > 0;
+		pll->outlier_frames = pll->outlier_frames > 0 && pll->outliers_late == late ? pll->outlier_frames + 1 : 1;
+		pll->outliers_late = late;
+
+		pll->stat_outliers++;
+		if (pll->outlier_frames >= RENDER_PLL_RELOCK_FRAMES) {
+			pll->stat_relocks++;
+			render_pll_restart(pll, arrival_usec, interval_usec);
+		} else if (locked) {
+			pll->phase_usec = (uint64_t) due_usec;
+		} else {
+			pll->phase_usec = arrival_usec;
+			pll->lock_frames = 0;
+		}
+		return;
+	}
+
+	if (locked) {
+		// Phase and period corrections of an alpha-beta filter
+		pll->phase_usec = (uint64_t) (due_usec + error_usec / (1 << RENDER_PLL_PHASE_SHIFT));
+		pll->period_usec16 = (uint64_t) max(
+			(int64_t) pll->period_usec16 + error_usec * 16 / (1 << RENDER_PLL_PERIOD_SHIFT),
+			16
+		);
+	} else {
+		// Until then, follow the arrivals and average the intervals, which settles faster from a bad first interval
+		pll->phase_usec = arrival_usec;
+		pll->period_usec16 = pll->period_usec16 - pll->period_usec16 / 4 + interval_usec * 4;
+	}
+
+	pll->jitter_usec16 = pll->jitter_usec16 - pll->jitter_usec16 / 8 + (uint64_t) abs_error_usec * 2;
+	pll->lock_frames = min(pll->lock_frames + 1, RENDER_PLL_LOCK_FRAMES);
+	pll->outlier_frames = 0;
+}
+
+uint64_t render_pll_position16(const render_pll_t* pll, uint64_t now_usec) {
+	uint64_t progress_usec = now_usec > pll->phase_usec ? now_usec - pll->phase_usec : 0;
+	return (progress_usec << 16) / render_pll_period_usec(pll);
+}
+
+uint64_t render_pll_tick_nsec(const render_pll_t* pll, uint32_t refresh_rate_hz) {
+	if (refresh_rate_hz == 0) {
+		return 0;
+	}
+
+	uint64_t target_tick_nsec = 1000000000ull / refresh_rate_hz;
+	uint64_t period_nsec = pll->period_usec16 * 1000 / 16;
+	uint64_t ticks_per_frame = period_nsec / target_tick_nsec;
+
+	if (! render_pll_locked(pll) || ticks_per_frame == 0) {
+		return target_tick_nsec;
+	}
+	return period_nsec / ticks_per_frame;
+}
+
+uint64_t render_pll_next_tick_usec(const render_pll_t* pll, uint64_t tick_nsec, uint64_t now_usec) {
+	uint64_t phase_nsec = pll->phase_usec * 1000;
+	uint64_t now_nsec = now_usec * 1000;
+	if (tick_nsec == 0) {
+		return now_usec;
+	}
+	if (phase_nsec > now_nsec) {
+		return (phase_nsec - (phase_nsec - now_nsec) / tick_nsec * tick_nsec) / 1000;
+	}
+
+	return (phase_nsec + ((now_nsec - phase_nsec) / tick_nsec + 1) * tick_nsec) / 1000;
+}
+
+void render_pll_reset_stats(render_pll_t* pll) {
+	pll->stat_frames = 0;
+	pll->stat_outliers = 0;
+	pll->stat_skipped_frames = 0;
+	pll->stat_relocks = 0;
+}
@@ -0,0 +1,106 @@
+/** \file
+ * Source frame clock recovery: estimates the period and phase of the frames a client sends, so interpolation can run
+ * on a steady timeline instead of the raw arrival times of the last two frames.
+ *
+ * Every frame that arrives is compared against when the timeline says it was due. Frames within
+ * RENDER_PLL_OUTLIER_PERCENT of a period of that steer the timeline: the phase moves part of the way towards the
+ * arrival and the period takes up a smaller part of the error, so a steady drift in the source's clock is followed
+ * while network jitter averages out. Frames that arrive about a whole period or more late mean the source skipped
+ * frames or paused, and the timeline moves ahead by that many periods. Any other frame is an outlier: it is placed on
+ * the timeline where it was due, and doesn't steer it. If RENDER_PLL_RELOCK_FRAMES outliers in a row all arrive early,
+ * or all late, the source has changed its rate, and the estimator starts over from the latest interval.
+ *
+ * Until it locks, the estimator follows the arrivals and averages the intervals, much like interpolating between raw
+ * arrival times but without a single late frame stretching the next window.
+ *
+ * Once locked, the render clock also follows the source, ticking a whole number of times per source frame so every
+ * frame is blended over the same steps.
+ */
+#ifndef SPISCAPE_RENDER_PLL_H
+#define SPISCAPE_RENDER_PLL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Deviation from the timeline, as a percentage of the period, above which a frame is an outlier
+#define RENDER_PLL_OUTLIER_PERCENT 25
+
+// Frames on the timeline until the estimate is locked
+#define RENDER_PLL_LOCK_FRAMES 8
+
+// Outliers in a row on the same side of the timeline after which the estimator starts over
+#define RENDER_PLL_RELOCK_FRAMES 4
+
+// How much of the error steers the phase and the period once locked, as right shifts
+#define RENDER_PLL_PHASE_SHIFT 2
+#define RENDER_PLL_PERIOD_SHIFT 5
+
+// Change in the render clock's tick, in tenths of a percent, below which the clock isn't reprogrammed
+#define RENDER_PLL_TICK_TOLERANCE_PERMILLE 5
+
+typedef struct {
+	// Estimated source frame period, in microseconds times 16, or 0 before the second frame
+	uint64_t period_usec16;
+
+	// Where the timeline puts the latest frame, and when it actually arrived, in monotonic microseconds
+	uint64_t phase_usec;
+	uint64_t arrival_usec;
+
+	// Frames on the timeline since the estimator last started over, up to RENDER_PLL_LOCK_FRAMES
+	uint32_t lock_frames;
+
+	// Outliers in a row on the same side of the timeline, and which side
+	uint32_t outlier_frames;
+	bool outliers_late;
+
+	// Moving average of how far frames on the timeline arrive from it, in microseconds times 16
+	uint64_t jitter_usec16;
+
+	// Counts over the current stats interval
+	uint32_t stat_frames;
+	uint32_t stat_outliers;
+	uint32_t stat_skipped_frames;
+	uint32_t stat_relocks;
+} render_pll_t;
+
+extern void render_pll_init(render_pll_t* pll);
+
+/**
+ * Notes a new frame that arrived at arrival_usec, moving the timeline on to it.
+ */
+extern void render_pll_frame_arrived(render_pll_t* pll, uint64_t arrival_usec);
+
+static inline bool render_pll_locked(const render_pll_t* pll) {
+	return pll->lock_frames >= RENDER_PLL_LOCK_FRAMES;
+}
+
+static inline uint64_t render_pll_period_usec(const render_pll_t* pll) {
+	uint64_t period_usec = pll->period_usec16 / 16;
+	return period_usec > 0 ? period_usec : 1;
+}
+
+/**
+ * Returns how far the timeline is past the latest frame at now_usec, in frame periods (0x10000 = 1). A frame placed
+ * ahead of its arrival isn't due yet, and is at 0 until it is.
+ */
+extern uint64_t render_pll_position16(const render_pll_t* pll, uint64_t now_usec);
+
+/**
+ * Returns the render clock tick, in nanoseconds, for a target of refresh_rate_hz: the longest tick that divides the
+ * source frame period evenly and is no faster than the target, once locked; 1 / refresh_rate_hz otherwise; or 0 for
+ * no clock.
+ */
+extern uint64_t render_pll_tick_nsec(const render_pll_t* pll, uint32_t refresh_rate_hz);
+
+/**
+ * Returns the next time after now_usec, in monotonic microseconds, at which a render clock with the given tick lines up
+ * with the timeline.
+ */
+extern uint64_t render_pll_next_tick_usec(const render_pll_t* pll, uint64_t tick_nsec, uint64_t now_usec);
+
+/**
+ * Starts a new stats interval.
+ */
+extern void render_pll_reset_stats(render_pll_t* pll);
+
+#endif //SPISCAPE_RENDER_PLL_H
@@ -0,0 +1,232 @@
+/** \file
+ * Render worker pool.
+ */
+#include "render_pool.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define min(a,b) ((a)<(b)?(a):(b))
+#define max(a,b) ((a)>(b)?(a):(b))
+
+typedef struct {
+	render_pool_t* pool;
+	uint32_t index;
+	pthread_t handle;
+} render_pool_worker_t;
+
+struct render_pool {
+	uint32_t thread_count;
+	bool auto_thread_count;
+
+	// Workers 1..thread_count-1; the calling thread is worker 0
+	render_pool_worker_t workers[RENDER_POOL_MAX_THREADS];
+
+	pthread_mutex_t mutex;
+	pthread_cond_t start_cond;
+	pthread_cond_t done_cond;
+
+	// Incremented for every frame handed to the workers
+	uint64_t generation;
+	uint32_t pending_count;
+	bool stopping;
+
+	// The frame being rendered; only changed while no workers are pending
+	render_pixels_fn render_pixels;
+	const render_params_t* params;
+	const render_frame_t* previous;
+	const render_frame_t* current;
+	render_dither_t* dither;
+	const render_range_t* ranges;
+	uint32_t range_count;
+
+	uint32_t active_count;
+	uint32_t segment_bounds[RENDER_POOL_MAX_THREADS + 1];
+};
+
+/**
+ * Renders pixels [segment_start, segment_end) of the concatenated ranges.
+ */
+static void render_pool_render_segment(render_pool_t* pool, uint32_t segment_start, uint32_t segment_end) {
+	uint32_t range_start = 0;
+
+	for (uint32_t i=0; i<pool->range_count && range_start < segment_end; i++) {
+		const render_range_t* range = &pool->ranges[i];
+		uint32_t range_end = range_start + range->pixel_count;
+		uint32_t start = max(segment_start, range_start);
+		uint32_t end = min(segment_end, range_end);
+
+		if (start < end) {
+			pool->render_pixels(
+				pool->params,
+				pool->previous,
+				pool->current,
+				pool->dither,
+				range->first_pixel + (start - range_start),
+				end - start,
+				range->pixels_out + (start - range_start) * range->bytes_per_led
+			);
+		}
+
+		range_start = range_end;
+	}
+}
+
+static void* render_pool_worker_thread(void* worker_data) {
+	render_pool_worker_t* worker = worker_data;
+	render_pool_t* pool = worker->pool;
+	uint64_t seen_generation = 0;
+
+	pthread_mutex_lock(&pool->mutex);
+
+	while (true) {
+		while (! pool->stopping && pool->generation == seen_generation) {
+			pthread_cond_wait(&pool->start_cond, &pool->mutex);
+		}
+
+		if (pool->stopping) {
+			break;
+		}
+
+		seen_generation = pool->generation;
+
+		if (worker->index >= pool->active_count) {
+			continue;
+		}
+
+		uint32_t segment_start = pool->segment_bounds[worker->index];
+		uint32_t segment_end = pool->segment_bounds[worker->index + 1];
+
+		pthread_mutex_unlock(&pool->mutex);
+		render_pool_render_segment(pool, segment_start, segment_end);
+		pthread_mutex_lock(&pool->mutex);
+
+		if (--pool->pending_count == 0) {
+			pthread_cond_signal(&pool->done_cond);
+		}
+	}
+
+	pthread_mutex_unlock(&pool->mutex);
+
+	return NULL;
+}
+
+render_pool_t* render_pool_create(uint32_t thread_count) {
+	render_pool_t* pool = calloc(1, sizeof(render_pool_t));
+	if (pool == NULL) {
+		return NULL;
+	}
+
+	pool->auto_thread_count = thread_count == 0;
+	if (pool->auto_thread_count) {
+		long cpu_count = sysconf(_SC_NPROCESSORS_ONLN);
+		thread_count = cpu_count > 0 ? (uint32_t) cpu_count : 1;
+	}
+
+	pool->thread_count = min(thread_count, RENDER_POOL_MAX_THREADS);
+
+	pthread_mutex_init(&pool->mutex, NULL);
+	pthread_cond_init(&pool->start_cond, NULL);
+	pthread_cond_init(&pool->done_cond, NULL);
+
+	for (uint32_t i=1; i<pool->thread_count; i++) {
+		render_pool_worker_t* worker = &pool->workers[i];
+		worker->pool = pool;
+		worker->index = i;
+
+		int error = pthread_create(&worker->handle, NULL, render_pool_worker_thread, worker);
+		if (error != 0) {
+			fprintf(stderr, "[render] Failed to start render worker %u; using %u threads\n", i, i);
+			pool->thread_count = i;
+			break;
+		}
+	}
+
+	return pool;
+}
+
+void render_pool_destroy(render_pool_t* pool) {
+	if (pool == NULL) {
+		return;
+	}
+
+	pthread_mutex_lock(&pool->mutex);
+	pool->stopping = true;
+	pthread_cond_broadcast(&pool->start_cond);
+	pthread_mutex_unlock(&pool->mutex);
+
+	for (uint32_t i=1; i<pool->thread_count; i++) {
+		pthread_join(pool->workers[i].handle, NULL);
+	}
+
+	pthread_mutex_destroy(&pool->mutex);
+	pthread_cond_destroy(&pool->start_cond);
+	pthread_cond_destroy(&pool->done_cond);
+
+	free(pool);
+}
+
+uint32_t render_pool_thread_count(const render_pool_t* pool) {
+	return pool->thread_count;
+}
+
+void render_pool_render(
+	render_pool_t* pool,
+	render_pixels_fn render_pixels,
+	const render_params_t* params,
+	const render_frame_t* previous,
+	const render_frame_t* current,
+	render_dither_t* dither,
+	const render_range_t* ranges,
+	uint32_t range_count
+) {
+	uint32_t total_pixels = 0;
+	for (uint32_t i=0; i<range_count; i++) {
+		total_pixels += ranges[i].pixel_count;
+	}
+
+	// Don't split below the auto threshold, or below one segment per thread when the thread count is explicit
+	uint32_t active_count = pool->auto_thread_count
+		? total_pixels / RENDER_POOL_MIN_PIXELS_PER_THREAD
+		: total_pixels / RENDER_POOL_SEGMENT_ALIGN_PIXELS;
+	active_count = max(1, min(active_count, pool->thread_count));
+
+	pool->render_pixels = render_pixels;
+	pool->params = params;
+	pool->previous = previous;
+	pool->current = current;
+	pool->dither = dither;
+	pool->ranges = ranges;
+	pool->range_count = range_count;
+
+	if (active_count == 1) {
+		render_pool_render_segment(pool, 0, total_pixels);
+		return;
+	}
+
+	pthread_mutex_lock(&pool->mutex);
+
+	pool->active_count = active_count;
+	pool->segment_bounds[0] = 0;
+	for (uint32_t i=1; i<active_count; i++) {
+		uint32_t bound = (uint32_t) ((uint64_t) total_pixels * i / active_count);
+		pool->segment_bounds[i] = bound - bound % RENDER_POOL_SEGMENT_ALIGN_PIXELS;
+	}
+	pool->segment_bounds[active_count] = total_pixels;
+
+	pool->pending_count = active_count - 1;
+	pool->generation++;
+	pthread_cond_broadcast(&pool->start_cond);
+
+	pthread_mutex_unlock(&pool->mutex);
+
+	render_pool_render_segment(pool, pool->segment_bounds[0], pool->segment_bounds[1]);
+
+	pthread_mutex_lock(&pool->mutex);
+	while (pool->pending_count > 0) {
+		pthread_cond_wait(&pool->done_cond, &pool->mutex);
+	}
+	pthread_mutex_unlock(&pool->mutex);
+}
@@ -0,0 +1,68 @@
+/** \file
+ * Render worker pool: renders one frame on several cores at once.
+ *
+ * A frame is rendered as a list of ranges, one per strip, each with its own output buffer. The pool splits the total
+ * pixel count into one contiguous segment per thread, so a segment covers whole strips when there are many strips and
+ * a slice of a strip when there are few. Segment boundaries are multiples of RENDER_POOL_SEGMENT_ALIGN_PIXELS, so for
+ * ranges that cover the frame in order, no two threads write to the same cache line of the dithering planes.
+ *
+ * The calling thread renders the first segment itself, then waits for the workers to finish theirs.
+ */
+#ifndef SPISCAPE_RENDER_POOL_H
+#define SPISCAPE_RENDER_POOL_H
+
+#include "render.h"
+
+// In auto mode, each thread gets at least this many pixels; smaller frames are rendered on the calling thread alone,
+// since waking the workers would cost more than it saves.
+#define RENDER_POOL_MIN_PIXELS_PER_THREAD 2048
+
+// Segment boundaries are multiples of this many pixels: one cache line of an 8-bit plane
+#define RENDER_POOL_SEGMENT_ALIGN_PIXELS RENDER_CACHE_LINE_BYTES
+
+#define RENDER_POOL_MAX_THREADS 16
+
+/**
+ * A run of consecutive pixels and the output for its first pixel, where the kernel writes bytes_per_led bytes per
+ * pixel: 4 for APA102 LED frames, RENDER_WIDE_BYTES_PER_LED for g_render_wide_kernel.
+ */
+typedef struct {
+	uint32_t first_pixel;
+	uint32_t pixel_count;
+	uint8_t* pixels_out;
+	uint32_t bytes_per_led;
+} render_range_t;
+
+typedef struct render_pool render_pool_t;
+
+/**
+ * Creates a pool that renders on up to thread_count threads, including the calling thread. A thread_count of 0 sizes
+ * the pool to the number of online CPUs and only uses more than one thread for large frames. Returns NULL on failure.
+ */
+extern render_pool_t* render_pool_create(uint32_t thread_count);
+
+/**
+ * Stops and joins the pool's worker threads.
+ */
+extern void render_pool_destroy(render_pool_t* pool);
+
+/**
+ * Returns the number of threads, including the calling thread, the pool could use.
+ */
+extern uint32_t render_pool_thread_count(const render_pool_t* pool);
+
+/**
+ * Renders the given ranges with the given kernel variant, returning once all of them have been written.
+ */
+extern void render_pool_render(
+	render_pool_t* pool,
+	render_pixels_fn render_pixels,
+	const render_params_t* params,
+	const render_frame_t* previous,
+	const render_frame_t* current,
+	render_dither_t* dither,
+	const render_range_t* ranges,
+	uint32_t range_count
+);
+
+#endif //SPISCAPE_RENDER_POOL_H
@@ -0,0 +1,22 @@
+/** \file
+ * Definitions shared by the vectorized render kernels.
+ *
+ * Vectorized kernels work on blocks of RENDER_BLOCK_PIXELS pixels, one channel plane at a time, and leave any partial
+ * block at the end of a range to the scalar reference kernel.
+ */
+#ifndef SPISCAPE_RENDER_SIMD_H
+#define SPISCAPE_RENDER_SIMD_H
+
+#include "render.h"
+
+#define RENDER_BLOCK_PIXELS 16
+
+static inline const uint32_t* render_channel_lookup(const render_params_t* params, int channel) {
+	return channel == 0 ? params->red_lookup : channel == 1 ? params->green_lookup : params->blue_lookup;
+}
+
+static inline int16_t render_max_dither_frames16(const render_params_t* params) {
+	return (int16_t) (params->max_dither_frames > INT16_MAX ? INT16_MAX : params->max_dither_frames);
+}
+
+#endif //SPISCAPE_RENDER_SIMD_H
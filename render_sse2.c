@@ -0,0 +1,413 @@
+/** \file
+ * SSE2 render kernel. Bit-exact with render_pixels_scalar().
+ */
+#if defined(__x86_64__) || defined(__i386__)
+
+#include "render_simd.h"
+
+#include <stdlib.h>
+#include <emmintrin.h>
+
+/**
+ * (a*wa + b*wb) >> 8 for unsigned 16-bit lanes whose full sum fits in 24 bits.
+ */
+static inline __m128i render_blend_epu16(__m128i a, __m128i wa, __m128i b, __m128i wb) {
+	const __m128i bias = _mm_set1_epi16((int16_t) 0x8000);
+
+	__m128i lo_a = _mm_mullo_epi16(a, wa);
+	__m128i hi_a = _mm_mulhi_epu16(a, wa);
+	__m128i lo_b = _mm_mullo_epi16(b, wb);
+	__m128i hi_b = _mm_mulhi_epu16(b, wb);
+
+	// Add the 32-bit products as 16-bit halves, carrying from the low half when it wraps
+	__m128i lo = _mm_add_epi16(lo_a, lo_b);
+	__m128i carry = _mm_cmpgt_epi16(_mm_xor_si128(lo_a, bias), _mm_xor_si128(lo, bias));
+	__m128i hi = _mm_sub_epi16(_mm_add_epi16(hi_a, hi_b), carry);
+
+	return _mm_or_si128(_mm_slli_epi16(hi, 8), _mm_srli_epi16(lo, 8));
+}
+
+/**
+ * min((value * gain) >> 15, 0xFFFF) for unsigned 16-bit lanes.
+ */
+static inline __m128i render_gain_epu16(__m128i value, __m128i gain) {
+	__m128i hi = _mm_mulhi_epu16(value, gain);
+	__m128i lo = _mm_mullo_epi16(value, gain);
+
+	// The top bit of the high half shifts out exactly when the result overflows, and saturates it instead
+	__m128i scaled = _mm_or_si128(_mm_slli_epi16(hi, 1), _mm_srli_epi16(lo, 15));
+	return _mm_or_si128(scaled, _mm_srai_epi16(hi, 15));
+}
+
+static inline __m128i render_select_epi16(__m128i mask, __m128i if_set, __m128i if_clear) {
+	return _mm_or_si128(_mm_and_si128(mask, if_set), _mm_andnot_si128(mask, if_clear));
+}
+
+static inline __m128i render_abs_epi16(__m128i value) {
+	return _mm_max_epi16(value, _mm_sub_epi16(_mm_setzero_si128(), value));
+}
+
+/**
+ * Dithers eight 16-bit values down to 8 bits, updating the dithering state. Returns the output values in 16-bit lanes.
+ */
+RENDER_ALWAYS_INLINE __m128i render_dither_sse2(
+	const render_params_t* params,
+	__m128i value,
+	__m128i* overflow,
+	__m128i* last_effect_frame,
+	const bool dithering_enabled
+) {
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i frame = _mm_set1_epi16(params->dithering_frame);
+	const __m128i abs_frame = _mm_set1_epi16((int16_t) abs(params->dithering_frame));
+	const __m128i max_frames = _mm_set1_epi16(render_max_dither_frames16(params));
+	const __m128i rounding = _mm_set1_epi16(0x80);
+
+	__m128i ovf = *overflow;
+	__m128i last = *last_effect_frame;
+
+	// Reset dithering for pixels that haven't been changed by it for too long
+	__m128i age = render_abs_epi16(_mm_sub_epi16(render_abs_epi16(last), abs_frame));
+	__m128i reset = _mm_cmpgt_epi16(age, max_frames);
+	ovf = _mm_andnot_si128(reset, ovf);
+	last = render_select_epi16(reset, frame, last);
+
+	// Round to 8 bits. The rounding term is in [-0xFF, 0xFF]; adding its positive and subtracting its negative part
+	// with unsigned saturation clamps the result to [0, 0xFFFF] before the shift.
+	__m128i dither = dithering_enabled ? _mm_add_epi16(ovf, rounding) : rounding;
+	__m128i dither_up = _mm_max_epi16(dither, zero);
+	__m128i dither_down = _mm_max_epi16(_mm_sub_epi16(zero, dither), zero);
+	__m128i out = _mm_srli_epi16(_mm_subs_epu16(_mm_adds_epu16(value, dither_up), dither_down), 8);
+
+	// Check for dithering effect against the undithered value, (value + 0x80) >> 8 without overflowing 16 bits
+	__m128i undithered = _mm_srli_epi16(_mm_add_epi16(_mm_srli_epi16(value, 1), _mm_set1_epi16(0x40)), 7);
+	last = render_select_epi16(_mm_cmpeq_epi16(out, undithered), last, frame);
+
+	// The residual always fits in 16 bits, so wrapping arithmetic gives the exact result
+	if (dithering_enabled) {
+		ovf = _mm_sub_epi16(_mm_add_epi16(value, ovf), _mm_mullo_epi16(out, _mm_set1_epi16(257)));
+	}
+
+	*overflow = ovf;
+	*last_effect_frame = last;
+
+	return out;
+}
+
+/**
+ * The Catmull-Rom spline through four frames at params->cubic_weights, as in render_cubic_scalar().
+ */
+static inline __m128i render_cubic_epu16(
+	const render_params_t* params,
+	__m128i before_previous,
+	__m128i previous,
+	__m128i current,
+	__m128i after_current
+) {
+	const int16_t* weights = params->cubic_weights;
+	const __m128i weights01 = _mm_set1_epi32((int32_t) ((uint16_t) weights[0] | (uint32_t) (uint16_t) weights[1] << 16));
+	const __m128i weights23 = _mm_set1_epi32((int32_t) ((uint16_t) weights[2] | (uint32_t) (uint16_t) weights[3] << 16));
+
+	// Rounds, and moves the result down by 0x8000 so that packing with signed saturation clamps it to [0, 0xFFFF]
+	const __m128i bias = _mm_set1_epi32(32 - (0x8000 << 6));
+	const __m128i max_value = _mm_set1_epi16((int16_t) 0xFF00);
+
+	// Each pixel's four weighted values, added up in 32 bits as two pairs of 16-bit products
+	__m128i lo = _mm_add_epi32(
+		_mm_madd_epi16(_mm_unpacklo_epi16(before_previous, previous), weights01),
+		_mm_madd_epi16(_mm_unpacklo_epi16(current, after_current), weights23)
+	);
+	__m128i hi = _mm_add_epi32(
+		_mm_madd_epi16(_mm_unpackhi_epi16(before_previous, previous), weights01),
+		_mm_madd_epi16(_mm_unpackhi_epi16(current, after_current), weights23)
+	);
+
+	lo = _mm_srai_epi32(_mm_add_epi32(lo, bias), 6);
+	hi = _mm_srai_epi32(_mm_add_epi32(hi, bias), 6);
+
+	// SSE2 has no unsigned 16-bit min; min(a, b) = a - (a -sat b)
+	__m128i value = _mm_xor_si128(_mm_packs_epi32(lo, hi), _mm_set1_epi16((int16_t) 0x8000));
+	return _mm_sub_epi16(value, _mm_subs_epu16(value, max_value));
+}
+
+/**
+ * Interpolates and applies the LUT to a block of one channel, returning 16-bit values in value[0..1]. The planes before
+ * previous and after current are only read for cubic interpolation.
+ */
+RENDER_ALWAYS_INLINE void render_shade_sse2(
+	const render_params_t* params,
+	const uint32_t* lookup,
+	const uint8_t* before_previous_plane,
+	const uint8_t* previous_plane,
+	const uint8_t* current_plane,
+	const uint8_t* after_current_plane,
+	__m128i value[2],
+	const bool interpolation_enabled,
+	const bool lut_enabled,
+	const bool cubic_enabled
+) {
+	const __m128i zero = _mm_setzero_si128();
+
+	__m128i previous = _mm_loadu_si128((const __m128i*) previous_plane);
+	__m128i current = _mm_loadu_si128((const __m128i*) current_plane);
+
+	// Interpolate
+	if (interpolation_enabled && cubic_enabled) {
+		__m128i before_previous = _mm_loadu_si128((const __m128i*) before_previous_plane);
+		__m128i after_current = _mm_loadu_si128((const __m128i*) after_current_plane);
+
+		value[0] = render_cubic_epu16(params,
+			_mm_unpacklo_epi8(before_previous, zero), _mm_unpacklo_epi8(previous, zero),
+			_mm_unpacklo_epi8(current, zero), _mm_unpacklo_epi8(after_current, zero)
+		);
+		value[1] = render_cubic_epu16(params,
+			_mm_unpackhi_epi8(before_previous, zero), _mm_unpackhi_epi8(previous, zero),
+			_mm_unpackhi_epi8(current, zero), _mm_unpackhi_epi8(after_current, zero)
+		);
+	} else if (interpolation_enabled) {
+		const __m128i progress = _mm_set1_epi16((int16_t) params->frame_progress16);
+		const __m128i inv_progress = _mm_set1_epi16((int16_t) params->inv_frame_progress16);
+
+		value[0] = render_blend_epu16(_mm_unpacklo_epi8(previous, zero), inv_progress, _mm_unpacklo_epi8(current, zero), progress);
+		value[1] = render_blend_epu16(_mm_unpackhi_epi8(previous, zero), inv_progress, _mm_unpackhi_epi8(current, zero), progress);
+	} else {
+		value[0] = _mm_unpacklo_epi8(zero, current);
+		value[1] = _mm_unpackhi_epi8(zero, current);
+	}
+
+	// Apply LUT
+	if (lut_enabled) {
+		uint16_t values[RENDER_BLOCK_PIXELS] __attribute__((aligned(16)));
+		uint16_t lower[RENDER_BLOCK_PIXELS] __attribute__((aligned(16)));
+		uint16_t upper[RENDER_BLOCK_PIXELS] __attribute__((aligned(16)));
+
+		_mm_store_si128((__m128i*) &values[0], value[0]);
+		_mm_store_si128((__m128i*) &values[8], value[1]);
+
+		for (int i=0; i<RENDER_BLOCK_PIXELS; i++) {
+			lower[i] = (uint16_t) lookup[values[i] >> 8];
+			upper[i] = (uint16_t) lookup[(values[i] >> 8) + 1];
+		}
+
+		for (int h=0; h<2; h++) {
+			__m128i alpha = _mm_and_si128(value[h], _mm_set1_epi16(0xFF));
+			__m128i inv_alpha = _mm_sub_epi16(_mm_set1_epi16(0x100), alpha);
+
+			value[h] = render_blend_epu16(
+				_mm_load_si128((const __m128i*) &lower[h*8]), inv_alpha,
+				_mm_load_si128((const __m128i*) &upper[h*8]), alpha
+			);
+		}
+	}
+}
+
+/**
+ * Dithers a block of one channel down to 8 bits, updating its dithering state.
+ */
+RENDER_ALWAYS_INLINE void render_quantize_sse2(
+	const render_params_t* params,
+	const __m128i value[2],
+	int16_t* overflow_plane,
+	int8_t* last_effect_frame_plane,
+	uint8_t* out,
+	const bool dithering_enabled
+) {
+	// Dither, widening the 8-bit last effect frames to 16-bit lanes
+	__m128i last8 = _mm_loadu_si128((const __m128i*) last_effect_frame_plane);
+	__m128i overflow[2] = {
+		_mm_loadu_si128((const __m128i*) &overflow_plane[0]),
+		_mm_loadu_si128((const __m128i*) &overflow_plane[8])
+	};
+	__m128i last_effect_frame[2] = {
+		_mm_srai_epi16(_mm_unpacklo_epi8(last8, last8), 8),
+		_mm_srai_epi16(_mm_unpackhi_epi8(last8, last8), 8)
+	};
+
+	__m128i out_lo = render_dither_sse2(params, value[0], &overflow[0], &last_effect_frame[0], dithering_enabled);
+	__m128i out_hi = render_dither_sse2(params, value[1], &overflow[1], &last_effect_frame[1], dithering_enabled);
+
+	_mm_storeu_si128((__m128i*) &overflow_plane[0], overflow[0]);
+	_mm_storeu_si128((__m128i*) &overflow_plane[8], overflow[1]);
+	_mm_storeu_si128((__m128i*) last_effect_frame_plane, _mm_packs_epi16(last_effect_frame[0], last_effect_frame[1]));
+
+	_mm_store_si128((__m128i*) out, _mm_packus_epi16(out_lo, out_hi));
+}
+
+/**
+ * Dithers a block of one channel down to 8 bits against the ordered dithering thresholds starting at thresholds.
+ */
+static inline void render_quantize_ordered_sse2(const __m128i value[2], const uint8_t* thresholds, uint8_t* out) {
+	const __m128i zero = _mm_setzero_si128();
+	__m128i threshold = _mm_loadu_si128((const __m128i*) thresholds);
+
+	// Saturating at 0xFFFF keeps the result within 255, like the clamp of the scalar kernel
+	__m128i out_lo = _mm_srli_epi16(_mm_adds_epu16(value[0], _mm_unpacklo_epi8(threshold, zero)), 8);
+	__m128i out_hi = _mm_srli_epi16(_mm_adds_epu16(value[1], _mm_unpackhi_epi8(threshold, zero)), 8);
+
+	_mm_store_si128((__m128i*) out, _mm_packus_epi16(out_lo, out_hi));
+}
+
+/**
+ * Splits a block of 16-bit values, already in output order, into per-pixel HDR brightness and 8-bit PWM values.
+ */
+static inline void render_hdr_sse2(
+	__m128i values[3][2],
+	uint8_t header[RENDER_BLOCK_PIXELS],
+	uint8_t out[3][RENDER_BLOCK_PIXELS]
+) {
+	uint16_t brightest[RENDER_BLOCK_PIXELS] __attribute__((aligned(16)));
+	uint16_t scale[RENDER_BLOCK_PIXELS] __attribute__((aligned(16)));
+
+	// SSE2 has no unsigned 16-bit max; max(a, b) = (a -sat b) + b
+	for (int h=0; h<2; h++) {
+		__m128i brightest_h = _mm_adds_epu16(_mm_subs_epu16(values[0][h], values[1][h]), values[1][h]);
+		brightest_h = _mm_adds_epu16(_mm_subs_epu16(brightest_h, values[2][h]), values[2][h]);
+		_mm_store_si128((__m128i*) &brightest[h*8], brightest_h);
+	}
+
+	for (int i=0; i<RENDER_BLOCK_PIXELS; i++) {
+		uint8_t brightness = g_render_hdr_brightness[brightest[i] >> 8];
+		header[i] = (uint8_t) (0xE0 | brightness);
+		scale[i] = g_render_hdr_scale[brightness];
+	}
+
+	for (int position=0; position<3; position++) {
+		__m128i pwm[2];
+
+		for (int h=0; h<2; h++) {
+			// (value * scale + 0x8000) >> 16: the rounding carries exactly when bit 15 of the low half is set
+			__m128i scale_h = _mm_load_si128((const __m128i*) &scale[h*8]);
+			__m128i high = _mm_mulhi_epu16(values[position][h], scale_h);
+			__m128i round = _mm_srli_epi16(_mm_mullo_epi16(values[position][h], scale_h), 15);
+			pwm[h] = _mm_add_epi16(high, round);
+		}
+
+		// Saturates the occasional 256 from rounding down to 255
+		_mm_store_si128((__m128i*) out[position], _mm_packus_epi16(pwm[0], pwm[1]));
+	}
+}
+
+/**
+ * Interleaves a block's brightness bytes and output planes, already in output order, into APA102 LED frames.
+ */
+static inline void render_pack_sse2(
+	__m128i header,
+	uint8_t out[3][RENDER_BLOCK_PIXELS],
+	uint8_t* pixels_out
+) {
+	__m128i first = _mm_load_si128((const __m128i*) out[0]);
+	__m128i second = _mm_load_si128((const __m128i*) out[1]);
+	__m128i third = _mm_load_si128((const __m128i*) out[2]);
+
+	__m128i header_first_lo = _mm_unpacklo_epi8(header, first);
+	__m128i header_first_hi = _mm_unpackhi_epi8(header, first);
+	__m128i second_third_lo = _mm_unpacklo_epi8(second, third);
+	__m128i second_third_hi = _mm_unpackhi_epi8(second, third);
+
+	_mm_storeu_si128((__m128i*) &pixels_out[0], _mm_unpacklo_epi16(header_first_lo, second_third_lo));
+	_mm_storeu_si128((__m128i*) &pixels_out[16], _mm_unpackhi_epi16(header_first_lo, second_third_lo));
+	_mm_storeu_si128((__m128i*) &pixels_out[32], _mm_unpacklo_epi16(header_first_hi, second_third_hi));
+	_mm_storeu_si128((__m128i*) &pixels_out[48], _mm_unpackhi_epi16(header_first_hi, second_third_hi));
+}
+
+RENDER_ALWAYS_INLINE void render_pixels_sse2_impl(
+	const render_params_t* params,
+	const render_frame_t* previous,
+	const render_frame_t* current,
+	render_dither_t* dither,
+	uint32_t first_pixel,
+	uint32_t pixel_count,
+	uint8_t* pixels_out,
+	const bool interpolation_enabled,
+	const bool lut_enabled,
+	const bool dithering_enabled,
+	const bool hdr_enabled,
+	const bool gain_enabled,
+	const bool cubic_enabled,
+	const bool ordered_enabled
+) {
+	uint32_t block_end = pixel_count - pixel_count % RENDER_BLOCK_PIXELS;
+	uint8_t out[3][RENDER_BLOCK_PIXELS] __attribute__((aligned(16)));
+
+	// Only read for cubic interpolation
+	const render_frame_t* before_previous = interpolation_enabled && cubic_enabled ? params->before_previous : current;
+	const render_frame_t* after_current = interpolation_enabled && cubic_enabled ? params->after_current : current;
+
+	// Render each channel straight into its output position, so packing needs no further shuffling
+	for (uint32_t i=0; i<block_end; i += RENDER_BLOCK_PIXELS) {
+		uint32_t pixel_index = first_pixel + i;
+		__m128i values[3][2];
+
+		for (int channel=0; channel<3; channel++) {
+			render_shade_sse2(
+				params,
+				render_channel_lookup(params, channel),
+				&before_previous->planes[channel][pixel_index],
+				&previous->planes[channel][pixel_index],
+				&current->planes[channel][pixel_index],
+				&after_current->planes[channel][pixel_index],
+				values[params->channel_offsets[channel] - 1],
+				interpolation_enabled,
+				lut_enabled,
+				cubic_enabled
+			);
+
+			// Apply calibration gain
+			if (gain_enabled) {
+				const uint16_t* gain_plane = &params->gain->gains[channel][pixel_index];
+				__m128i* value = values[params->channel_offsets[channel] - 1];
+
+				value[0] = render_gain_epu16(value[0], _mm_loadu_si128((const __m128i*) &gain_plane[0]));
+				value[1] = render_gain_epu16(value[1], _mm_loadu_si128((const __m128i*) &gain_plane[8]));
+			}
+		}
+
+		if (hdr_enabled) {
+			uint8_t header[RENDER_BLOCK_PIXELS] __attribute__((aligned(16)));
+
+			render_hdr_sse2(values, header, out);
+			render_pack_sse2(_mm_load_si128((const __m128i*) header), out, &pixels_out[i*4]);
+		} else {
+			for (int channel=0; channel<3; channel++) {
+				uint32_t position = params->channel_offsets[channel] - 1u;
+
+				if (dithering_enabled && ordered_enabled) {
+					render_quantize_ordered_sse2(
+						values[position],
+						&params->dither_thresholds[(pixel_index + channel) % RENDER_DITHER_PATTERN_PIXELS],
+						out[position]
+					);
+					continue;
+				}
+
+				render_quantize_sse2(
+					params,
+					values[position],
+					&dither->overflow[channel][pixel_index],
+					&dither->last_effect_frame[channel][pixel_index],
+					out[position],
+					dithering_enabled
+				);
+			}
+
+			render_pack_sse2(_mm_set1_epi8((char) 0xFF), out, &pixels_out[i*4]);
+		}
+	}
+
+	// Finish the partial block at the end with the reference kernel
+	render_pixels_scalar_variants[RENDER_VARIANT_INDEX(
+		interpolation_enabled, lut_enabled, dithering_enabled, hdr_enabled, gain_enabled, cubic_enabled, ordered_enabled
+	)](
+		params,
+		previous,
+		current,
+		dither,
+		first_pixel + block_end,
+		pixel_count - block_end,
+		&pixels_out[block_end*4]
+	);
+}
+
+RENDER_DEFINE_VARIANTS(render_pixels_sse2, render_pixels_sse2_impl)
+
+#endif
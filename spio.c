@@ -3,98 +3,239 @@
 //
 
 #include "spio.h"
+#include "spio_backend.h"
 
 #include <stdint.h>
 #include <unistd.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <errno.h>
 #include <fcntl.h>
 #include <sys/ioctl.h>
 #include <linux/types.h>
 #include <linux/spi/spidev.h>
 
-#define SPI_BUFFER_SIZE 4096
+// spidev's default limit on the bytes in one message, used if the module parameter can't be read
+#define SPIO_DEFAULT_BUFSIZ 4096
+
+static const spio_backend_t* g_spio_backends[] = {
+	&g_spio_spidev_backend,
+	&g_spio_null_backend,
+	&g_spio_file_backend,
+	&g_spio_shm_backend,
+	&g_spio_trace_backend
+};
+
+static const size_t g_spio_backend_count = sizeof(g_spio_backends) / sizeof(g_spio_backends[0]);
+
+/**
+ * Reads the most bytes spidev accepts in one message from its module parameter.
+ */
+static uint32_t spio_read_bufsiz() {
+	uint32_t bufsiz = SPIO_DEFAULT_BUFSIZ;
+
+	FILE* file = fopen("/sys/module/spidev/parameters/bufsiz", "r");
+	if (file != NULL) {
+		unsigned int value;
+		if (fscanf(file, "%u", &value) == 1 && value > 0) {
+			bufsiz = value;
+		}
+		fclose(file);
+	}
 
-static void pabort(const char *s)
-{
-	perror(s);
-	abort();
+	return bufsiz;
 }
 
-spio_connection* spio_open(
-	const char *device,
-	uint32_t speed
-) {
-	spio_connection* conn = malloc(sizeof(spio_connection));
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// spidev
 
-	conn->device_path = device;
-	conn->speed_hz = speed;
-	conn->spi_mode = 0;
-	conn->bits_per_word = 8;
-	conn->delay_usecs = 0;
+static bool spio_spidev_open(spio_connection* conn, const char* target) {
+	conn->max_message_bytes = spio_read_bufsiz();
+
+	conn->fd = open(target, O_WRONLY);
+	if (conn->fd < 0) {
+		fprintf(stderr, "[spi] Can't open %s: %s\n", target, strerror(errno));
+		return false;
+	}
 
-	conn->fd = open(device, O_WRONLY);
+	const char* failed_step = NULL;
 
 	/*
 	 * spi mode
 	 */
-	if (ioctl(conn->fd, SPI_IOC_RD_MODE, &conn->spi_mode) == -1)
-		pabort("can't set spi mode");
+	if (ioctl(conn->fd, SPI_IOC_WR_MODE, &conn->spi_mode) == -1)
+		failed_step = "set spi mode";
 
-	if (ioctl(conn->fd, SPI_IOC_RD_MODE, &conn->spi_mode) == -1)
-		pabort("can't get spi mode");
+	else if (ioctl(conn->fd, SPI_IOC_RD_MODE, &conn->spi_mode) == -1)
+		failed_step = "get spi mode";
 
 	/*
 	 * bits per word
 	 */
-	if (ioctl(conn->fd, SPI_IOC_WR_BITS_PER_WORD, &conn->bits_per_word) == -1)
-		pabort("can't set bits per word");
+	else if (ioctl(conn->fd, SPI_IOC_WR_BITS_PER_WORD, &conn->bits_per_word) == -1)
+		failed_step = "set bits per word";
 
-	if (ioctl(conn->fd, SPI_IOC_RD_BITS_PER_WORD, &conn->bits_per_word) == -1)
-		pabort("can't get bits per word");
+	else if (ioctl(conn->fd, SPI_IOC_RD_BITS_PER_WORD, &conn->bits_per_word) == -1)
+		failed_step = "get bits per word";
 
 	/*
 	 * max speed hz
 	 */
-	if (ioctl(conn->fd, SPI_IOC_WR_MAX_SPEED_HZ, &conn->speed_hz) == -1)
-		pabort("can't set max speed hz");
+	else if (ioctl(conn->fd, SPI_IOC_WR_MAX_SPEED_HZ, &conn->speed_hz) == -1)
+		failed_step = "set max speed hz";
 
-	if (ioctl(conn->fd, SPI_IOC_RD_MAX_SPEED_HZ, &conn->speed_hz) == -1)
-		pabort("can't get max speed hz");
+	else if (ioctl(conn->fd, SPI_IOC_RD_MAX_SPEED_HZ, &conn->speed_hz) == -1)
+		failed_step = "get max speed hz";
 
-	return conn;
+	if (failed_step != NULL) {
+		fprintf(stderr, "[spi] Can't %s on %s: %s\n", failed_step, target, strerror(errno));
+		close(conn->fd);
+		conn->fd = -1;
+		return false;
+	}
+
+	return true;
 }
 
-void spio_close(spio_connection* conn) {
+static void spio_spidev_close(spio_connection* conn) {
 	if (conn->fd >= 0) {
 		close(conn->fd);
 		conn->fd = -1;
 	}
 }
 
-void spio_write(spio_connection* conn, const void* data, size_t len) {
-	for (size_t i=0; i<len; i += SPI_BUFFER_SIZE) {
-		size_t packet_size = i + SPI_BUFFER_SIZE > len
-		                     ? len - i
-		                     : SPI_BUFFER_SIZE;
-
-		if (packet_size > 0) {
-//			int ret;
-//			struct spi_ioc_transfer tr = {
-//				.tx_buf = (unsigned long)data + i,
-//				.rx_buf = (unsigned long)data + i,
-//				.len = packet_size,
-//				.delay_usecs = conn->delay_usecs,
-//				.speed_hz = conn->speed_hz,
-//				.bits_per_word = conn->bits_per_word,
-//			};
-//
-//			ret = ioctl(conn->fd, SPI_IOC_MESSAGE(1), &tr);
-//			if (ret < 1)
-//				pabort("can't send spi message");
+uint32_t spio_spidev_next_message(
+	const spio_connection* conn,
+	const uint8_t* data,
+	size_t len,
+	size_t offset,
+	struct spi_ioc_transfer* transfers,
+	size_t* message_bytes
+) {
+	uint32_t transfer_bytes = conn->max_message_bytes < SPIO_MAX_TRANSFER_BYTES
+		? conn->max_message_bytes
+		: SPIO_MAX_TRANSFER_BYTES;
 
-			write(conn->fd, data + i, packet_size);
+	uint32_t transfer_count = 0;
+	*message_bytes = 0;
+
+	while (offset < len && transfer_count < SPIO_MAX_TRANSFERS) {
+		uint32_t packet_size = len - offset < transfer_bytes ? (uint32_t) (len - offset) : transfer_bytes;
+
+		// A short last piece can still share the message
+		if (*message_bytes + packet_size > conn->max_message_bytes) {
+			break;
 		}
+
+		memset(&transfers[transfer_count], 0, sizeof(struct spi_ioc_transfer));
+		transfers[transfer_count].tx_buf = (unsigned long) (data + offset);
+		transfers[transfer_count].len = packet_size;
+		transfers[transfer_count].delay_usecs = conn->delay_usecs;
+		transfers[transfer_count].speed_hz = conn->speed_hz;
+		transfers[transfer_count].bits_per_word = conn->bits_per_word;
+		transfers[transfer_count].cs_change = 0;
+
+		transfer_count++;
+		*message_bytes += packet_size;
+		offset += packet_size;
 	}
+
+	return transfer_count;
 }
 
+static int spio_spidev_write(spio_connection* conn, const void* data, size_t len) {
+	struct spi_ioc_transfer transfers[SPIO_MAX_TRANSFERS];
+
+	// Send as much as spidev takes per message, split into transfers the controller can handle. Chip select stays
+	// asserted from one transfer to the next within a message.
+	for (size_t offset=0; offset<len; ) {
+		size_t message_bytes;
+		uint32_t transfer_count = spio_spidev_next_message(conn, data, len, offset, transfers, &message_bytes);
+
+		int ret = ioctl(conn->fd, SPI_IOC_MESSAGE(transfer_count), transfers);
+		if (ret < 0) {
+			return -1;
+		}
+		if ((size_t) ret != message_bytes) {
+			errno = EIO;
+			return -1;
+		}
+
+		offset += message_bytes;
+	}
+
+	return 0;
+}
+
+const spio_backend_t g_spio_spidev_backend = {
+	"spidev",
+	spio_spidev_open,
+	spio_spidev_write,
+	spio_spidev_close
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Backend selection
+
+spio_connection* spio_open(
+	const char *device,
+	uint32_t speed
+) {
+	// Paths without a known prefix are spidev devices
+	const spio_backend_t* backend = &g_spio_spidev_backend;
+	const char* target = device;
+
+	for (size_t i=0; i<g_spio_backend_count; i++) {
+		size_t name_length = strlen(g_spio_backends[i]->name);
+
+		if (strncmp(device, g_spio_backends[i]->name, name_length) == 0
+			&& (device[name_length] == ':' || device[name_length] == 0)
+		) {
+			backend = g_spio_backends[i];
+			target = device[name_length] == ':' ? &device[name_length + 1] : &device[name_length];
+		}
+	}
+
+	spio_connection* conn = calloc(1, sizeof(spio_connection));
+	if (conn == NULL) {
+		return NULL;
+	}
+
+	conn->fd = -1;
+	conn->device_path = device;
+	conn->speed_hz = speed;
+	conn->spi_mode = 0;
+	conn->bits_per_word = 8;
+	conn->delay_usecs = 0;
+	conn->latch_usec = 0;
+	conn->backend = backend;
+
+	if (! backend->open(conn, target)) {
+		free(conn);
+		return NULL;
+	}
+
+	return conn;
+}
+
+void spio_close(spio_connection* conn) {
+	if (conn == NULL) {
+		return;
+	}
+
+	conn->backend->close(conn);
+	free(conn);
+}
+
+int spio_write(spio_connection* conn, const void* data, size_t len) {
+	int result = conn->backend->write(conn, data, len);
+
+	if (conn->latch_usec > 0) {
+		int write_errno = errno;
+		usleep(conn->latch_usec);
+		errno = write_errno;
+	}
+
+	return result;
+}
@@ -5,11 +5,11 @@
 #ifndef SPISCAPE_SPI_IO_H
 #define SPISCAPE_SPI_IO_H
 
-#endif //SPISCAPE_SPI_IO_H
-
 #include <stdint.h>
 #include <stddef.h>
 
+struct spio_backend;
+
 typedef struct {
 	int fd;
 
@@ -19,13 +19,109 @@ typedef struct {
 	uint8_t spi_mode;
 	uint8_t bits_per_word;
 	uint16_t delay_usecs;
+
+	// The most bytes spidev accepts in one message (its bufsiz parameter)
+	uint32_t max_message_bytes;
+
+	// How long to keep the bus idle after each write, for LEDs that latch when the clock stops
+	uint32_t latch_usec;
+
+	// Where the output goes, picked by the device path's prefix, and that backend's own state
+	const struct spio_backend* backend;
+	void* backend_data;
 } spio_connection;
 
+/**
+ * Opens an output. The device path picks the backend:
+ *
+ * - `null` or `null:<name>` discards the data, taking as long as a speed hz SPI bus would to send it
+ * - `file:<path>` writes to a file, which always holds the latest frame, or streams frames into a FIFO
+ * - `shm:<name>` publishes frames to the spio_shm_header_t ring in POSIX shared memory object name
+ * - `trace:<path>` decodes APA102 frames and appends them to path as spio_trace_record_t records
+ * - anything else, or `spidev:<path>`, is a spidev device
+ *
+ * \return NULL if the output can't be opened, after printing why
+ */
 extern spio_connection* spio_open(
 	const char *device,
 	uint32_t speed
 );
 
+/**
+ * Closes the output and frees the connection.
+ */
 extern void spio_close(spio_connection* conn);
 
-extern void spio_write(spio_connection* conn, const void* data, size_t len);
\ No newline at end of file
+/**
+ * Writes len bytes, then waits latch_usec. On spidev, this takes as few SPI_IOC_MESSAGE calls as spidev's bufsiz
+ * allows: one per frame if bufsiz is at least the frame size. Returns 0 on success, or -1 with errno set if the write
+ * failed.
+ */
+extern int spio_write(spio_connection* conn, const void* data, size_t len);
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Shared memory ring layout, for readers of the shm backend
+
+#define SPIO_SHM_MAGIC 0x4950534C /* "LSPI" */
+#define SPIO_SHM_SLOT_COUNT 8
+
+/**
+ * Start of the shared memory object, followed by slot_count slots of sizeof(spio_shm_slot_t) + slot_size bytes each.
+ *
+ * The ring is sized for the first frame written, and recreated with frame_count starting over if a later frame doesn't
+ * fit. Readers should map it again whenever slot_size changes.
+ */
+typedef struct {
+	uint32_t magic;
+	uint32_t slot_count;
+
+	// Bytes of frame data each slot can hold, a multiple of 8
+	uint32_t slot_size;
+	uint32_t reserved;
+
+	// Frames written so far; frame n goes in slot n % slot_count. Stored once the frame's slot is complete.
+	uint64_t frame_count;
+} spio_shm_header_t;
+
+typedef struct {
+	// Number of the frame in the slot plus one, or 0 while the slot is being written. A reader that sees the same
+	// value before and after copying a slot has an intact frame.
+	uint64_t frame_number;
+
+	uint32_t length;
+	uint32_t reserved;
+
+	uint8_t data[];
+} spio_shm_slot_t;
+
+static inline spio_shm_slot_t* spio_shm_slot(spio_shm_header_t* header, uint64_t frame_index) {
+	uint8_t* slots = (uint8_t*) (header + 1);
+	return (spio_shm_slot_t*) &slots[(frame_index % header->slot_count) * (sizeof(spio_shm_slot_t) + header->slot_size)];
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Trace layout, for readers of the trace backend
+
+#define SPIO_TRACE_MAGIC 0x4352544C /* "LTRC" */
+
+/**
+ * One decoded frame, followed by pixel_count apa102_pixel_t (brightness, then the color bytes in output order). Fields
+ * are in host byte order.
+ */
+typedef struct {
+	uint32_t magic;
+	uint32_t pixel_count;
+
+	// When the frame was written, on the monotonic clock
+	uint64_t timestamp_usec;
+
+	// Bytes the frame took on the wire, and how they were laid out; see apa102_frame_info_t
+	uint32_t frame_length;
+	uint32_t start_length;
+	uint32_t end_length;
+	uint8_t end_byte;
+	uint8_t valid;
+	uint16_t reserved;
+} spio_trace_record_t;
+
+#endif //SPISCAPE_SPI_IO_H
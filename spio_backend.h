@@ -0,0 +1,53 @@
+/** \file
+ * Interface implemented by the output backends behind spio_connection.
+ */
+#ifndef SPISCAPE_SPIO_BACKEND_H
+#define SPISCAPE_SPIO_BACKEND_H
+
+#include <stdbool.h>
+
+#include "spio.h"
+
+// Some controllers have 16-bit transfer length registers; stay below that, on a whole APA102 LED frame
+#define SPIO_MAX_TRANSFER_BYTES 65532
+
+// Transfers per SPI_IOC_MESSAGE; the ioctl's size field limits this to 511
+#define SPIO_MAX_TRANSFERS 64
+
+struct spi_ioc_transfer;
+
+typedef struct spio_backend {
+	// Device paths starting with the name and a colon use this backend
+	const char* name;
+
+	// Opens target, the device path without the prefix. Returns false after printing why if it can't be opened.
+	bool (*open)(spio_connection* conn, const char* target);
+
+	// Returns 0 on success, or -1 with errno set
+	int (*write)(spio_connection* conn, const void* data, size_t len);
+
+	void (*close)(spio_connection* conn);
+} spio_backend_t;
+
+extern const spio_backend_t g_spio_spidev_backend;
+extern const spio_backend_t g_spio_null_backend;
+extern const spio_backend_t g_spio_file_backend;
+extern const spio_backend_t g_spio_shm_backend;
+extern const spio_backend_t g_spio_trace_backend;
+
+/**
+ * Fills transfers with the next spidev message of the len bytes of data, starting at offset: as many transfers of up
+ * to SPIO_MAX_TRANSFER_BYTES as fit in conn->max_message_bytes, at most SPIO_MAX_TRANSFERS of them.
+ *
+ * \return the number of transfers, after storing the bytes they cover in message_bytes
+ */
+extern uint32_t spio_spidev_next_message(
+	const spio_connection* conn,
+	const uint8_t* data,
+	size_t len,
+	size_t offset,
+	struct spi_ioc_transfer* transfers,
+	size_t* message_bytes
+);
+
+#endif //SPISCAPE_SPIO_BACKEND_H
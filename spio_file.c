@@ -0,0 +1,89 @@
+/** \file
+ * File output backend. A regular file is overwritten with each frame, so it always holds the latest one; a FIFO gets
+ * the frames one after the other, with the server waiting for the reader like it would for a slow bus.
+ */
+#include "spio_backend.h"
+#include "util.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+typedef struct {
+	bool overwrite;
+
+	// Length of the frame last written to a regular file
+	size_t length;
+} spio_file_state_t;
+
+static bool spio_file_open(spio_connection* conn, const char* target) {
+	spio_file_state_t* state = calloc(1, sizeof(spio_file_state_t));
+	if (state == NULL) {
+		fprintf(stderr, "[spi] Can't allocate file output %s\n", conn->device_path);
+		return false;
+	}
+
+	// Opening a FIFO for reading and writing doesn't wait for a reader to show up, unlike opening it for writing only
+	struct stat target_stat;
+	if (stat(target, &target_stat) == 0 && S_ISFIFO(target_stat.st_mode)) {
+		conn->fd = open(target, O_RDWR);
+	} else {
+		conn->fd = open(target, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		state->overwrite = conn->fd >= 0 && fstat(conn->fd, &target_stat) == 0 && S_ISREG(target_stat.st_mode);
+	}
+
+	if (conn->fd < 0) {
+		fprintf(stderr, "[spi] Can't open %s: %s\n", target, strerror(errno));
+		free(state);
+		return false;
+	}
+
+	conn->backend_data = state;
+	return true;
+}
+
+static int spio_file_write(spio_connection* conn, const void* data, size_t len) {
+	spio_file_state_t* state = conn->backend_data;
+
+	if (state->overwrite) {
+		for (size_t offset=0; offset<len; ) {
+			ssize_t written = pwrite(conn->fd, (const uint8_t*) data + offset, len - offset, (off_t) offset);
+			if (written < 0) {
+				if (errno == EINTR) {
+					continue;
+				}
+				return -1;
+			}
+			offset += (size_t) written;
+		}
+
+		// Drop what's left of a longer frame written before
+		if (len < state->length && ftruncate(conn->fd, (off_t) len) < 0) {
+			return -1;
+		}
+		state->length = len;
+
+		return 0;
+	}
+
+	return write_all(conn->fd, data, len) == (ssize_t) len ? 0 : -1;
+}
+
+static void spio_file_close(spio_connection* conn) {
+	if (conn->fd >= 0) {
+		close(conn->fd);
+		conn->fd = -1;
+	}
+
+	free(conn->backend_data);
+	conn->backend_data = NULL;
+}
+
+const spio_backend_t g_spio_file_backend = {
+	"file",
+	spio_file_open,
+	spio_file_write,
+	spio_file_close
+};
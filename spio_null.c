@@ -0,0 +1,75 @@
+/** \file
+ * Null output backend: discards frames, taking as long as the SPI bus would to send them, so the whole pipeline can be
+ * run and timed without LEDs attached.
+ */
+#include "spio_backend.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+typedef struct {
+	uint64_t bytes_written;
+	uint64_t write_count;
+} spio_null_state_t;
+
+static bool spio_null_open(spio_connection* conn, const char* target) {
+	target=target; // Suppress Warnings
+
+	conn->backend_data = calloc(1, sizeof(spio_null_state_t));
+	if (conn->backend_data == NULL) {
+		fprintf(stderr, "[spi] Can't allocate null output %s\n", conn->device_path);
+		return false;
+	}
+
+	return true;
+}
+
+static int spio_null_write(spio_connection* conn, const void* data, size_t len) {
+	data=data; // Suppress Warnings
+
+	spio_null_state_t* state = conn->backend_data;
+	state->bytes_written += len;
+	state->write_count++;
+
+	// Sleep until the last bit would have been clocked out, rather than for the bus time, so the time taken to get here
+	// doesn't add up
+	if (conn->speed_hz > 0) {
+		uint64_t bus_nsec = (uint64_t) len * 8 * 1000000000 / conn->speed_hz;
+		struct timespec done_ts;
+
+		clock_gettime(CLOCK_MONOTONIC, &done_ts);
+		done_ts.tv_sec += (time_t) (bus_nsec / 1000000000);
+		done_ts.tv_nsec += (long) (bus_nsec % 1000000000);
+		if (done_ts.tv_nsec >= 1000000000) {
+			done_ts.tv_sec++;
+			done_ts.tv_nsec -= 1000000000;
+		}
+
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &done_ts, NULL) != 0) {
+			// Interrupted; sleep for the rest
+		}
+	}
+
+	return 0;
+}
+
+static void spio_null_close(spio_connection* conn) {
+	spio_null_state_t* state = conn->backend_data;
+
+	fprintf(stderr, "[spi] %s: discarded %llu bytes in %llu writes\n",
+		conn->device_path,
+		(unsigned long long) state->bytes_written,
+		(unsigned long long) state->write_count
+	);
+
+	free(state);
+	conn->backend_data = NULL;
+}
+
+const spio_backend_t g_spio_null_backend = {
+	"null",
+	spio_null_open,
+	spio_null_write,
+	spio_null_close
+};
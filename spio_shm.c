@@ -0,0 +1,128 @@
+/** \file
+ * Shared memory output backend: publishes frames to a ring of SPIO_SHM_SLOT_COUNT slots in a POSIX shared memory
+ * object, where other processes can pick them up without the server ever waiting for them. See spio_shm_header_t for
+ * the layout.
+ */
+#include "spio_backend.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+typedef struct {
+	char name[256];
+
+	spio_shm_header_t* header;
+	size_t mapped_size;
+} spio_shm_state_t;
+
+static void spio_shm_unmap(spio_shm_state_t* state) {
+	if (state->header != NULL) {
+		munmap(state->header, state->mapped_size);
+		state->header = NULL;
+		state->mapped_size = 0;
+	}
+}
+
+/**
+ * Sizes the ring for frames of up to len bytes and maps it, starting over with an empty ring.
+ */
+static int spio_shm_map(spio_connection* conn, size_t len) {
+	spio_shm_state_t* state = conn->backend_data;
+	size_t slot_size = (len + 7) & ~(size_t) 7;
+	size_t mapped_size = sizeof(spio_shm_header_t) + SPIO_SHM_SLOT_COUNT * (sizeof(spio_shm_slot_t) + slot_size);
+
+	spio_shm_unmap(state);
+
+	if (ftruncate(conn->fd, (off_t) mapped_size) < 0) {
+		return -1;
+	}
+
+	void* mapping = mmap(NULL, mapped_size, PROT_READ | PROT_WRITE, MAP_SHARED, conn->fd, 0);
+	if (mapping == MAP_FAILED) {
+		return -1;
+	}
+
+	state->header = mapping;
+	state->mapped_size = mapped_size;
+
+	// Readers only trust the layout once the magic number is back
+	__atomic_store_n(&state->header->magic, 0, __ATOMIC_RELEASE);
+	memset((uint8_t*) mapping + sizeof(uint32_t), 0, mapped_size - sizeof(uint32_t));
+	state->header->slot_count = SPIO_SHM_SLOT_COUNT;
+	state->header->slot_size = (uint32_t) slot_size;
+	__atomic_store_n(&state->header->magic, SPIO_SHM_MAGIC, __ATOMIC_RELEASE);
+
+	return 0;
+}
+
+static bool spio_shm_open(spio_connection* conn, const char* target) {
+	spio_shm_state_t* state = calloc(1, sizeof(spio_shm_state_t));
+	if (state == NULL) {
+		fprintf(stderr, "[spi] Can't allocate shared memory output %s\n", conn->device_path);
+		return false;
+	}
+
+	// Shared memory object names start with a slash
+	snprintf(state->name, sizeof(state->name), "%s%s", target[0] == '/' ? "" : "/", target);
+
+	conn->fd = shm_open(state->name, O_RDWR | O_CREAT, 0644);
+	if (conn->fd < 0) {
+		fprintf(stderr, "[spi] Can't open shared memory %s: %s\n", state->name, strerror(errno));
+		free(state);
+		return false;
+	}
+
+	// The ring is sized once the first frame shows how big frames are
+	conn->backend_data = state;
+	return true;
+}
+
+static int spio_shm_write(spio_connection* conn, const void* data, size_t len) {
+	spio_shm_state_t* state = conn->backend_data;
+
+	if (state->header == NULL || len > state->header->slot_size) {
+		if (spio_shm_map(conn, len) < 0) {
+			return -1;
+		}
+	}
+
+	spio_shm_header_t* header = state->header;
+	uint64_t frame_index = header->frame_count;
+	spio_shm_slot_t* slot = spio_shm_slot(header, frame_index);
+
+	// Mark the slot as being written, fill it, then publish it
+	__atomic_store_n(&slot->frame_number, 0, __ATOMIC_RELEASE);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	memcpy(slot->data, data, len);
+	slot->length = (uint32_t) len;
+	__atomic_store_n(&slot->frame_number, frame_index + 1, __ATOMIC_RELEASE);
+	__atomic_store_n(&header->frame_count, frame_index + 1, __ATOMIC_RELEASE);
+
+	return 0;
+}
+
+static void spio_shm_close(spio_connection* conn) {
+	spio_shm_state_t* state = conn->backend_data;
+
+	// The object stays around for readers; remove it with shm_unlink() or from /dev/shm
+	spio_shm_unmap(state);
+	if (conn->fd >= 0) {
+		close(conn->fd);
+		conn->fd = -1;
+	}
+
+	free(state);
+	conn->backend_data = NULL;
+}
+
+const spio_backend_t g_spio_shm_backend = {
+	"shm",
+	spio_shm_open,
+	spio_shm_write,
+	spio_shm_close
+};
@@ -0,0 +1,118 @@
+/** \file
+ * Trace output backend: decodes each frame as APA102 and appends the pixels and frame timing to a file as
+ * spio_trace_record_t records, for checking the output end to end without LEDs attached. See ledspi-decode for a reader.
+ */
+#include "spio_backend.h"
+#include "apa102_decode.h"
+#include "util.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+typedef struct {
+	// Record header and decoded pixels, written together
+	uint8_t* record;
+	size_t record_size;
+
+	uint64_t frame_count;
+	uint64_t invalid_frames;
+} spio_trace_state_t;
+
+static bool spio_trace_open(spio_connection* conn, const char* target) {
+	spio_trace_state_t* state = calloc(1, sizeof(spio_trace_state_t));
+	if (state == NULL) {
+		fprintf(stderr, "[spi] Can't allocate trace output %s\n", conn->device_path);
+		return false;
+	}
+
+	// Like the file backend, don't wait for a reader to open a FIFO
+	struct stat target_stat;
+	if (stat(target, &target_stat) == 0 && S_ISFIFO(target_stat.st_mode)) {
+		conn->fd = open(target, O_RDWR);
+	} else {
+		conn->fd = open(target, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	}
+
+	if (conn->fd < 0) {
+		fprintf(stderr, "[spi] Can't open %s: %s\n", target, strerror(errno));
+		free(state);
+		return false;
+	}
+
+	conn->backend_data = state;
+	return true;
+}
+
+static int spio_trace_write(spio_connection* conn, const void* data, size_t len) {
+	spio_trace_state_t* state = conn->backend_data;
+
+	// Room for as many pixels as the frame could possibly hold
+	uint32_t max_pixels = (uint32_t) (len / 4);
+	size_t record_size = sizeof(spio_trace_record_t) + max_pixels * sizeof(apa102_pixel_t);
+	if (state->record_size < record_size) {
+		uint8_t* record = realloc(state->record, record_size);
+		if (record == NULL) {
+			errno = ENOMEM;
+			return -1;
+		}
+		state->record = record;
+		state->record_size = record_size;
+	}
+
+	struct timeval now_tv;
+	monotonic_time(&now_tv);
+
+	apa102_frame_info_t info;
+	apa102_decode_frame(data, len, (apa102_pixel_t*) (state->record + sizeof(spio_trace_record_t)), max_pixels, &info);
+
+	// Only the first bad frame of a run is worth a log line
+	state->frame_count++;
+	if (! info.valid && state->invalid_frames++ == 0) {
+		fprintf(stderr, "[spi] Frame %llu to %s is not a valid APA102 frame: %s\n",
+			(unsigned long long) state->frame_count, conn->device_path, info.error
+		);
+	} else if (info.valid) {
+		state->invalid_frames = 0;
+	}
+
+	spio_trace_record_t header = {
+		.magic = SPIO_TRACE_MAGIC,
+		.pixel_count = info.pixel_count,
+		.timestamp_usec = (uint64_t) now_tv.tv_sec * 1000000 + (uint64_t) now_tv.tv_usec,
+		.frame_length = (uint32_t) len,
+		.start_length = info.start_length,
+		.end_length = info.end_length,
+		.end_byte = info.end_byte,
+		.valid = info.valid ? 1 : 0,
+		.reserved = 0
+	};
+	memcpy(state->record, &header, sizeof(header));
+
+	size_t length = sizeof(spio_trace_record_t) + info.pixel_count * sizeof(apa102_pixel_t);
+	return write_all(conn->fd, state->record, length) == (ssize_t) length ? 0 : -1;
+}
+
+static void spio_trace_close(spio_connection* conn) {
+	spio_trace_state_t* state = conn->backend_data;
+
+	if (conn->fd >= 0) {
+		close(conn->fd);
+		conn->fd = -1;
+	}
+
+	if (state != NULL) {
+		free(state->record);
+		free(state);
+	}
+	conn->backend_data = NULL;
+}
+
+const spio_backend_t g_spio_trace_backend = {
+	"trace",
+	spio_trace_open,
+	spio_trace_write,
+	spio_trace_close
+};
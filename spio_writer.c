@@ -0,0 +1,287 @@
+/** \file
+ * Asynchronous SPI writer.
+ */
+#include "spio_writer.h"
+#include "util.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#define min(a,b) ((a)<(b)?(a):(b))
+
+typedef enum {
+	SPIO_BUFFER_FREE = 0,
+	SPIO_BUFFER_ACQUIRED,
+	SPIO_BUFFER_QUEUED,
+	SPIO_BUFFER_WRITING
+} spio_buffer_state_t;
+
+typedef struct {
+	uint8_t* data;
+	size_t len;
+	spio_connection* conn;
+	spio_buffer_state_t state;
+
+	// Value of the writer's write counter when this buffer was last written, or 0 if never
+	uint64_t written_at;
+} spio_writer_buffer_t;
+
+struct spio_writer {
+	spio_writer_buffer_t buffers[SPIO_WRITER_MAX_BUFFERS];
+	uint32_t buffer_count;
+	size_t buffer_size;
+
+	// Buffers waiting to be written, oldest first
+	uint32_t queue[SPIO_WRITER_MAX_BUFFERS];
+	uint32_t queue_head;
+	uint32_t queue_length;
+
+	uint64_t write_counter;
+	int32_t last_written;
+	uint32_t last_write_usec;
+
+	// Writes that failed in a row
+	uint32_t failed_writes;
+
+	pthread_t thread;
+	pthread_mutex_t mutex;
+
+	// Signalled when a buffer is queued or the writer is stopping
+	pthread_cond_t queued_cond;
+
+	// Signalled when a buffer has been written
+	pthread_cond_t written_cond;
+
+	bool stopping;
+};
+
+/**
+ * Adds a buffer to the end of the queue. Must be called with the mutex held.
+ */
+static void spio_writer_enqueue(spio_writer_t* writer, uint32_t index, spio_connection* conn) {
+	spio_writer_buffer_t* buffer = &writer->buffers[index];
+
+	buffer->conn = conn;
+	buffer->state = SPIO_BUFFER_QUEUED;
+
+	writer->queue[(writer->queue_head + writer->queue_length) % SPIO_WRITER_MAX_BUFFERS] = index;
+	writer->queue_length++;
+
+	pthread_cond_signal(&writer->queued_cond);
+}
+
+static void* spio_writer_thread(void* writer_data) {
+	spio_writer_t* writer = writer_data;
+
+	pthread_mutex_lock(&writer->mutex);
+
+	while (true) {
+		while (! writer->stopping && writer->queue_length == 0) {
+			pthread_cond_wait(&writer->queued_cond, &writer->mutex);
+		}
+
+		if (writer->queue_length == 0) {
+			break;
+		}
+
+		uint32_t index = writer->queue[writer->queue_head];
+		writer->queue_head = (writer->queue_head + 1) % SPIO_WRITER_MAX_BUFFERS;
+		writer->queue_length--;
+
+		spio_writer_buffer_t* buffer = &writer->buffers[index];
+		buffer->state = SPIO_BUFFER_WRITING;
+
+		pthread_mutex_unlock(&writer->mutex);
+
+		struct timeval start_tv, stop_tv, delta_tv;
+		monotonic_time(&start_tv);
+		int result = spio_write(buffer->conn, buffer->data, buffer->len);
+		int write_errno = errno;
+		monotonic_time(&stop_tv);
+		timersub(&stop_tv, &start_tv, &delta_tv);
+
+		pthread_mutex_lock(&writer->mutex);
+
+		// Log when writes start and stop failing, not every failed frame
+		if (result < 0) {
+			if (writer->failed_writes++ == 0) {
+				fprintf(stderr, "[spi] Failed to write frame to %s: %s\n", buffer->conn->device_path, strerror(write_errno));
+			}
+		} else if (writer->failed_writes > 0) {
+			fprintf(stderr, "[spi] Writes to %s recovered after %u failed frames\n", buffer->conn->device_path, writer->failed_writes);
+			writer->failed_writes = 0;
+		}
+
+		buffer->state = SPIO_BUFFER_FREE;
+		buffer->written_at = ++writer->write_counter;
+		writer->last_written = (int32_t) index;
+		writer->last_write_usec = (uint32_t) (delta_tv.tv_sec*1000000 + delta_tv.tv_usec);
+
+		pthread_cond_broadcast(&writer->written_cond);
+	}
+
+	pthread_mutex_unlock(&writer->mutex);
+
+	return NULL;
+}
+
+spio_writer_t* spio_writer_create(uint32_t buffer_count, size_t buffer_size) {
+	spio_writer_t* writer = calloc(1, sizeof(spio_writer_t));
+	if (writer == NULL) {
+		return NULL;
+	}
+
+	writer->buffer_count = min(buffer_count, SPIO_WRITER_MAX_BUFFERS);
+	writer->buffer_size = buffer_size;
+	writer->last_written = -1;
+
+	for (uint32_t i=0; i<writer->buffer_count; i++) {
+		writer->buffers[i].data = calloc(1, buffer_size);
+
+		if (writer->buffers[i].data == NULL) {
+			for (uint32_t j=0; j<i; j++) {
+				free(writer->buffers[j].data);
+			}
+			free(writer);
+			return NULL;
+		}
+	}
+
+	pthread_mutex_init(&writer->mutex, NULL);
+	pthread_cond_init(&writer->queued_cond, NULL);
+	pthread_cond_init(&writer->written_cond, NULL);
+
+	int error = pthread_create(&writer->thread, NULL, spio_writer_thread, writer);
+	if (error != 0) {
+		fprintf(stderr, "[spi] Failed to start SPI writer thread\n");
+
+		for (uint32_t i=0; i<writer->buffer_count; i++) {
+			free(writer->buffers[i].data);
+		}
+		pthread_mutex_destroy(&writer->mutex);
+		pthread_cond_destroy(&writer->queued_cond);
+		pthread_cond_destroy(&writer->written_cond);
+		free(writer);
+		return NULL;
+	}
+
+	return writer;
+}
+
+void spio_writer_destroy(spio_writer_t* writer) {
+	if (writer == NULL) {
+		return;
+	}
+
+	// The thread drains the queue before it stops
+	pthread_mutex_lock(&writer->mutex);
+	writer->stopping = true;
+	pthread_cond_signal(&writer->queued_cond);
+	pthread_mutex_unlock(&writer->mutex);
+
+	pthread_join(writer->thread, NULL);
+
+	for (uint32_t i=0; i<writer->buffer_count; i++) {
+		free(writer->buffers[i].data);
+	}
+
+	pthread_mutex_destroy(&writer->mutex);
+	pthread_cond_destroy(&writer->queued_cond);
+	pthread_cond_destroy(&writer->written_cond);
+
+	free(writer);
+}
+
+uint8_t* spio_writer_acquire(spio_writer_t* writer) {
+	pthread_mutex_lock(&writer->mutex);
+
+	int32_t acquired = -1;
+	while (acquired < 0) {
+		for (uint32_t i=0; i<writer->buffer_count; i++) {
+			spio_writer_buffer_t* buffer = &writer->buffers[i];
+
+			if (buffer->state == SPIO_BUFFER_FREE
+				&& (acquired < 0 || buffer->written_at < writer->buffers[acquired].written_at)
+			) {
+				acquired = (int32_t) i;
+			}
+		}
+
+		if (acquired < 0) {
+			pthread_cond_wait(&writer->written_cond, &writer->mutex);
+		}
+	}
+
+	writer->buffers[acquired].state = SPIO_BUFFER_ACQUIRED;
+	if (writer->last_written == acquired) {
+		writer->last_written = -1;
+	}
+
+	pthread_mutex_unlock(&writer->mutex);
+
+	return writer->buffers[acquired].data;
+}
+
+void spio_writer_submit(spio_writer_t* writer, spio_connection* conn, uint8_t* data, size_t len) {
+	pthread_mutex_lock(&writer->mutex);
+
+	for (uint32_t i=0; i<writer->buffer_count; i++) {
+		if (writer->buffers[i].data == data) {
+			writer->buffers[i].len = min(len, writer->buffer_size);
+			spio_writer_enqueue(writer, i, conn);
+			break;
+		}
+	}
+
+	pthread_mutex_unlock(&writer->mutex);
+}
+
+bool spio_writer_repeat(spio_writer_t* writer, spio_connection* conn) {
+	bool repeated = false;
+
+	pthread_mutex_lock(&writer->mutex);
+
+	if (writer->last_written >= 0) {
+		spio_writer_buffer_t* buffer = &writer->buffers[writer->last_written];
+
+		if (buffer->state == SPIO_BUFFER_FREE) {
+			spio_writer_enqueue(writer, (uint32_t) writer->last_written, conn);
+		}
+
+		repeated = true;
+	}
+
+	pthread_mutex_unlock(&writer->mutex);
+
+	return repeated;
+}
+
+void spio_writer_flush(spio_writer_t* writer) {
+	pthread_mutex_lock(&writer->mutex);
+
+	while (true) {
+		bool busy = writer->queue_length > 0;
+		for (uint32_t i=0; i<writer->buffer_count; i++) {
+			busy = busy || writer->buffers[i].state == SPIO_BUFFER_WRITING;
+		}
+
+		if (! busy) {
+			break;
+		}
+
+		pthread_cond_wait(&writer->written_cond, &writer->mutex);
+	}
+
+	pthread_mutex_unlock(&writer->mutex);
+}
+
+uint32_t spio_writer_last_write_usec(spio_writer_t* writer) {
+	pthread_mutex_lock(&writer->mutex);
+	uint32_t last_write_usec = writer->last_write_usec;
+	pthread_mutex_unlock(&writer->mutex);
+
+	return last_write_usec;
+}
@@ -0,0 +1,61 @@
+/** \file
+ * Asynchronous SPI writer: sends frames from its own thread, so the next frame can be rendered while the previous one
+ * is on the wire.
+ *
+ * The writer owns a small set of pre-allocated output buffers. The render thread acquires a free buffer, renders into
+ * it and submits it; the writer thread sends submitted buffers in order and then frees them. With two buffers, one can
+ * be on the wire while the other is being rendered, so a frame takes as long as the slower of the two, not both added
+ * together. Acquiring blocks while every buffer is queued or being written, which bounds the queue.
+ */
+#ifndef SPISCAPE_SPIO_WRITER_H
+#define SPISCAPE_SPIO_WRITER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "spio.h"
+
+#define SPIO_WRITER_MAX_BUFFERS 8
+
+typedef struct spio_writer spio_writer_t;
+
+/**
+ * Creates a writer with buffer_count buffers of buffer_size bytes each and starts its thread. Returns NULL on failure.
+ */
+extern spio_writer_t* spio_writer_create(uint32_t buffer_count, size_t buffer_size);
+
+/**
+ * Waits for all submitted buffers to be written, then stops the writer thread and frees the buffers.
+ */
+extern void spio_writer_destroy(spio_writer_t* writer);
+
+/**
+ * Returns a free buffer to render into, waiting for one if needed. Buffers are handed out least recently written first,
+ * so the last frame written stays intact for spio_writer_repeat() for as long as possible.
+ */
+extern uint8_t* spio_writer_acquire(spio_writer_t* writer);
+
+/**
+ * Queues the first len bytes of an acquired buffer to be written to conn. The buffer must not be touched afterwards.
+ */
+extern void spio_writer_submit(spio_writer_t* writer, spio_connection* conn, uint8_t* buffer, size_t len);
+
+/**
+ * Queues the last buffer written to be written to conn again, unless it is still queued or being written.
+ *
+ * \return false if there is no intact last buffer to repeat
+ */
+extern bool spio_writer_repeat(spio_writer_t* writer, spio_connection* conn);
+
+/**
+ * Waits until every submitted buffer has been written.
+ */
+extern void spio_writer_flush(spio_writer_t* writer);
+
+/**
+ * Returns how long the last buffer took to write, in microseconds.
+ */
+extern uint32_t spio_writer_last_write_usec(spio_writer_t* writer);
+
+#endif //SPISCAPE_SPIO_WRITER_H
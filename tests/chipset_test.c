@@ -0,0 +1,155 @@
+/** \file
+ * Encodes a fixed set of LED frames for every chipset and compares the whole frame, start and end frames included, with
+ * the output the chipset's datasheet calls for, byte for byte.
+ */
+#include "chipset.h"
+#include "render.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define TEST_LEDS 3
+
+// LED frames as the render kernels write them: brightness byte, then three color bytes in output order
+static const uint8_t g_test_led_frames[TEST_LEDS * 4] = {
+	0xE1, 0x10, 0x80, 0xFF,
+	0xFF, 0x00, 0x01, 0x02,
+	0xFF, 0xAA, 0x55, 0x7F
+};
+
+// Bytes past those listed are zero
+typedef struct {
+	const char* name;
+	uint32_t length;
+	uint8_t bytes[160];
+} test_expected_frame_t;
+
+static const test_expected_frame_t g_test_expected_frames[] = {
+	{ "apa102", 17, {
+		0x00, 0x00, 0x00, 0x00,
+		0xE1, 0x10, 0x80, 0xFF, 0xFF, 0x00, 0x01, 0x02, 0xFF, 0xAA, 0x55, 0x7F,
+		0xFF
+	} },
+	{ "sk9822", 21, {
+		0x00, 0x00, 0x00, 0x00,
+		0xE1, 0x10, 0x80, 0xFF, 0xFF, 0x00, 0x01, 0x02, 0xFF, 0xAA, 0x55, 0x7F,
+		0x00, 0x00, 0x00, 0x00, 0x00
+	} },
+	{ "hd107s", 17, {
+		0x00, 0x00, 0x00, 0x00,
+		0xE1, 0x10, 0x80, 0xFF, 0xFF, 0x00, 0x01, 0x02, 0xFF, 0xAA, 0x55, 0x7F,
+		0xFF
+	} },
+	// Rendered from the colors of the LED frames, half way from black, in RGB order
+	{ "hd108", 41, {
+		0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+		0xFF, 0xFF, 0x08, 0x00, 0x40, 0x00, 0x7F, 0x80,
+		0xFF, 0xFF, 0x00, 0x00, 0x00, 0x80, 0x01, 0x00,
+		0xFF, 0xFF, 0x55, 0x00, 0x2A, 0x80, 0x3F, 0x80,
+		0xFF
+	} },
+	{ "ws2801", 9, {
+		0x10, 0x80, 0xFF, 0x00, 0x01, 0x02, 0xAA, 0x55, 0x7F
+	} },
+	{ "lpd8806", 10, {
+		0x88, 0xC0, 0xFF, 0x80, 0x80, 0x81, 0xD5, 0xAA, 0xBF,
+		0x00
+	} },
+	{ "ws2812", 27 + 90, {
+		0x92, 0x69, 0x24, 0xD2, 0x49, 0x24, 0xDB, 0x6D, 0xB6,
+		0x92, 0x49, 0x24, 0x92, 0x49, 0x26, 0x92, 0x49, 0x34,
+		0xD3, 0x4D, 0x34, 0x9A, 0x69, 0xA6, 0x9B, 0x6D, 0xB6
+	} },
+	{ "sk6812", 36 + 120, {
+		0x88, 0x8C, 0x88, 0x88, 0xC8, 0x88, 0x88, 0x88, 0xCC, 0xCC, 0xCC, 0xCC,
+		0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x8C, 0x88, 0x88, 0x88, 0xC8,
+		0xC8, 0xC8, 0xC8, 0xC8, 0x8C, 0x8C, 0x8C, 0x8C, 0x8C, 0xCC, 0xCC, 0xCC
+	} }
+};
+
+static const size_t g_test_expected_frame_count = sizeof(g_test_expected_frames) / sizeof(g_test_expected_frames[0]);
+
+/**
+ * Renders the colors of the test LED frames with the 16-bit kernel, interpolated half way from black so that the
+ * low bytes are exercised too.
+ */
+static bool test_render_wide(uint8_t* pixels_out) {
+	render_frame_t previous = { .pixel_count = 0 }, current = { .pixel_count = 0 };
+	if (! render_frame_alloc(&previous, TEST_LEDS) || ! render_frame_alloc(&current, TEST_LEDS)) {
+		render_frame_free(&previous);
+		render_frame_free(&current);
+		return false;
+	}
+
+	for (uint32_t i=0; i<TEST_LEDS; i++) {
+		for (int channel=0; channel<3; channel++) {
+			current.planes[channel][i] = g_test_led_frames[i*4 + 1 + channel];
+		}
+	}
+
+	render_params_t params = {
+		.frame_progress16 = 0x8000,
+		.inv_frame_progress16 = 0x7FFF,
+		.interpolation_enabled = true
+	};
+	render_params_set_channel_order(&params, COLOR_ORDER_RGB);
+
+	render_kernel_variant(&g_render_wide_kernel, &params)(&params, &previous, &current, NULL, 0, TEST_LEDS, pixels_out);
+
+	render_frame_free(&previous);
+	render_frame_free(&current);
+	return true;
+}
+
+/**
+ * Encodes the test LED frames as the chipset would and compares them with the expected frame. Returns 0 on a match.
+ */
+static int test_chipset(const test_expected_frame_t* expected) {
+	const chipset_t* chipset = chipset_find(expected->name);
+	if (chipset == NULL) {
+		printf("FAIL %s: no such chipset\n", expected->name);
+		return 1;
+	}
+
+	uint32_t length = chipset_frame_length(chipset, TEST_LEDS);
+	if (length != expected->length) {
+		printf("FAIL %s: frame is %u bytes, expected %u\n", expected->name, length, expected->length);
+		return 1;
+	}
+
+	// Fill with a pattern first, so bytes the chipset forgets to write show up as mismatches
+	uint8_t frame[sizeof(expected->bytes)];
+	memset(frame, 0x5A, sizeof(frame));
+
+	chipset_write_frame_edges(chipset, frame, TEST_LEDS);
+	if (chipset->wide) {
+		if (! test_render_wide(&frame[chipset->start_length])) {
+			printf("FAIL %s: failed to allocate frames\n", expected->name);
+			return 1;
+		}
+	} else if (chipset->encode != NULL) {
+		chipset->encode(g_test_led_frames, TEST_LEDS, &frame[chipset->start_length]);
+	} else {
+		memcpy(&frame[chipset->start_length], g_test_led_frames, sizeof(g_test_led_frames));
+	}
+
+	for (uint32_t i=0; i<length; i++) {
+		if (frame[i] != expected->bytes[i]) {
+			printf("FAIL %s: frame byte %u is 0x%02X, expected 0x%02X\n", expected->name, i, frame[i], expected->bytes[i]);
+			return 1;
+		}
+	}
+
+	printf("PASS %s: %u bytes\n", expected->name, length);
+	return 0;
+}
+
+int main(void) {
+	int failures = 0;
+
+	for (size_t i=0; i<g_test_expected_frame_count; i++) {
+		failures += test_chipset(&g_test_expected_frames[i]);
+	}
+
+	return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,67 @@
+/** \file
+ * Feeds the render quality governor synthetic render and write times: a bus-bound strip must keep full quality, a
+ * render-bound one must step down, and step back up once rendering gets cheap again.
+ */
+#include "render_governor.h"
+
+#include <stdio.h>
+
+// One frame every 10 ms, for 20 s
+#define TEST_FRAME_USEC 10000
+#define TEST_FRAMES 2000
+
+/**
+ * Runs the governor for TEST_FRAMES frames with the given per-frame render and write times, at any quality, as when
+ * the CPU is busy with something else. Returns the quality it ends at.
+ */
+static render_quality_t test_run(
+	render_governor_t* governor,
+	uint64_t* now_usec,
+	uint32_t render_usec,
+	uint32_t write_usec
+) {
+	for (uint32_t f=0; f<TEST_FRAMES; f++) {
+		render_governor_update(governor, render_usec, write_usec, *now_usec);
+		*now_usec += TEST_FRAME_USEC;
+	}
+
+	return governor->quality;
+}
+
+static int test_expect(const char* name, render_quality_t actual, render_quality_t expected) {
+	if (actual != expected) {
+		printf(
+			"FAIL %s: ended at %s, expected %s\n",
+			name,
+			render_quality_to_string(actual),
+			render_quality_to_string(expected)
+		);
+		return 1;
+	}
+
+	printf("PASS %s: %s\n", name, render_quality_to_string(actual));
+	return 0;
+}
+
+int main(void) {
+	render_governor_t governor;
+	uint64_t now_usec = 1;
+	int failures = 0;
+
+	// 2000 APA102 LEDs at 8 MHz and 400 Hz: 8130 us on the wire, a little more to write, next to almost no rendering
+	render_governor_init(&governor);
+	render_governor_set_target(&governor, 400, 8000000, 8129, 0);
+	failures += test_expect("bus-bound strip", test_run(&governor, &now_usec, 16, 8700), RENDER_QUALITY_FULL);
+
+	// The same strip when rendering takes longer than the period left after the transfer, and than the transfer
+	failures += test_expect(
+		"render-bound strip",
+		test_run(&governor, &now_usec, 9000, 8700),
+		RENDER_QUALITY_LEVEL_COUNT - 1
+	);
+
+	// Rendering gets cheap again, while the bus stays as busy
+	failures += test_expect("recovery", test_run(&governor, &now_usec, 100, 8700), RENDER_QUALITY_FULL);
+
+	return failures > 0 ? 1 : 0;
+}
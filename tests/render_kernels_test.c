@@ -0,0 +1,29 @@
+/** \file
+ * Verifies every vectorized render kernel this CPU supports against the scalar kernel over
+ * RENDER_VERIFY_FULL_FRAMES frames; the server only checks a few frames at startup.
+ */
+#include "render.h"
+
+#include <stdio.h>
+
+int main(void) {
+	static const char* kernel_names[] = { "sse2", "avx2", "neon" };
+	int failures = 0;
+
+	render_hdr_init();
+
+	for (size_t i=0; i<sizeof(kernel_names) / sizeof(kernel_names[0]); i++) {
+		const render_kernel_t* kernel = render_kernel_by_name(kernel_names[i]);
+
+		if (kernel == NULL || ! kernel->is_supported()) {
+			printf("SKIP %s: not supported on this CPU\n", kernel_names[i]);
+		} else if (render_kernel_verify(kernel, RENDER_VERIFY_FULL_FRAMES)) {
+			printf("PASS %s matches the scalar kernel\n", kernel->name);
+		} else {
+			printf("FAIL %s does not match the scalar kernel\n", kernel->name);
+			failures++;
+		}
+	}
+
+	return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,150 @@
+/** \file
+ * Renders frames split into segments across several pool threads and compares them byte for byte with the same frames
+ * rendered on one thread, for APA102 and HD108 output.
+ */
+#include "render_pool.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_LED_COUNT 8192
+#define TEST_STRIP_COUNT 2
+
+static uint32_t g_random_state = 0x2F6E2B1;
+
+static uint8_t test_random_byte(void) {
+	// xorshift32
+	g_random_state ^= g_random_state << 13;
+	g_random_state ^= g_random_state >> 17;
+	g_random_state ^= g_random_state << 5;
+	return (uint8_t) g_random_state;
+}
+
+/**
+ * Renders the frame as TEST_STRIP_COUNT strips with the given pool into out, bytes_per_led bytes per pixel.
+ */
+static void test_render(
+	render_pool_t* pool,
+	const render_kernel_t* kernel,
+	const render_params_t* params,
+	const render_frame_t* previous,
+	const render_frame_t* current,
+	render_dither_t* dither,
+	uint32_t bytes_per_led,
+	uint8_t* out
+) {
+	render_range_t ranges[TEST_STRIP_COUNT];
+	uint32_t leds_per_strip = TEST_LED_COUNT / TEST_STRIP_COUNT;
+
+	for (uint32_t strip_index=0; strip_index<TEST_STRIP_COUNT; strip_index++) {
+		ranges[strip_index].first_pixel = strip_index * leds_per_strip;
+		ranges[strip_index].pixel_count = leds_per_strip;
+		ranges[strip_index].pixels_out = &out[strip_index * leds_per_strip * bytes_per_led];
+		ranges[strip_index].bytes_per_led = bytes_per_led;
+	}
+
+	render_pool_render(
+		pool,
+		render_kernel_variant(kernel, params),
+		params,
+		previous,
+		current,
+		dither,
+		ranges,
+		TEST_STRIP_COUNT
+	);
+}
+
+int main(void) {
+	static const uint32_t thread_counts[] = { 2, 3, 4, 7 };
+	static uint32_t lookup[257];
+	render_frame_t previous, current;
+	render_dither_t dither;
+	int failures = 0;
+
+	for (int i=0; i<257; i++) {
+		lookup[i] = (uint32_t) (i * i * 0xFFFF / (256 * 256));
+	}
+
+	if (! render_frame_alloc(&previous, TEST_LED_COUNT)
+		|| ! render_frame_alloc(&current, TEST_LED_COUNT)
+		|| ! render_dither_alloc(&dither, TEST_LED_COUNT)
+	) {
+		fprintf(stderr, "Failed to allocate frames\n");
+		return 1;
+	}
+
+	for (int channel=0; channel<3; channel++) {
+		for (uint32_t i=0; i<TEST_LED_COUNT; i++) {
+			previous.planes[channel][i] = test_random_byte();
+			current.planes[channel][i] = test_random_byte();
+		}
+	}
+
+	render_params_t params = {
+		.frame_progress16 = 0x5A5A,
+		.inv_frame_progress16 = 0xFFFF - 0x5A5A,
+		.interpolation_enabled = true,
+		.lut_enabled = true,
+		.red_lookup = lookup,
+		.green_lookup = lookup,
+		.blue_lookup = lookup
+	};
+	render_params_set_channel_order(&params, COLOR_ORDER_BGR);
+
+	const struct {
+		const char* name;
+		const render_kernel_t* kernel;
+		uint32_t bytes_per_led;
+	} outputs[] = {
+		{ "apa102", render_kernel_select("scalar"), 4 },
+		{ "hd108", &g_render_wide_kernel, RENDER_WIDE_BYTES_PER_LED }
+	};
+
+	uint8_t* expected = malloc(TEST_LED_COUNT * RENDER_WIDE_BYTES_PER_LED);
+	uint8_t* actual = malloc(TEST_LED_COUNT * RENDER_WIDE_BYTES_PER_LED);
+	render_pool_t* single_pool = render_pool_create(1);
+
+	for (size_t output=0; output<sizeof(outputs) / sizeof(outputs[0]); output++) {
+		const render_kernel_t* kernel = outputs[output].kernel;
+		uint32_t bytes_per_led = outputs[output].bytes_per_led;
+		size_t frame_size = (size_t) TEST_LED_COUNT * bytes_per_led;
+
+		memset(expected, 0, frame_size);
+		test_render(single_pool, kernel, &params, &previous, &current, &dither, bytes_per_led, expected);
+
+		for (size_t i=0; i<sizeof(thread_counts) / sizeof(thread_counts[0]); i++) {
+			render_pool_t* pool = render_pool_create(thread_counts[i]);
+
+			memset(actual, 0, frame_size);
+			test_render(pool, kernel, &params, &previous, &current, &dither, bytes_per_led, actual);
+			render_pool_destroy(pool);
+
+			if (memcmp(expected, actual, frame_size) != 0) {
+				size_t offset = 0;
+				while (expected[offset] == actual[offset]) {
+					offset++;
+				}
+				printf(
+					"FAIL %s on %u threads differs from one thread from byte %zu\n",
+					outputs[output].name,
+					thread_counts[i],
+					offset
+				);
+				failures++;
+			} else {
+				printf("PASS %s on %u threads matches one thread\n", outputs[output].name, thread_counts[i]);
+			}
+		}
+	}
+
+	render_pool_destroy(single_pool);
+	free(expected);
+	free(actual);
+	render_frame_free(&previous);
+	render_frame_free(&current);
+	render_dither_free(&dither);
+
+	return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,89 @@
+/** \file
+ * Counts the SPI_IOC_MESSAGE calls spidev writes take at several bufsiz settings, and checks each message stays within
+ * bufsiz and covers the frame in order.
+ */
+#include "spio_backend.h"
+
+#include <stdio.h>
+#include <linux/spi/spidev.h>
+
+static const struct {
+	uint32_t max_message_bytes;
+	size_t len;
+	uint32_t expected_messages;
+} g_cases[] = {
+	// spidev's default bufsiz
+	{ 4096, 4068, 1 },
+	{ 4096, 65536, 16 },
+	{ 4096, 100000, 25 },
+
+	// Transfers are capped at SPIO_MAX_TRANSFER_BYTES, leaving room for a short last piece in the same message
+	{ 65536, 4068, 1 },
+	{ 65536, 65536, 1 },
+	{ 65536, 100000, 2 },
+
+	{ 1048576, 300000, 1 }
+};
+
+static uint8_t g_frame[300000];
+
+int main(void) {
+	struct spi_ioc_transfer transfers[SPIO_MAX_TRANSFERS];
+	int failures = 0;
+
+	for (size_t i=0; i<sizeof(g_cases) / sizeof(g_cases[0]); i++) {
+		spio_connection conn = { .max_message_bytes = g_cases[i].max_message_bytes };
+		uint32_t message_count = 0;
+		const char* problem = NULL;
+
+		for (size_t offset=0; offset<g_cases[i].len && problem == NULL; ) {
+			size_t message_bytes;
+			uint32_t transfer_count = spio_spidev_next_message(
+				&conn,
+				g_frame,
+				g_cases[i].len,
+				offset,
+				transfers,
+				&message_bytes
+			);
+
+			if (transfer_count == 0 || message_bytes > conn.max_message_bytes) {
+				problem = "message doesn't fit bufsiz";
+			}
+
+			for (uint32_t t=0; t<transfer_count && problem == NULL; t++) {
+				if (transfers[t].tx_buf != (unsigned long) &g_frame[offset] || transfers[t].len > SPIO_MAX_TRANSFER_BYTES) {
+					problem = "transfers don't cover the frame in order";
+				}
+				offset += transfers[t].len;
+			}
+
+			message_count++;
+		}
+
+		if (problem == NULL && message_count != g_cases[i].expected_messages) {
+			problem = "wrong message count";
+		}
+
+		if (problem != NULL) {
+			printf(
+				"FAIL %zu bytes at bufsiz %u: %s (%u messages, expected %u)\n",
+				g_cases[i].len,
+				g_cases[i].max_message_bytes,
+				problem,
+				message_count,
+				g_cases[i].expected_messages
+			);
+			failures++;
+		} else {
+			printf(
+				"PASS %zu bytes at bufsiz %u in %u messages\n",
+				g_cases[i].len,
+				g_cases[i].max_message_bytes,
+				message_count
+			);
+		}
+	}
+
+	return failures > 0 ? 1 : 0;
+}
@@ -51,6 +51,52 @@ write_all(
 }
 		
 
+uint64_t
+hash64(
+	const void * const buf_ptr,
+	const size_t len
+)
+{
+	const uint8_t * const buf = buf_ptr;
+	const uint64_t k = 0x9E3779B97F4A7C15ull;
+	uint64_t h = len * k;
+	size_t offset = 0;
+
+	for ( ; offset + 8 <= len ; offset += 8)
+	{
+		uint64_t word;
+		memcpy(&word, buf + offset, sizeof(word));
+		h = (h ^ word) * k;
+		h ^= h >> 29;
+	}
+
+	if (offset < len)
+	{
+		uint64_t word = 0;
+		memcpy(&word, buf + offset, len - offset);
+		h = (h ^ word) * k;
+		h ^= h >> 29;
+	}
+
+	h ^= h >> 32;
+
+	return h == 0 ? 1 : h;
+}
+
+
+void
+monotonic_time(
+	struct timeval * const tv
+)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	tv->tv_sec = ts.tv_sec;
+	tv->tv_usec = ts.tv_nsec / 1000;
+}
+
+
 int
 serial_open(
 	const char * const dev
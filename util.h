@@ -10,6 +10,7 @@
 #include <inttypes.h>
 #include <errno.h>
 #include <unistd.h>
+#include <sys/time.h>
 
 #define warn(fmt, ...) \
 	do { \
@@ -57,6 +58,22 @@ write_all(
 	const size_t len
 );
 
+/** Fast non-cryptographic 64-bit hash, for spotting repeated data.
+ * \return a hash of the bytes and their length, never 0 so that 0 can mean "nothing hashed".
+ */
+extern uint64_t
+hash64(
+	const void * const buf,
+	const size_t len
+);
+
+/** Read CLOCK_MONOTONIC into a timeval, for measuring intervals that must not jump when the wall clock is set.
+ */
+extern void
+monotonic_time(
+	struct timeval * const tv
+);
+
 extern size_t strlcpy(char *dst, const char *src, size_t size);
 extern size_t strlcat(char *dst, const char *src, size_t size);
 